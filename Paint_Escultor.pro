@@ -25,17 +25,40 @@ DEFINES += QT_DEPRECATED_WARNINGS
 CONFIG += c++11
 
 SOURCES += \
+        arquivosculpt.cpp \
+        arvorecsg.cpp \
+        diagnostico.cpp \
         dialogescultor.cpp \
+        exportador.cpp \
+        historico.cpp \
         main.cpp \
         mainwindow.cpp \
         plotter.cpp \
-        sculptor.cpp
+        pooltrabalho.cpp \
+        raycaster.cpp \
+        saidabufferizada.cpp \
+        sculptor.cpp \
+        visualizador.cpp \
+        voxelstore.cpp \
+        voxelstoreesparso.cpp
 
 HEADERS += \
+        arquivosculpt.h \
+        arvorecsg.h \
+        diagnostico.h \
         dialogescultor.h \
+        exportador.h \
+        historico.h \
         mainwindow.h \
         plotter.h \
-        sculptor.h
+        pooltrabalho.h \
+        primitiva.h \
+        raycaster.h \
+        saidabufferizada.h \
+        sculptor.h \
+        visualizador.h \
+        voxelstore.h \
+        voxelstoreesparso.h
 
 FORMS += \
         dialogescultor.ui \
@@ -0,0 +1,447 @@
+#include "arquivosculpt.h"
+#include "voxelstoreesparso.h"
+#include "saidabufferizada.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define SCULPT_SEM_MMAP
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Geometria dos blocos: a mesma do VoxelStoreEsparso, uma palavra por linha do bloco
+static const int BLOCO_Z = VoxelStoreEsparso::BLOCO_Z;
+static const int BLOCO_X = VoxelStoreEsparso::BLOCO_X;
+static const int LINHAS_BLOCO = BLOCO_Z*BLOCO_X;
+
+// Cabecalho: "SCLP", versao, nx, ny, nz, BLOCO_Z, BLOCO_X, numero de blocos (todos com 4 bytes)
+static const char ASSINATURA[4] = {'S', 'C', 'L', 'P'};
+static const uint32_t VERSAO = 1;
+static const size_t TAMANHO_CABECALHO = 32;
+// Cada entrada da tabela: posicao do bloco no arquivo (8 bytes) e tamanho (4 bytes)
+static const size_t TAMANHO_ENTRADA = 12;
+
+// Leitura de inteiros little endian
+static inline uint32_t le32(const unsigned char *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline uint64_t le64(const unsigned char *p){
+    return (uint64_t)le32(p) | ((uint64_t)le32(p + 4) << 32);
+}
+
+// Escrita de inteiros little endian e de inteiros de tamanho variavel (7 bits por byte) num vetor
+static inline void poe32(vector<unsigned char> &saida, uint32_t valor){
+    for(int t=0; t<4; t++){
+        saida.push_back((unsigned char)(valor >> (8*t)));
+    }
+}
+static inline void poe64(vector<unsigned char> &saida, uint64_t valor){
+    poe32(saida, (uint32_t)valor);
+    poe32(saida, (uint32_t)(valor >> 32));
+}
+static inline void poeVariavel(vector<unsigned char> &saida, uint32_t valor){
+    while(valor >= 0x80){
+        saida.push_back((unsigned char)(valor | 0x80));
+        valor >>= 7;
+    }
+    saida.push_back((unsigned char)valor);
+}
+
+// Le um inteiro de tamanho variavel de [p, fim); retorna false se ele estiver truncado ou for grande demais
+static inline bool leVariavel(const unsigned char *&p, const unsigned char *fim, uint32_t &valor){
+    valor = 0;
+    for(int deslocamento=0; deslocamento<35; deslocamento+=7){
+        if(p == fim){
+            return false;
+        }
+        unsigned char byte = *p++;
+        valor |= (uint32_t)(byte & 0x7F) << deslocamento;
+        if(!(byte & 0x80)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Chave de uma cor na paleta de um bloco (os bits das quatro componentes)
+struct ChavePaleta{
+    uint32_t bits[4];
+    bool operator==(const ChavePaleta &o) const { return memcmp(bits, o.bits, sizeof(bits)) == 0; }
+};
+struct HashChavePaleta{
+    size_t operator()(const ChavePaleta &c) const {
+        uint64_t h = ((uint64_t)c.bits[0] << 32 | c.bits[1])*0x9E3779B97F4A7C15ULL;
+        return (size_t)(h ^ ((uint64_t)c.bits[2] << 32 | c.bits[3]));
+    }
+};
+
+// Comprime o bloco (kz, kx, w), cuja ocupacao sao as palavras de cada uma das suas linhas, no final de saida.
+// paleta, indicePaleta e corridas sao areas de trabalho. Retorna false (sem gravar nada) se o bloco estiver vazio.
+static bool codificaPalavras(const VoxelStore *v, int kz, int kx, int w, const uint64_t *palavras, vector<unsigned char> &saida,
+                             vector<Cor> &paleta, unordered_map<ChavePaleta, uint32_t, HashChavePaleta> &indicePaleta,
+                             vector<uint32_t> &corridas){
+    uint64_t mascaraLinhas = 0;
+    for(int t=0; t<LINHAS_BLOCO; t++){
+        if(palavras[t]){
+            mascaraLinhas |= 1ULL << t;
+        }
+    }
+    if(mascaraLinhas == 0){
+        return false;
+    }
+
+    // Paleta e corridas de cores, na ordem das linhas e dos bits
+    paleta.clear();
+    indicePaleta.clear();
+    corridas.clear();
+    uint32_t indiceAtual = 0, comprimento = 0;
+    ChavePaleta ultimaChave;
+    for(int t=0; t<LINHAS_BLOCO; t++){
+        uint64_t bits = palavras[t];
+        int z = kz*BLOCO_Z + t/BLOCO_X, x = kx*BLOCO_X + t%BLOCO_X;
+        while(bits){
+            int y = w*64 + primeiroBit(bits);
+            bits &= bits - 1;
+            Cor c = v->cor(x, y, z);
+            ChavePaleta chave;
+            memcpy(chave.bits, &c, sizeof(chave.bits));
+            // Voxels vizinhos costumam ter a mesma cor: so consulta a tabela quando a cor muda
+            if(comprimento > 0 && chave == ultimaChave){
+                comprimento++;
+                continue;
+            }
+            ultimaChave = chave;
+            auto it = indicePaleta.find(chave);
+            uint32_t indice;
+            if(it == indicePaleta.end()){
+                indice = (uint32_t)paleta.size();
+                indicePaleta[chave] = indice;
+                paleta.push_back(c);
+            }
+            else{
+                indice = it->second;
+            }
+            if(comprimento > 0 && indice == indiceAtual){
+                comprimento++;
+            }
+            else{
+                if(comprimento > 0){
+                    corridas.push_back(comprimento);
+                    corridas.push_back(indiceAtual);
+                }
+                indiceAtual = indice;
+                comprimento = 1;
+            }
+        }
+    }
+    corridas.push_back(comprimento);
+    corridas.push_back(indiceAtual);
+
+    poe64(saida, mascaraLinhas);
+    for(int t=0; t<LINHAS_BLOCO; t++){
+        if(mascaraLinhas & (1ULL << t)){
+            poe64(saida, palavras[t]);
+        }
+    }
+    poeVariavel(saida, (uint32_t)paleta.size());
+    for(size_t p=0; p<paleta.size(); p++){
+        uint32_t bits[4];
+        memcpy(bits, &paleta[p], sizeof(bits));
+        for(int c=0; c<4; c++){
+            poe32(saida, bits[c]);
+        }
+    }
+    for(size_t p=0; p<corridas.size(); p++){
+        poeVariavel(saida, corridas[p]);
+    }
+    return true;
+}
+
+// Comprime um bloco do armazenamento, lendo a ocupacao das suas linhas
+bool ArquivoSculpt::codificaBloco(const VoxelStore *v, int kz, int kx, int w, std::vector<unsigned char> &saida){
+    int nx = v->getNx(), nz = v->getNz();
+    vector<uint64_t> buffer(v->palavrasPorLinha());
+    uint64_t palavras[LINHAS_BLOCO];
+    for(int t=0; t<LINHAS_BLOCO; t++){
+        int z = kz*BLOCO_Z + t/BLOCO_X, x = kx*BLOCO_X + t%BLOCO_X;
+        palavras[t] = (z >= nz || x >= nx || v->linhaVazia(x, z)) ? 0 : v->ocupacao(x, z, buffer.data())[w];
+    }
+    vector<Cor> paleta;
+    unordered_map<ChavePaleta, uint32_t, HashChavePaleta> indicePaleta;
+    vector<uint32_t> corridas;
+    return codificaPalavras(v, kz, kx, w, palavras, saida, paleta, indicePaleta, corridas);
+}
+
+// Grava o escultor: os blocos sao comprimidos na memoria para que a tabela possa ser escrita antes deles
+bool ArquivoSculpt::grava(const std::string &filename, const VoxelStore *v,
+                          const std::function<bool(double)> &progresso){
+    int nx = v->getNx(), ny = v->getNy(), nz = v->getNz();
+    int palavras = v->palavrasPorLinha();
+    int bz = (nz + BLOCO_Z - 1)/BLOCO_Z, bx = (nx + BLOCO_X - 1)/BLOCO_X, by = palavras;
+    size_t numBlocos = (size_t)bz*bx*by;
+
+    vector<uint64_t> posicoes(numBlocos, 0);
+    vector<uint32_t> tamanhos(numBlocos, 0);
+    vector<unsigned char> corpo;
+    size_t inicioCorpo = TAMANHO_CABECALHO + numBlocos*TAMANHO_ENTRADA;
+
+    // As 64 linhas de uma coluna de blocos (kz, kx), com todas as palavras
+    vector<uint64_t> linhas((size_t)LINHAS_BLOCO*palavras);
+    vector<Cor> paleta;
+    unordered_map<ChavePaleta, uint32_t, HashChavePaleta> indicePaleta;
+    vector<uint32_t> corridas;
+
+    for(int kz=0; kz<bz; kz++){
+        for(int kx=0; kx<bx; kx++){
+            for(int t=0; t<LINHAS_BLOCO; t++){
+                int z = kz*BLOCO_Z + t/BLOCO_X, x = kx*BLOCO_X + t%BLOCO_X;
+                uint64_t *destino = &linhas[(size_t)t*palavras];
+                if(z >= nz || x >= nx || v->linhaVazia(x, z)){
+                    fill(destino, destino + palavras, 0);
+                    continue;
+                }
+                const uint64_t *linha = v->ocupacao(x, z, destino);
+                if(linha != destino){
+                    copy(linha, linha + palavras, destino);
+                }
+            }
+
+            for(int w=0; w<by; w++){
+                uint64_t palavrasBloco[LINHAS_BLOCO];
+                for(int t=0; t<LINHAS_BLOCO; t++){
+                    palavrasBloco[t] = linhas[(size_t)t*palavras + w];
+                }
+                size_t inicio = corpo.size();
+                if(!codificaPalavras(v, kz, kx, w, palavrasBloco, corpo, paleta, indicePaleta, corridas)){
+                    continue;
+                }
+
+                size_t idx = ((size_t)kz*bx + kx)*by + w;
+                posicoes[idx] = inicioCorpo + inicio;
+                tamanhos[idx] = (uint32_t)(corpo.size() - inicio);
+            }
+            if(progresso && !progresso(((double)kz*bx + kx + 1)/((double)bz*bx))){
+                return false;
+            }
+        }
+    }
+
+    SaidaBufferizada fout(filename);
+    if(!fout.aberto()){
+        return false;
+    }
+    fout.escreve(ASSINATURA, sizeof(ASSINATURA));
+    fout.inteiroBinario(VERSAO);
+    fout.inteiroBinario((uint32_t)nx);
+    fout.inteiroBinario((uint32_t)ny);
+    fout.inteiroBinario((uint32_t)nz);
+    fout.inteiroBinario((uint32_t)BLOCO_Z);
+    fout.inteiroBinario((uint32_t)BLOCO_X);
+    fout.inteiroBinario((uint32_t)numBlocos);
+    for(size_t t=0; t<numBlocos; t++){
+        fout.inteiroBinario((uint32_t)posicoes[t]);
+        fout.inteiroBinario((uint32_t)(posicoes[t] >> 32));
+        fout.inteiroBinario(tamanhos[t]);
+    }
+    fout.escreve(corpo.data(), corpo.size());
+    return fout.fecha();
+}
+
+ArquivoSculpt::ArquivoSculpt(){
+    dados = nullptr;
+    tamanho = 0;
+    mapeado = false;
+    nx = ny = nz = 0;
+    bz = bx = by = 0;
+}
+
+// Desfaz o mapeamento (ou libera a copia) do arquivo
+ArquivoSculpt::~ArquivoSculpt(){
+#ifndef SCULPT_SEM_MMAP
+    if(mapeado){
+        munmap((void*)dados, tamanho);
+        return;
+    }
+#endif
+    delete [] dados;
+}
+
+// Mapeia o arquivo e valida o cabecalho e a tabela; os blocos nao sao lidos
+ArquivoSculpt* ArquivoSculpt::abre(const std::string &filename){
+    ArquivoSculpt *arquivo = new ArquivoSculpt();
+#ifndef SCULPT_SEM_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0){
+        delete arquivo;
+        return nullptr;
+    }
+    struct stat info;
+    if(fstat(fd, &info) == 0 && info.st_size >= (off_t)TAMANHO_CABECALHO){
+        void *mapa = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapa != MAP_FAILED){
+            arquivo->dados = (const unsigned char*)mapa;
+            arquivo->tamanho = (size_t)info.st_size;
+            arquivo->mapeado = true;
+        }
+    }
+    close(fd);
+#else
+    FILE *f = fopen(filename.c_str(), "rb");
+    if(f != nullptr){
+        if(fseek(f, 0, SEEK_END) == 0){
+            long n = ftell(f);
+            if(n >= (long)TAMANHO_CABECALHO && fseek(f, 0, SEEK_SET) == 0){
+                unsigned char *copia = new unsigned char[n];
+                if(fread(copia, 1, (size_t)n, f) == (size_t)n){
+                    arquivo->dados = copia;
+                    arquivo->tamanho = (size_t)n;
+                }
+                else{
+                    delete [] copia;
+                }
+            }
+        }
+        fclose(f);
+    }
+#endif
+    if(arquivo->dados == nullptr){
+        delete arquivo;
+        return nullptr;
+    }
+
+    // Cabecalho
+    const unsigned char *p = arquivo->dados;
+    int64_t nx = (int32_t)le32(p + 8), ny = (int32_t)le32(p + 12), nz = (int32_t)le32(p + 16);
+    bool valido = memcmp(p, ASSINATURA, sizeof(ASSINATURA)) == 0 && le32(p + 4) == VERSAO
+               && le32(p + 20) == (uint32_t)BLOCO_Z && le32(p + 24) == (uint32_t)BLOCO_X
+               && nx >= 0 && ny >= 0 && nz >= 0 && ((nx == 0) == (ny == 0)) && ((ny == 0) == (nz == 0));
+    // O numero de blocos eh guardado em 32 bits: dimensoes cujo produto nao cabe nele sao recusadas antes de
+    // multiplicar, para que um produto truncado nao coincida com a contagem do arquivo
+    uint64_t bz = (uint64_t)((nz + BLOCO_Z - 1)/BLOCO_Z), bx = (uint64_t)((nx + BLOCO_X - 1)/BLOCO_X);
+    uint64_t by = (uint64_t)((ny + 63)/64);
+    valido = valido && (bz == 0 || bx <= UINT32_MAX/bz) && (bz*bx == 0 || by <= UINT32_MAX/(bz*bx));
+    if(valido){
+        arquivo->nx = (int)nx;
+        arquivo->ny = (int)ny;
+        arquivo->nz = (int)nz;
+        arquivo->bz = (int)bz;
+        arquivo->bx = (int)bx;
+        arquivo->by = (int)by;
+        uint64_t numBlocos = bz*bx*by;
+        // A tabela deve corresponder as dimensoes e estar inteira no arquivo antes que qualquer coisa seja alocada
+        valido = le32(p + 28) == numBlocos && TAMANHO_CABECALHO + numBlocos*TAMANHO_ENTRADA <= arquivo->tamanho;
+        // Cada bloco deve estar inteiro dentro do arquivo
+        for(uint64_t t=0; valido && t<numBlocos; t++){
+            const unsigned char *entrada = p + TAMANHO_CABECALHO + t*TAMANHO_ENTRADA;
+            uint64_t posicao = le64(entrada);
+            uint32_t n = le32(entrada + 8);
+            valido = n == 0 || (posicao <= arquivo->tamanho && n <= arquivo->tamanho - posicao);
+        }
+    }
+    if(!valido){
+        delete arquivo;
+        return nullptr;
+    }
+    return arquivo;
+}
+
+// Decodifica todos os blocos da fatia
+bool ArquivoSculpt::decodificaFatia(int fatia, VoxelStore *v) const{
+    bool ok = true;
+    for(int kx=0; kx<bx; kx++){
+        for(int w=0; w<by; w++){
+            if(!decodificaBloco(((size_t)fatia*bx + kx)*by + w, v)){
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+// Decodifica o bloco de indice idx da tabela
+bool ArquivoSculpt::decodificaBloco(size_t idx, VoxelStore *v) const{
+    const unsigned char *entrada = dados + TAMANHO_CABECALHO + idx*TAMANHO_ENTRADA;
+    uint32_t n = le32(entrada + 8);
+    if(n == 0){
+        return true;
+    }
+    int kz = (int)(idx/((size_t)bx*by));
+    int kx = (int)((idx/by) % bx);
+    int w = (int)(idx % by);
+    return decodificaBloco(dados + le64(entrada), n, kz, kx, w, v);
+}
+
+// Decodifica um bloco: cada trecho de voxels consecutivos de uma linha com a mesma cor vira uma unica chamada a ativa()
+bool ArquivoSculpt::decodificaBloco(const unsigned char *p, size_t n, int kz, int kx, int w, VoxelStore *v){
+    const unsigned char *fim = p + n;
+    int nx = v->getNx(), ny = v->getNy(), nz = v->getNz(), by = v->palavrasPorLinha();
+    // Bits validos da palavra (a ultima palavra da linha pode ser incompleta)
+    uint64_t validos = (w == by - 1 && ny % 64) ? (1ULL << (ny % 64)) - 1 : ~0ULL;
+
+    if(fim - p < 8){
+        return false;
+    }
+    uint64_t mascaraLinhas = le64(p);
+    p += 8;
+    uint64_t linhas[LINHAS_BLOCO];
+    for(int t=0; t<LINHAS_BLOCO; t++){
+        linhas[t] = 0;
+        if(mascaraLinhas & (1ULL << t)){
+            if(fim - p < 8){
+                return false;
+            }
+            linhas[t] = le64(p) & validos;
+            p += 8;
+            if(linhas[t] && (kz*BLOCO_Z + t/BLOCO_X >= nz || kx*BLOCO_X + t%BLOCO_X >= nx)){
+                return false;
+            }
+        }
+    }
+
+    uint32_t tamanhoPaleta;
+    if(!leVariavel(p, fim, tamanhoPaleta) || (uint64_t)(fim - p) < (uint64_t)tamanhoPaleta*16){
+        return false;
+    }
+    const unsigned char *paleta = p;
+    p += (size_t)tamanhoPaleta*16;
+
+    uint32_t restante = 0, indice = 0;
+    Cor c = {0, 0, 0, 0};
+    for(int t=0; t<LINHAS_BLOCO; t++){
+        uint64_t bits = linhas[t];
+        int z = kz*BLOCO_Z + t/BLOCO_X, x = kx*BLOCO_X + t%BLOCO_X;
+        while(bits){
+            // Trecho de bits ativos consecutivos [y0, y0 + tamanhoTrecho)
+            int y0 = primeiroBit(bits);
+            uint64_t aPartir = ~(bits >> y0);
+            int tamanhoTrecho = aPartir ? primeiroBit(aPartir) : 64 - y0;
+            bits &= (tamanhoTrecho + y0 >= 64) ? 0 : ~0ULL << (y0 + tamanhoTrecho);
+            while(tamanhoTrecho > 0){
+                if(restante == 0){
+                    if(!leVariavel(p, fim, restante) || !leVariavel(p, fim, indice) || restante == 0 || indice >= tamanhoPaleta){
+                        return false;
+                    }
+                    uint32_t componentes[4];
+                    for(int k=0; k<4; k++){
+                        componentes[k] = le32(paleta + (size_t)indice*16 + 4*k);
+                    }
+                    memcpy(&c, componentes, sizeof(componentes));
+                }
+                int m = (int)min<uint32_t>(restante, (uint32_t)tamanhoTrecho);
+                v->ativa(x, z, w*64 + y0, w*64 + y0 + m - 1, c);
+                restante -= m;
+                y0 += m;
+                tamanhoTrecho -= m;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef ARQUIVOSCULPT_H
+#define ARQUIVOSCULPT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "voxelstore.h"
+
+/**
+ * @brief A classe ArquivoSculpt
+ * le e grava o formato nativo .sculpt, que guarda as dimensoes, a ocupacao e as cores do escultor sem perda.
+ *
+ * O escultor eh dividido nos mesmos blocos do VoxelStoreEsparso (BLOCO_Z planos x BLOCO_X linhas x 64 colunas).
+ * Depois do cabecalho vem uma tabela com a posicao e o tamanho de cada bloco (blocos vazios tem tamanho zero)
+ * e em seguida os blocos comprimidos. Cada bloco guarda:
+ *  - uma mascara de 64 bits com as linhas nao vazias e a palavra de ocupacao de cada uma delas;
+ *  - a paleta das cores do bloco (quatro floats por cor);
+ *  - os voxels ativos, na ordem das linhas e dos bits, codificados em corridas (comprimento, indice na paleta)
+ *    com inteiros de tamanho variavel.
+ * Todos os numeros sao little endian.
+ *
+ * A leitura mapeia o arquivo na memoria (mmap) e so valida o cabecalho e a tabela; cada fatia de BLOCO_Z planos
+ * eh descomprimida apenas quando decodificaFatia() eh chamada.
+ */
+class ArquivoSculpt
+{
+public:
+    /**
+     * @brief grava : grava os voxels de v no arquivo filename
+     * @param progresso : se definida, eh chamada com a fracao ja comprimida (entre 0 e 1) apos cada coluna de blocos;
+     * se retornar false a gravacao eh interrompida antes de criar o arquivo
+     * @return false se o arquivo nao pode ser gravado ou se a gravacao foi interrompida
+     */
+    static bool grava(const std::string &filename, const VoxelStore *v,
+                      const std::function<bool(double)> &progresso = std::function<bool(double)>());
+
+    /**
+     * @brief abre : mapeia o arquivo filename e valida o cabecalho e a tabela de blocos
+     * @return o arquivo aberto, ou nullptr se ele nao existe ou nao esta no formato .sculpt
+     */
+    static ArquivoSculpt* abre(const std::string &filename);
+
+    /**
+     * @brief ~ArquivoSculpt : desfaz o mapeamento do arquivo
+     */
+    ~ArquivoSculpt();
+
+    int getNx() const { return nx; }
+    int getNy() const { return ny; }
+    int getNz() const { return nz; }
+
+    /**
+     * @brief fatias : numero de fatias de BLOCO_Z planos
+     */
+    int fatias() const { return bz; }
+
+    /**
+     * @brief decodificaFatia : ativa em v os voxels dos blocos da fatia (planos [fatia*BLOCO_Z, fatia*BLOCO_Z + BLOCO_Z))
+     * @return false se algum bloco da fatia estiver corrompido (os voxels ja decodificados sao mantidos)
+     */
+    bool decodificaFatia(int fatia, VoxelStore *v) const;
+
+    /**
+     * @brief codificaBloco : comprime o bloco (kz, kx, w) de v (planos kz*BLOCO_Z.., linhas kx*BLOCO_X.., palavra w das linhas)
+     * no formato dos blocos do arquivo, acrescentando-o ao final de saida
+     * @return false (sem acrescentar nada) se nenhum voxel do bloco estiver ativo
+     */
+    static bool codificaBloco(const VoxelStore *v, int kz, int kx, int w, std::vector<unsigned char> &saida);
+
+    /**
+     * @brief decodificaBloco : ativa em v os voxels do bloco (kz, kx, w) comprimido nos n bytes a partir de p
+     * (os voxels inativos no bloco nao sao alterados)
+     * @return false se o bloco estiver corrompido
+     */
+    static bool decodificaBloco(const unsigned char *p, size_t n, int kz, int kx, int w, VoxelStore *v);
+
+private:
+    // Conteudo do arquivo (mapeado ou, onde nao ha mmap, lido para a memoria)
+    const unsigned char *dados;
+    size_t tamanho;
+    bool mapeado;
+    int nx, ny, nz;
+    // Numero de blocos em z, em x e em y
+    int bz, bx, by;
+
+    ArquivoSculpt();
+    ArquivoSculpt(const ArquivoSculpt&) = delete;
+    ArquivoSculpt& operator=(const ArquivoSculpt&) = delete;
+
+    // Decodifica o bloco de indice idx da tabela; retorna false se ele estiver corrompido
+    bool decodificaBloco(size_t idx, VoxelStore *v) const;
+};
+
+#endif // ARQUIVOSCULPT_H
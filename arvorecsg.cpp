@@ -0,0 +1,165 @@
+#include "arvorecsg.h"
+#include "voxelstoreesparso.h"
+#include <algorithm>
+
+using namespace std;
+
+static const int PLANOS = VoxelStoreEsparso::BLOCO_Z;
+static const int LARGURA = VoxelStoreEsparso::BLOCO_X;
+
+// Cria a arvore sem operacoes, com uma entrada por fatia de planos
+ArvoreCSG::ArvoreCSG(int _nx, int _ny, int _nz){
+    nx = _nx;
+    ny = _ny;
+    nz = _nz;
+    Fatia vazia = {-1, 0, -1};
+    fatias.assign((nz + PLANOS - 1)/PLANOS, vazia);
+    fatiasPendentes = 0;
+}
+
+// Acrescenta a folha ao ultimo no (ou a um novo) e marca as fatias que ela intercepta
+void ArvoreCSG::adiciona(const Primitiva &p, bool ativa, const Cor &c){
+    if(p.forma == Primitiva::Vazia || p.x0 > p.x1 || p.z0 > p.z1){
+        return;
+    }
+    int indice = (int)folhas.size();
+    Folha folha = {p, ativa, c};
+    folhas.push_back(folha);
+    if(indice % FOLHAS_POR_NO == 0){
+        No no = {p.x0, p.x1, p.z0, p.z1};
+        nos.push_back(no);
+    }
+    else{
+        No &no = nos.back();
+        no.x0 = min(no.x0, p.x0);
+        no.x1 = max(no.x1, p.x1);
+        no.z0 = min(no.z0, p.z0);
+        no.z1 = max(no.z1, p.z1);
+    }
+    for(int f=p.z0/PLANOS; f<=p.z1/PLANOS; f++){
+        Fatia &fatia = fatias[f];
+        if(fatia.primeira < 0){
+            fatia.primeira = indice;
+            fatia.x0 = p.x0;
+            fatia.x1 = p.x1;
+            fatiasPendentes++;
+        }
+        else{
+            fatia.x0 = min(fatia.x0, p.x0);
+            fatia.x1 = max(fatia.x1, p.x1);
+        }
+    }
+}
+
+// Resolve cada linha da fatia percorrendo, de tras para frente, as folhas que interceptam a sua coluna de linhas
+void ArvoreCSG::avaliaFatia(int f, VoxelStore *v, int &x0, int &x1) const{
+    const Fatia &fatia = fatias[f];
+    x0 = fatia.x0;
+    x1 = fatia.x1;
+    if(fatia.primeira < 0){
+        return;
+    }
+    int z0 = f*PLANOS, z1 = min(z0 + PLANOS, nz) - 1;
+
+    // Folhas pendentes da fatia, em ordem, separadas por colunas de LARGURA linhas; os nos que nao
+    // interceptam a fatia sao pulados inteiros
+    int colunas = (nx + LARGURA - 1)/LARGURA;
+    vector<vector<int> > porColuna(colunas);
+    for(int t=fatia.primeira/FOLHAS_POR_NO; t<(int)nos.size(); t++){
+        const No &no = nos[t];
+        if(no.z1 < z0 || no.z0 > z1){
+            continue;
+        }
+        int fim = min((t + 1)*FOLHAS_POR_NO, (int)folhas.size());
+        for(int o=max(t*FOLHAS_POR_NO, fatia.primeira); o<fim; o++){
+            const Primitiva &p = folhas[o].forma;
+            if(p.z1 < z0 || p.z0 > z1){
+                continue;
+            }
+            for(int c=p.x0/LARGURA; c<=p.x1/LARGURA; c++){
+                porColuna[c].push_back(o);
+            }
+        }
+    }
+
+    // Estado de cada y da linha: -1 ainda nao resolvido, 0 desativado, o+1 ativado pela folha o
+    vector<int> estado(ny, -1);
+    for(int k=z0; k<=z1; k++){
+        for(int c=0; c<colunas; c++){
+            const vector<int> &lista = porColuna[c];
+            if(lista.empty()){
+                continue;
+            }
+            for(int i=c*LARGURA; i<min(nx, c*LARGURA + LARGURA); i++){
+                int ymin = ny, ymax = -1, resolvidos = 0;
+                for(int l=(int)lista.size()-1; l>=0 && resolvidos<ny; l--){
+                    int o = lista[l];
+                    const Primitiva &p = folhas[o].forma;
+                    int y0, y1;
+                    if(k < p.z0 || k > p.z1 || i < p.x0 || i > p.x1 || !p.intervalo(k, i, y0, y1)){
+                        continue;
+                    }
+                    y0 = max(y0, 0);
+                    y1 = min(y1, ny-1);
+                    if(y0 > y1){
+                        continue;
+                    }
+                    ymin = min(ymin, y0);
+                    ymax = max(ymax, y1);
+                    int e = folhas[o].ativa ? o + 1 : 0;
+                    for(int j=y0; j<=y1; j++){
+                        if(estado[j] < 0){
+                            estado[j] = e;
+                            resolvidos++;
+                        }
+                    }
+                }
+                // Grava os trechos de mesmo estado e restaura a area de trabalho
+                int j = ymin;
+                while(j <= ymax){
+                    int e = estado[j];
+                    int fim = j;
+                    while(fim < ymax && estado[fim+1] == e){
+                        fim++;
+                    }
+                    if(e > 0){
+                        v->ativa(i, k, j, fim, folhas[e-1].cor);
+                    }
+                    else if(e == 0){
+                        v->desativa(i, k, j, fim);
+                    }
+                    fill(estado.begin() + j, estado.begin() + fim + 1, -1);
+                    j = fim + 1;
+                }
+            }
+        }
+    }
+}
+
+// Marca a fatia como avaliada; sem fatias pendentes as folhas e os nos podem ser descartados
+void ArvoreCSG::descartaFatia(int f){
+    if(fatias[f].primeira < 0){
+        return;
+    }
+    fatias[f].primeira = -1;
+    fatiasPendentes--;
+    if(fatiasPendentes == 0){
+        folhas.clear();
+        nos.clear();
+    }
+}
+
+// Descarta todas as operacoes
+void ArvoreCSG::limpa(){
+    folhas.clear();
+    nos.clear();
+    for(size_t f=0; f<fatias.size(); f++){
+        fatias[f].primeira = -1;
+    }
+    fatiasPendentes = 0;
+}
+
+// Bytes alocados pelos vetores da arvore (clear() nao libera a capacidade)
+size_t ArvoreCSG::memoria() const{
+    return folhas.capacity()*sizeof(Folha) + nos.capacity()*sizeof(No) + fatias.capacity()*sizeof(Fatia);
+}
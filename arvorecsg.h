@@ -0,0 +1,107 @@
+#ifndef ARVORECSG_H
+#define ARVORECSG_H
+
+#include <vector>
+#include "voxelstore.h"
+#include "primitiva.h"
+
+/**
+ * @brief A classe ArvoreCSG
+ * guarda as operacoes de desenho (put/cut de caixas, esferas e elipsoides) ainda nao aplicadas ao armazenamento,
+ * para que os voxels so sejam calculados quando forem necessarios.
+ *
+ * As operacoes sao as folhas da arvore, na ordem em que foram feitas, cada uma com a sua caixa envolvente.
+ * Grupos de FOLHAS_POR_NO folhas consecutivas formam os nos, cuja caixa envolvente eh a uniao das caixas das folhas;
+ * assim uma regiao do escultor so examina as folhas dos nos que a interceptam.
+ *
+ * A avaliacao eh feita por fatias de BLOCO_Z planos (as mesmas do armazenamento esparso e dos arquivos .sculpt).
+ * Cada voxel da fatia recebe o estado da ultima operacao que o cobre: as folhas sao percorridas de tras para frente
+ * e cada linha (z,x) termina assim que todos os seus voxels foram resolvidos. Voxels que nenhuma operacao
+ * pendente cobre mantem o que ja estava no armazenamento.
+ */
+class ArvoreCSG
+{
+public:
+    /**
+     * @brief FOLHAS_POR_NO : numero de operacoes de cada no
+     */
+    static const int FOLHAS_POR_NO = 16;
+
+    /**
+     * @brief ArvoreCSG : cria uma arvore vazia para um escultor nx x ny x nz
+     */
+    ArvoreCSG(int _nx, int _ny, int _nz);
+
+    /**
+     * @brief adiciona : registra uma operacao, que sera aplicada depois de todas as anteriores
+     * @param p : primitiva ja recortada aos limites do escultor
+     * @param ativa : true para ativar os voxels com a cor c, false para desativa-los
+     */
+    void adiciona(const Primitiva &p, bool ativa, const Cor &c);
+
+    /**
+     * @brief vazia : true se nao ha nenhuma operacao pendente
+     */
+    bool vazia() const { return fatiasPendentes == 0; }
+
+    /**
+     * @brief pendente : true se alguma operacao pendente intercepta a fatia
+     */
+    bool pendente(int fatia) const { return fatias[fatia].primeira >= 0; }
+
+    /**
+     * @brief linhasPendentes : intervalo de linhas x∈[x0,x1] que as operacoes pendentes da fatia podem alterar
+     */
+    void linhasPendentes(int fatia, int &x0, int &x1) const { x0 = fatias[fatia].x0; x1 = fatias[fatia].x1; }
+
+    /**
+     * @brief avaliaFatia : aplica em v as operacoes pendentes da fatia (planos [fatia*BLOCO_Z, fatia*BLOCO_Z + BLOCO_Z)).
+     * Fatias diferentes podem ser avaliadas em paralelo; depois de avaliada, a fatia deve ser descartada com descartaFatia().
+     * @param x0, x1 : recebem o intervalo de linhas que pode ter mudado
+     */
+    void avaliaFatia(int fatia, VoxelStore *v, int &x0, int &x1) const;
+
+    /**
+     * @brief descartaFatia : marca a fatia como avaliada; quando nenhuma fatia tem operacoes pendentes a arvore eh esvaziada
+     */
+    void descartaFatia(int fatia);
+
+    /**
+     * @brief limpa : descarta todas as operacoes pendentes
+     */
+    void limpa();
+
+    /**
+     * @brief operacoes : numero de operacoes guardadas (incluindo as ja avaliadas em parte das fatias)
+     */
+    size_t operacoes() const { return folhas.size(); }
+
+    /**
+     * @brief memoria : bytes alocados pelas folhas, nos e fatias
+     */
+    size_t memoria() const;
+
+private:
+    struct Folha{
+        Primitiva forma;
+        bool ativa;
+        Cor cor;
+    };
+    struct No{
+        int x0, x1, z0, z1;
+    };
+    struct Fatia{
+        // Primeira folha ainda nao avaliada na fatia (-1 se nao ha nenhuma) e linhas que ela pode alterar
+        int primeira;
+        int x0, x1;
+    };
+
+    int nx, ny, nz;
+    std::vector<Folha> folhas;
+    // O no t agrupa as folhas [t*FOLHAS_POR_NO, (t+1)*FOLHAS_POR_NO)
+    std::vector<No> nos;
+    std::vector<Fatia> fatias;
+    int fatiasPendentes;
+};
+
+#endif // ARVORECSG_H
@@ -0,0 +1,42 @@
+#-------------------------------------------------
+#
+# Medicao de desempenho das primitivas e das gravacoes do escultor:
+# usa apenas o nucleo do escultor (sem Qt)
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt app_bundle
+CONFIG   += console c++11
+
+TARGET = escultor_desempenho
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+unix: LIBS += -lpthread
+win32: LIBS += -lpsapi
+
+SOURCES += \
+        main.cpp \
+        ../arquivosculpt.cpp \
+        ../arvorecsg.cpp \
+        ../diagnostico.cpp \
+        ../historico.cpp \
+        ../pooltrabalho.cpp \
+        ../saidabufferizada.cpp \
+        ../sculptor.cpp \
+        ../voxelstore.cpp \
+        ../voxelstoreesparso.cpp
+
+HEADERS += \
+        ../arquivosculpt.h \
+        ../arvorecsg.h \
+        ../diagnostico.h \
+        ../historico.h \
+        ../pooltrabalho.h \
+        ../primitiva.h \
+        ../saidabufferizada.h \
+        ../sculptor.h \
+        ../voxelstore.h \
+        ../voxelstoreesparso.h
@@ -0,0 +1,348 @@
+#include "sculptor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// Mede o desempenho das primitivas, do otimizar e das gravacoes do escultor em grades de varios tamanhos e ocupacoes.
+// Cada medicao eh repetida ate somar o tempo minimo; as operacoes que alteram o escultor sao aplicadas a uma copia
+// nova da cena a cada repeticao (a copia nao entra no tempo). A cena eh formada por esferas em posicoes sorteadas
+// com semente fixa, ate atingir a ocupacao pedida, logo execucoes diferentes medem exatamente o mesmo trabalho.
+
+// Resultado de uma medicao
+struct Medicao{
+    string operacao;
+    int tamanho;
+    double ocupacao;
+    int repeticoes;
+    double segundos;     // tempo medio de uma repeticao
+    double voxels;       // voxels processados por repeticao
+    double bytes;        // bytes gravados por repeticao (0 se a operacao nao grava arquivos)
+    size_t picoRSS;      // maior memoria residente do processo ate o fim da medicao
+};
+
+// Maior memoria residente do processo ate agora, em bytes
+static size_t picoRSS(){
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+    return pmc.PeakWorkingSetSize;
+#else
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+#ifdef __APPLE__
+    return (size_t)uso.ru_maxrss;
+#else
+    return (size_t)uso.ru_maxrss*1024;
+#endif
+#endif
+}
+
+// Quantidade de voxels ativos do escultor
+static size_t contaAtivos(Sculptor &s){
+    const VoxelStore *v = s.volume();
+    vector<uint64_t> buffer(v->palavrasPorLinha());
+    size_t total = 0;
+    for(int k=0; k<v->getNz(); k++){
+        for(int i=0; i<v->getNx(); i++){
+            if(v->linhaVazia(i, k)){
+                continue;
+            }
+            const uint64_t *linha = v->ocupacao(i, k, buffer.data());
+            for(int w=0; w<v->palavrasPorLinha(); w++){
+                total += contaBits(linha[w]);
+            }
+        }
+    }
+    return total;
+}
+
+// Tamanho do arquivo em bytes (0 se ele nao existir)
+static double tamanhoArquivo(const string &arquivo){
+    FILE *f = fopen(arquivo.c_str(), "rb");
+    if(f == nullptr){
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    double tamanho = (double)ftell(f);
+    fclose(f);
+    return tamanho;
+}
+
+// Lotes de esferas que criaCena tenta no maximo antes de aceitar uma ocupacao menor que a pedida
+static const int MAXIMO_LOTES_CENA = 1000;
+
+// Monta a cena: esferas de raio n/16 com cores e centros sorteados, ate que a fracao ocupacao dos voxels esteja ativa.
+// Ocupacoes muito altas podem nao ser atingidas: a montagem para quando um lote nao ativa nenhum voxel novo ou
+// depois de MAXIMO_LOTES_CENA lotes, avisando a ocupacao obtida
+static Sculptor* criaCena(int n, double ocupacao, VoxelStore::Layout layout, VoxelStore::Backend backend, int threads){
+    Sculptor *s = new Sculptor(n, n, n, layout, backend);
+    s->setThreads(threads);
+    mt19937 sorteio(1202);
+    uniform_int_distribution<int> centro(0, n-1);
+    uniform_real_distribution<float> cor(0.0f, 1.0f);
+    int raio = max(1, n/16);
+    double volumeEsfera = 4.0/3.0*M_PI*raio*raio*raio;
+    double total = (double)n*n*n, ativos = 0;
+    bool progrediu = true;
+    for(int lotes=0; ativos < ocupacao*total && progrediu && lotes < MAXIMO_LOTES_CENA; lotes++){
+        // Cada lote cobre o que falta sem considerar as sobreposicoes; a contagem real decide se precisa de outro
+        int esferas = max(1, (int)((ocupacao*total - ativos)/volumeEsfera));
+        vector<Operacao> lote;
+        for(int t=0; t<esferas; t++){
+            lote.push_back(Operacao::setColor(cor(sorteio), cor(sorteio), cor(sorteio), 1.0f));
+            int x = centro(sorteio), y = centro(sorteio), z = centro(sorteio);
+            lote.push_back(Operacao::primitiva(Operacao::PutSphere, x, y, z, raio));
+        }
+        s->aplicaLote(lote);
+        double anteriores = ativos;
+        ativos = (double)contaAtivos(*s);
+        progrediu = ativos > anteriores;
+    }
+    if(ativos < ocupacao*total){
+        fprintf(stderr, "aviso: cena %d^3 com ocupacao %g em vez de %g\n", n, ativos/total, ocupacao);
+    }
+    return s;
+}
+
+// Repete operacao ate somar tempoMinimo segundos (ao menos uma vez); preparacao roda antes de cada repeticao, fora do tempo
+static void mede(int &repeticoes, double &segundos, double tempoMinimo,
+                 const function<void()> &preparacao, const function<void()> &operacao, const function<void()> &limpeza){
+    double total = 0;
+    repeticoes = 0;
+    do{
+        preparacao();
+        auto inicio = chrono::steady_clock::now();
+        operacao();
+        total += chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+        limpeza();
+        repeticoes++;
+    } while(total < tempoMinimo);
+    segundos = total/repeticoes;
+}
+
+// Le uma lista de numeros separados por virgula
+template<typename T>
+static bool leLista(const char *texto, vector<T> &lista){
+    lista.clear();
+    stringstream s(texto);
+    string item;
+    while(getline(s, item, ',')){
+        stringstream conversao(item);
+        T valor;
+        if(!(conversao >> valor)){
+            return false;
+        }
+        lista.push_back(valor);
+    }
+    return !lista.empty();
+}
+
+static void uso(const char *programa){
+    fprintf(stderr,
+            "uso: %s [opcoes]\n"
+            "  -n 32,64,...     arestas das grades, maiores que 0 (padrao 32,64,128,256,512)\n"
+            "  -o 0.01,0.1,...  ocupacoes das cenas, maiores que 0 e ate 1 (padrao 0.01,0.1,0.5)\n"
+            "  -m segundos      tempo minimo de cada medicao (padrao 0.5)\n"
+            "  -t threads       threads do escultor (padrao 0 = uma por nucleo)\n"
+            "  -b denso|esparso armazenamento (padrao denso)\n"
+            "  -l soa|aos       layout das cores (padrao soa)\n"
+            "  -d diretorio     onde os arquivos gravados sao criados e apagados (padrao .)\n"
+            "  -j arquivo       grava tambem os resultados em JSON ('-' para a saida padrao)\n",
+            programa);
+}
+
+int main(int argc, char *argv[])
+{
+    vector<int> tamanhos = {32, 64, 128, 256, 512};
+    vector<double> ocupacoes = {0.01, 0.1, 0.5};
+    double tempoMinimo = 0.5;
+    int threads = 0;
+    VoxelStore::Backend backend = VoxelStore::Denso;
+    VoxelStore::Layout layout = VoxelStore::SoA;
+    string diretorio = ".", json;
+
+    for(int t=1; t<argc; t++){
+        if(t+1 >= argc || argv[t][0] != '-' || strlen(argv[t]) != 2){
+            uso(argv[0]);
+            return 2;
+        }
+        const char *valor = argv[++t];
+        bool valido = true;
+        switch(argv[t-1][1]){
+        case 'n':
+            valido = leLista(valor, tamanhos) && all_of(tamanhos.begin(), tamanhos.end(), [](int n){ return n > 0; });
+            break;
+        case 'o':
+            valido = leLista(valor, ocupacoes) &&
+                     all_of(ocupacoes.begin(), ocupacoes.end(), [](double o){ return o > 0 && o <= 1; });
+            break;
+        case 'm': tempoMinimo = atof(valor); break;
+        case 't': threads = atoi(valor); break;
+        case 'b': backend = strcmp(valor, "esparso") == 0 ? VoxelStore::Esparso : VoxelStore::Denso; break;
+        case 'l': layout = strcmp(valor, "aos") == 0 ? VoxelStore::AoS : VoxelStore::SoA; break;
+        case 'd': diretorio = valor; break;
+        case 'j': json = valor; break;
+        default: valido = false;
+        }
+        if(!valido){
+            uso(argv[0]);
+            return 2;
+        }
+    }
+
+    vector<Medicao> medicoes;
+    printf("%7s %9s %-14s %5s %12s %12s %10s %10s\n",
+           "aresta", "ocupacao", "operacao", "rep", "tempo (ms)", "Mvoxels/s", "MB/s", "pico (MB)");
+
+    for(size_t a=0; a<tamanhos.size(); a++){
+        int n = tamanhos[a];
+        // Primitivas centradas, com caixa envolvente de metade da aresta em cada eixo
+        int c = n/2, r = max(1, n/4);
+        struct Caso{ const char *nome; Operacao op; };
+        vector<Caso> primitivas = {
+            {"putBox", Operacao::primitiva(Operacao::PutBox, c-r, c+r-1, c-r, c+r-1, c-r, c+r-1)},
+            {"cutBox", Operacao::primitiva(Operacao::CutBox, c-r, c+r-1, c-r, c+r-1, c-r, c+r-1)},
+            {"putSphere", Operacao::primitiva(Operacao::PutSphere, c, c, c, r)},
+            {"cutSphere", Operacao::primitiva(Operacao::CutSphere, c, c, c, r)},
+            {"putEllipsoid", Operacao::primitiva(Operacao::PutEllipsoid, c, c, c, r, max(1, 2*r/3), max(1, r/2))},
+            {"cutEllipsoid", Operacao::primitiva(Operacao::CutEllipsoid, c, c, c, r, max(1, 2*r/3), max(1, r/2))}
+        };
+        // Voxels de cada primitiva: contados uma vez, aplicando-a a uma grade vazia
+        vector<double> voxelsPrimitiva;
+        for(size_t p=0; p<primitivas.size(); p++){
+            Sculptor vazio(n, n, n, layout, VoxelStore::Esparso);
+            // A variante cut processa os mesmos voxels que a put
+            Operacao op = primitivas[p].op;
+            if(op.tipo == Operacao::CutBox) op.tipo = Operacao::PutBox;
+            if(op.tipo == Operacao::CutSphere) op.tipo = Operacao::PutSphere;
+            if(op.tipo == Operacao::CutEllipsoid) op.tipo = Operacao::PutEllipsoid;
+            vazio.aplicaLote(vector<Operacao>(1, op));
+            voxelsPrimitiva.push_back((double)contaAtivos(vazio));
+        }
+        // Voxels isolados: posicoes sorteadas (com repeticoes), no maximo um milhao por repeticao
+        int isolados = (int)min<long long>((long long)n*n*n/8, 1 << 20);
+        vector<int> posicoes(3*(size_t)isolados);
+        mt19937 sorteio(2019);
+        uniform_int_distribution<int> coordenada(0, n-1);
+        for(size_t t=0; t<posicoes.size(); t++){
+            posicoes[t] = coordenada(sorteio);
+        }
+
+        for(size_t o=0; o<ocupacoes.size(); o++){
+            Sculptor *cena = criaCena(n, ocupacoes[o], layout, backend, threads);
+            double ocupacao = (double)contaAtivos(*cena)/((double)n*n*n);
+            Sculptor *copia = nullptr;
+            auto novaCopia = [&](){ copia = cena->copia(); };
+            auto descartaCopia = [&](){ delete copia; copia = nullptr; };
+            auto nada = [](){};
+
+            auto registra = [&](const char *operacao, int repeticoes, double segundos, double voxels, double bytes){
+                Medicao m = {operacao, n, ocupacao, repeticoes, segundos, voxels, bytes, picoRSS()};
+                medicoes.push_back(m);
+                printf("%7d %9.4f %-14s %5d %12.3f %12.2f ", n, ocupacao, operacao, repeticoes, 1000*segundos,
+                       voxels/segundos/1e6);
+                if(bytes > 0){
+                    printf("%10.1f", bytes/segundos/1e6);
+                }
+                else{
+                    printf("%10s", "-");
+                }
+                printf(" %10.1f\n", m.picoRSS/1e6);
+                fflush(stdout);
+            };
+
+            int repeticoes;
+            double segundos;
+            mede(repeticoes, segundos, tempoMinimo, novaCopia, [&](){
+                copia->setColor(1, 0, 0, 1);
+                for(int t=0; t<isolados; t++){
+                    copia->putVoxel(posicoes[3*t], posicoes[3*t+1], posicoes[3*t+2]);
+                }
+            }, descartaCopia);
+            registra("putVoxel", repeticoes, segundos, isolados, 0);
+            mede(repeticoes, segundos, tempoMinimo, novaCopia, [&](){
+                for(int t=0; t<isolados; t++){
+                    copia->cutVoxel(posicoes[3*t], posicoes[3*t+1], posicoes[3*t+2]);
+                }
+            }, descartaCopia);
+            registra("cutVoxel", repeticoes, segundos, isolados, 0);
+
+            for(size_t p=0; p<primitivas.size(); p++){
+                const Operacao &op = primitivas[p].op;
+                mede(repeticoes, segundos, tempoMinimo, novaCopia, [&](){
+                    copia->setColor(0, 0, 1, 1);
+                    switch(op.tipo){
+                    case Operacao::PutBox: copia->putBox(op.p[0], op.p[1], op.p[2], op.p[3], op.p[4], op.p[5]); break;
+                    case Operacao::CutBox: copia->cutBox(op.p[0], op.p[1], op.p[2], op.p[3], op.p[4], op.p[5]); break;
+                    case Operacao::PutSphere: copia->putSphere(op.p[0], op.p[1], op.p[2], op.p[3]); break;
+                    case Operacao::CutSphere: copia->cutSphere(op.p[0], op.p[1], op.p[2], op.p[3]); break;
+                    case Operacao::PutEllipsoid: copia->putEllipsoid(op.p[0], op.p[1], op.p[2], op.p[3], op.p[4], op.p[5]); break;
+                    case Operacao::CutEllipsoid: copia->cutEllipsoid(op.p[0], op.p[1], op.p[2], op.p[3], op.p[4], op.p[5]); break;
+                    default: break;
+                    }
+                }, descartaCopia);
+                registra(primitivas[p].nome, repeticoes, segundos, voxelsPrimitiva[p], 0);
+            }
+
+            mede(repeticoes, segundos, tempoMinimo, novaCopia, [&](){ copia->otimizar(); }, descartaCopia);
+            registra("otimizar", repeticoes, segundos, (double)n*n*n, 0);
+
+            // As gravacoes nao alteram a cena; os voxels processados sao os visiveis, que sao os gravados
+            double visiveis = (double)cena->contaVisiveis();
+            string arquivo = diretorio + "/desempenho_escultor";
+            double bytes = 0;
+            mede(repeticoes, segundos, tempoMinimo, nada, [&](){ cena->writeOFF(arquivo + ".off"); },
+                 [&](){ bytes = tamanhoArquivo(arquivo + ".off"); remove((arquivo + ".off").c_str()); });
+            registra("writeOFF", repeticoes, segundos, visiveis, bytes);
+            mede(repeticoes, segundos, tempoMinimo, nada, [&](){ cena->writeVECT(arquivo + ".vect"); },
+                 [&](){ bytes = tamanhoArquivo(arquivo + ".vect"); remove((arquivo + ".vect").c_str()); });
+            registra("writeVECT", repeticoes, segundos, visiveis, bytes);
+
+            delete cena;
+        }
+    }
+
+    if(!json.empty()){
+        FILE *saida = json == "-" ? stdout : fopen(json.c_str(), "w");
+        if(saida == nullptr){
+            fprintf(stderr, "nao foi possivel gravar %s\n", json.c_str());
+            return 1;
+        }
+        fprintf(saida, "{\n  \"threads\": %d,\n  \"backend\": \"%s\",\n  \"layout\": \"%s\",\n  \"medicoes\": [\n",
+                threads, backend == VoxelStore::Esparso ? "esparso" : "denso", layout == VoxelStore::AoS ? "aos" : "soa");
+        for(size_t t=0; t<medicoes.size(); t++){
+            const Medicao &m = medicoes[t];
+            fprintf(saida, "    {\"operacao\": \"%s\", \"aresta\": %d, \"ocupacao\": %.6f, \"repeticoes\": %d, "
+                           "\"segundos\": %.9g, \"voxels\": %.0f, \"voxelsPorSegundo\": %.6g, ",
+                    m.operacao.c_str(), m.tamanho, m.ocupacao, m.repeticoes, m.segundos, m.voxels, m.voxels/m.segundos);
+            if(m.bytes > 0){
+                fprintf(saida, "\"bytes\": %.0f, \"bytesPorSegundo\": %.6g, ", m.bytes, m.bytes/m.segundos);
+            }
+            else{
+                fprintf(saida, "\"bytes\": null, \"bytesPorSegundo\": null, ");
+            }
+            fprintf(saida, "\"picoRSS\": %zu}%s\n", m.picoRSS, t+1 < medicoes.size() ? "," : "");
+        }
+        fprintf(saida, "  ]\n}\n");
+        if(saida != stdout){
+            fclose(saida);
+        }
+    }
+    return 0;
+}
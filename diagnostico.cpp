@@ -0,0 +1,25 @@
+#include "diagnostico.h"
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+using namespace std;
+
+// Nivel inicial: o da variavel de ambiente SCULPTOR_DIAGNOSTICO, se valida, ou Aviso
+static int nivelInicial(){
+    const char *valor = getenv("SCULPTOR_DIAGNOSTICO");
+    if(valor != nullptr && valor[0] >= '0' && valor[0] <= '4' && valor[1] == '\0'){
+        return valor[0] - '0';
+    }
+    return Diagnostico::Aviso;
+}
+
+atomic<int> Diagnostico::nivel(nivelInicial());
+
+// Uma mensagem por vez, para que as de threads diferentes nao se misturem
+void Diagnostico::escreve(Nivel n, const string &mensagem){
+    static mutex saida;
+    static const char *prefixos[] = {"", "[erro] ", "[aviso] ", "[info] ", "[depuracao] "};
+    lock_guard<mutex> guarda(saida);
+    cerr << prefixos[n] << mensagem << endl;
+}
@@ -0,0 +1,65 @@
+#ifndef DIAGNOSTICO_H
+#define DIAGNOSTICO_H
+
+#include <atomic>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief DIAGNOSTICO_NIVEL_MAXIMO : nivel mais detalhado compilado no programa (ver Diagnostico::Nivel).
+ * Mensagens acima dele sao removidas pelo compilador; por padrao as de depuracao nao sao compiladas.
+ */
+#ifndef DIAGNOSTICO_NIVEL_MAXIMO
+#define DIAGNOSTICO_NIVEL_MAXIMO 3
+#endif
+
+/**
+ * @brief DIAGNOSTICO : escreve uma mensagem de diagnostico no nivel dado, montada com operator<<
+ * (ex.: DIAGNOSTICO(Diagnostico::Aviso, "planos " << z0 << " a " << z1)).
+ * A mensagem so eh montada se o nivel estiver compilado e ativo no momento.
+ */
+#define DIAGNOSTICO(nivel, mensagem) \
+    do{ \
+        if((int)(nivel) <= DIAGNOSTICO_NIVEL_MAXIMO && Diagnostico::ativo(nivel)){ \
+            std::ostringstream diagnostico_texto_; \
+            diagnostico_texto_ << mensagem; \
+            Diagnostico::escreve((nivel), diagnostico_texto_.str()); \
+        } \
+    } while(0)
+
+/**
+ * @brief A classe Diagnostico
+ * controla as mensagens de diagnostico do programa, escritas em std::cerr com o nivel como prefixo.
+ * O nivel ativo pode ser alterado durante a execucao com setNivel() ou, na inicializacao, pela variavel de ambiente
+ * SCULPTOR_DIAGNOSTICO (0 a 4); por padrao apenas erros e avisos sao escritos.
+ * Eventos frequentes (como acessos fora dos limites) nao devem gerar mensagens: sao contados e consultados depois.
+ */
+class Diagnostico
+{
+public:
+    /**
+     * @brief Nivel : niveis das mensagens, do menos para o mais detalhado
+     */
+    enum Nivel { Silencioso = 0, Erro = 1, Aviso = 2, Info = 3, Depuracao = 4 };
+
+    /**
+     * @brief setNivel, getNivel : nivel mais detalhado escrito a partir de agora
+     */
+    static void setNivel(Nivel n) { nivel.store(n, std::memory_order_relaxed); }
+    static Nivel getNivel() { return (Nivel)nivel.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief ativo : true se as mensagens do nivel n sao escritas
+     */
+    static bool ativo(Nivel n) { return (int)n <= nivel.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief escreve : escreve a mensagem com o prefixo do nivel (use a macro DIAGNOSTICO, que evita montar mensagens inativas)
+     */
+    static void escreve(Nivel n, const std::string &mensagem);
+
+private:
+    static std::atomic<int> nivel;
+};
+
+#endif // DIAGNOSTICO_H
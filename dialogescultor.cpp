@@ -1,11 +1,35 @@
 #include "dialogescultor.h"
 #include "ui_dialogescultor.h"
+#include "sculptor.h"
+#include <QPushButton>
+#include <string>
+
+// Bytes em MiB com uma casa decimal
+static QString descreveBytes(size_t bytes)
+{
+    return QString::number(bytes/(1024.0*1024.0),'f',1) + " MiB";
+}
 
 DialogEscultor::DialogEscultor(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::DialogEscultor)
 {
     ui->setupUi(this);
+
+    // A memoria projetada acompanha as dimensoes escolhidas
+    connect(ui->spinBoxLinhas,
+            SIGNAL(valueChanged(int)),
+            this,
+            SLOT(atualizaMemoria()));
+    connect(ui->spinBoxColunas,
+            SIGNAL(valueChanged(int)),
+            this,
+            SLOT(atualizaMemoria()));
+    connect(ui->spinBoxPlanos,
+            SIGNAL(valueChanged(int)),
+            this,
+            SLOT(atualizaMemoria()));
+    atualizaMemoria();
 }
 
 DialogEscultor::~DialogEscultor()
@@ -27,3 +51,33 @@ int DialogEscultor::getNumPlanos()
 {
     return ui->spinBoxPlanos->value();
 }
+
+void DialogEscultor::atualizaMemoria()
+{
+    int linhas = getNumLinhas(), colunas = getNumColunas(), planos = getNumPlanos();
+    QPushButton *ok = ui->buttonBox->button(QDialogButtonBox::Ok);
+    ok->setEnabled(true);
+    if (linhas == 0 || colunas == 0 || planos == 0){
+        ui->labelMemoria->setText(tr("Memoria do escultor: -"));
+        return;
+    }
+    // O mesmo teste feito pelo Plotter antes de criar o escultor
+    VoxelStore::Backend backend = VoxelStore::Denso;
+    std::string erro;
+    if (!Sculptor::cabeNoOrcamento(linhas,colunas,planos,VoxelStore::SoA,backend,&erro)){
+        ui->labelMemoria->setText(QString::fromStdString(erro));
+        ok->setEnabled(false);
+        return;
+    }
+    size_t bytes = Sculptor::memoriaProjetada(linhas,colunas,planos,VoxelStore::SoA,backend);
+    if (backend == VoxelStore::Esparso){
+        ui->labelMemoria->setText(tr("Memoria do escultor: %1 no inicio, crescendo com os voxels desenhados "
+                                     "(esparso: o denso, com %2, excede o orcamento de %3)")
+                                  .arg(descreveBytes(bytes))
+                                  .arg(descreveBytes(Sculptor::memoriaProjetada(linhas,colunas,planos)))
+                                  .arg(descreveBytes(Sculptor::getOrcamentoMemoria())));
+    }
+    else {
+        ui->labelMemoria->setText(tr("Memoria do escultor: %1").arg(descreveBytes(bytes)));
+    }
+}
@@ -40,6 +40,13 @@ public:
      */
     int getNumPlanos();
 
+private slots:
+    /**
+     * @brief atualizaMemoria : mostra a memoria que o escultor com as dimensoes escolhidas vai alocar e impede a
+     * confirmacao se ele nao couber no orcamento de memoria (Sculptor::setOrcamentoMemoria)
+     */
+    void atualizaMemoria();
+
 private:
     Ui::DialogEscultor *ui;
 };
@@ -0,0 +1,70 @@
+#include "exportador.h"
+#include "diagnostico.h"
+
+Exportador::Exportador(Sculptor *_copia, const QString &_arquivo, Formato _formato, QObject *parent) : QThread(parent)
+{
+    copia = _copia;
+    arquivo = _arquivo;
+    formato = _formato;
+    cancelar = false;
+    ultimoProgresso = -1;
+}
+
+Exportador::~Exportador()
+{
+    cancela();
+    wait();
+    delete copia;
+}
+
+void Exportador::cancela()
+{
+    cancelar = true;
+}
+
+void Exportador::run()
+{
+    // Chamado pelos write* na thread do exportador: emite a porcentagem e verifica o cancelamento
+    copia->setProgresso([this](double fracao){
+        int porcento = (int)(100*fracao);
+        if(porcento != ultimoProgresso){
+            ultimoProgresso = porcento;
+            emit progresso(porcento);
+        }
+        return !cancelar;
+    });
+
+    std::string nome = arquivo.toStdString();
+    bool gravado = grava(copia, nome, formato);
+    copia->setProgresso(std::function<bool(double)>());
+
+    if(gravado){
+        emit concluido(arquivo);
+    }
+    else if(cancelar){
+        emit cancelado(arquivo);
+    }
+    else{
+        DIAGNOSTICO(Diagnostico::Aviso, "Exportacao de " << nome << " falhou");
+        emit falhou(tr("Nao foi possivel gravar o arquivo %1").arg(arquivo));
+    }
+}
+
+bool Exportador::grava(Sculptor *s, const std::string &nome, Formato formato)
+{
+    switch(formato){
+    case OFF:
+        return s->writeOFF(nome, Sculptor::CubosPorVoxel);
+    case OFFCompacto:
+        return s->writeOFF(nome, Sculptor::MalhaGulosa);
+    case PLY:
+        return s->writePLY(nome);
+    case STL:
+        return s->writeSTL(nome);
+    case SCULPT:
+        return s->writeSCULPT(nome);
+    case VECT:
+        return s->writeVECT(nome);
+    }
+    return false;
+}
@@ -0,0 +1,94 @@
+#ifndef EXPORTADOR_H
+#define EXPORTADOR_H
+
+#include <QThread>
+#include <QString>
+#include <atomic>
+#include "sculptor.h"
+
+/**
+ * @brief The Exportador class
+ * grava uma copia do escultor (obtida com Sculptor::copia()) em uma thread propria, para que a janela continue
+ * respondendo e o escultor original possa continuar sendo alterado durante a gravacao.
+ * O progresso, o fim da gravacao e as falhas sao informados por sinais, entregues na thread de quem criou o exportador.
+ */
+class Exportador : public QThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Formato : formatos de arquivo que podem ser gravados (OFFCompacto usa Sculptor::MalhaGulosa)
+     */
+    enum Formato { OFF, OFFCompacto, PLY, STL, SCULPT, VECT };
+
+    /**
+     * @brief Exportador : prepara a gravacao; a thread so comeca com start()
+     * @param _copia : escultor a ser gravado, que passa a pertencer ao exportador e nao pode ser usado por mais ninguem
+     * @param _arquivo : caminho do arquivo
+     * @param _formato : formato do arquivo
+     */
+    Exportador(Sculptor *_copia, const QString &_arquivo, Formato _formato, QObject *parent = nullptr);
+    /**
+     * @brief ~Exportador : cancela a gravacao em andamento, espera a thread terminar e libera a copia
+     */
+    ~Exportador();
+
+    /**
+     * @brief grava : grava s no arquivo e formato dados, na thread de quem chama (usado por run() e quando nao ha
+     * memoria para a copia)
+     * @return false se o arquivo nao pode ser gravado ou se a gravacao foi cancelada
+     */
+    static bool grava(Sculptor *s, const std::string &nome, Formato formato);
+
+    /**
+     * @brief getArquivo : caminho do arquivo sendo gravado
+     */
+    QString getArquivo() const { return arquivo; }
+
+    /**
+     * @brief getMemoria : bytes alocados pela copia sendo gravada, incluindo os buffers da gravacao em andamento
+     */
+    Memoria getMemoria() const { return copia->getMemoria(); }
+
+public slots:
+    /**
+     * @brief cancela : pede a interrupcao da gravacao; o arquivo incompleto eh removido e o sinal cancelado() eh emitido
+     */
+    void cancela();
+
+signals:
+    /**
+     * @brief progresso : sinal emitido sempre que a porcentagem gravada (entre 0 e 100) muda
+     */
+    void progresso(int);
+    /**
+     * @brief concluido : sinal emitido quando o arquivo foi gravado por completo
+     */
+    void concluido(QString);
+    /**
+     * @brief cancelado : sinal emitido quando a gravacao foi interrompida por cancela()
+     */
+    void cancelado(QString);
+    /**
+     * @brief falhou : sinal emitido com a mensagem de erro quando o arquivo nao pode ser gravado
+     */
+    void falhou(QString);
+
+protected:
+    /**
+     * @brief run : grava a copia no formato escolhido (executado na thread do exportador)
+     */
+    void run();
+
+private:
+    Sculptor *copia;
+    QString arquivo;
+    Formato formato;
+    // Alterado pela thread da janela e lido pela thread do exportador
+    std::atomic<bool> cancelar;
+    // Ultima porcentagem emitida, para nao emitir um sinal a cada fatia
+    int ultimoProgresso;
+};
+
+#endif // EXPORTADOR_H
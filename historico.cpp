@@ -0,0 +1,247 @@
+#include "historico.h"
+#include "arquivosculpt.h"
+#include "diagnostico.h"
+#include "voxelstoreesparso.h"
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+static const int BLOCO_Z = VoxelStoreEsparso::BLOCO_Z;
+static const int BLOCO_X = VoxelStoreEsparso::BLOCO_X;
+
+// Cria o historico desligado, sem passos
+Historico::Historico(int _nx, int _ny, int _nz){
+    nx = _nx;
+    ny = _ny;
+    nz = _nz;
+    bz = (nz + BLOCO_Z - 1)/BLOCO_Z;
+    bx = (nx + BLOCO_X - 1)/BLOCO_X;
+    by = (ny + 63)/64;
+    orcamento = 0;
+    usado = 0;
+    passoAberto = false;
+    passoDescartado = false;
+}
+
+// Define o orcamento, descartando os passos que nao cabem nele
+void Historico::setOrcamento(size_t bytes){
+    orcamento = bytes;
+    if(orcamento == 0){
+        limpa();
+        return;
+    }
+    respeitaOrcamento();
+}
+
+// Abre um passo vazio
+void Historico::inicia(){
+    if(passoAberto){
+        return;
+    }
+    if(guardado.empty()){
+        guardado.assign((size_t)bz*bx*by, 0);
+    }
+    atual.blocos.clear();
+    atual.dados.clear();
+    atual.x0 = atual.z0 = 0;
+    atual.x1 = atual.z1 = -1;
+    passoAberto = true;
+    passoDescartado = false;
+}
+
+// Guarda os blocos da regiao que ainda nao estao no passo
+void Historico::registra(const VoxelStore *v, int x0, int x1, int y0, int y1, int z0, int z1){
+    if(!passoAberto || passoDescartado){
+        return;
+    }
+    x0 = max(x0, 0); x1 = min(x1, nx-1);
+    y0 = max(y0, 0); y1 = min(y1, ny-1);
+    z0 = max(z0, 0); z1 = min(z1, nz-1);
+    if(x0 > x1 || y0 > y1 || z0 > z1){
+        return;
+    }
+    for(int kz=z0/BLOCO_Z; kz<=z1/BLOCO_Z; kz++){
+        for(int kx=x0/BLOCO_X; kx<=x1/BLOCO_X; kx++){
+            for(int w=y0/64; w<=y1/64; w++){
+                size_t idx = ((size_t)kz*bx + kx)*by + w;
+                if(guardado[idx]){
+                    continue;
+                }
+                guardado[idx] = 1;
+                guardaBloco(v, kz, kx, w, atual);
+                // O passo aberto conta no orcamento: os passos antigos abrem espaco para ele e, se nem assim
+                // ele cabe, deixa de ser guardado junto com todo o historico
+                size_t aberto = tamanho(atual);
+                if(aberto > orcamento){
+                    liberaAtual();
+                    desfazer.clear();
+                    refazer.clear();
+                    usado = 0;
+                    passoDescartado = true;
+                    return;
+                }
+                respeitaOrcamento(aberto);
+            }
+        }
+    }
+}
+
+// Comprime o bloco no final dos dados do passo e amplia as linhas alteradas pelo passo
+void Historico::guardaBloco(const VoxelStore *v, int kz, int kx, int w, Passo &p){
+    Bloco b = {kz, kx, w, p.dados.size(), 0};
+    if(ArquivoSculpt::codificaBloco(v, kz, kx, w, p.dados)){
+        b.tamanho = p.dados.size() - b.inicio;
+    }
+    p.blocos.push_back(b);
+    int x0 = kx*BLOCO_X, x1 = min(x0 + BLOCO_X, nx) - 1;
+    int z0 = kz*BLOCO_Z, z1 = min(z0 + BLOCO_Z, nz) - 1;
+    if(p.x0 > p.x1){
+        p.x0 = x0; p.x1 = x1; p.z0 = z0; p.z1 = z1;
+    }
+    else{
+        p.x0 = min(p.x0, x0); p.x1 = max(p.x1, x1);
+        p.z0 = min(p.z0, z0); p.z1 = max(p.z1, z1);
+    }
+}
+
+// Fecha o passo; um passo sem blocos eh descartado
+void Historico::conclui(){
+    if(!passoAberto){
+        return;
+    }
+    passoAberto = false;
+    if(passoDescartado){
+        passoDescartado = false;
+        return;
+    }
+    for(size_t t=0; t<atual.blocos.size(); t++){
+        const Bloco &b = atual.blocos[t];
+        guardado[((size_t)b.kz*bx + b.kx)*by + b.w] = 0;
+    }
+    if(atual.blocos.empty()){
+        return;
+    }
+    for(size_t t=0; t<refazer.size(); t++){
+        usado -= tamanho(refazer[t]);
+    }
+    refazer.clear();
+    usado += tamanho(atual);
+    desfazer.push_back(move(atual));
+    atual = Passo();
+    respeitaOrcamento();
+}
+
+// Troca o ultimo passo feito pelo seu inverso, que passa a poder ser refeito
+bool Historico::desfaz(VoxelStore *v, int &x0, int &x1, int &z0, int &z1){
+    if(passoAberto || desfazer.empty()){
+        return false;
+    }
+    Passo inverso;
+    troca(desfazer.back(), v, inverso);
+    x0 = inverso.x0; x1 = inverso.x1; z0 = inverso.z0; z1 = inverso.z1;
+    usado -= tamanho(desfazer.back());
+    desfazer.pop_back();
+    usado += tamanho(inverso);
+    refazer.push_back(move(inverso));
+    if(!acomoda(refazer, desfazer)){
+        DIAGNOSTICO(Diagnostico::Aviso, "O passo desfeito nao cabe no orcamento do historico e nao podera ser refeito");
+    }
+    return true;
+}
+
+// Troca o ultimo passo desfeito pelo seu inverso, que volta a poder ser desfeito
+bool Historico::refaz(VoxelStore *v, int &x0, int &x1, int &z0, int &z1){
+    if(passoAberto || refazer.empty()){
+        return false;
+    }
+    Passo inverso;
+    troca(refazer.back(), v, inverso);
+    x0 = inverso.x0; x1 = inverso.x1; z0 = inverso.z0; z1 = inverso.z1;
+    usado -= tamanho(refazer.back());
+    refazer.pop_back();
+    usado += tamanho(inverso);
+    desfazer.push_back(move(inverso));
+    if(!acomoda(desfazer, refazer)){
+        DIAGNOSTICO(Diagnostico::Aviso, "O passo refeito nao cabe no orcamento do historico e nao podera ser desfeito");
+    }
+    return true;
+}
+
+// Para cada bloco: guarda o conteudo atual, desativa o bloco inteiro e ativa os voxels guardados
+void Historico::troca(const Passo &p, VoxelStore *v, Passo &inverso){
+    inverso.x0 = inverso.z0 = 0;
+    inverso.x1 = inverso.z1 = -1;
+    for(size_t t=0; t<p.blocos.size(); t++){
+        const Bloco &b = p.blocos[t];
+        guardaBloco(v, b.kz, b.kx, b.w, inverso);
+        int y0 = b.w*64, y1 = min(y0 + 64, ny) - 1;
+        for(int z=b.kz*BLOCO_Z; z<min(b.kz*BLOCO_Z + BLOCO_Z, nz); z++){
+            for(int x=b.kx*BLOCO_X; x<min(b.kx*BLOCO_X + BLOCO_X, nx); x++){
+                if(!v->linhaVazia(x, z)){
+                    v->desativa(x, z, y0, y1);
+                }
+            }
+        }
+        if(b.tamanho > 0){
+            ArquivoSculpt::decodificaBloco(&p.dados[b.inicio], b.tamanho, b.kz, b.kx, b.w, v);
+        }
+    }
+}
+
+// Bytes dos blocos comprimidos mais a lista de blocos
+size_t Historico::tamanho(const Passo &p){
+    return p.dados.capacity() + p.blocos.capacity()*sizeof(Bloco);
+}
+
+// Descarta primeiro os passos desfeitos mais antigos a serem refeitos, depois os feitos mais antigos
+void Historico::respeitaOrcamento(size_t reservado){
+    while(usado + reservado > orcamento && !refazer.empty()){
+        usado -= tamanho(refazer.front());
+        refazer.pop_front();
+    }
+    while(usado + reservado > orcamento && !desfazer.empty()){
+        usado -= tamanho(desfazer.front());
+        desfazer.pop_front();
+    }
+}
+
+// O passo movido eh o proximo a ser usado na sua pilha: os passos mais antigos de outra saem antes dele
+bool Historico::acomoda(deque<Passo> &pilha, deque<Passo> &outra){
+    while(usado > orcamento && !outra.empty()){
+        usado -= tamanho(outra.front());
+        outra.pop_front();
+    }
+    while(usado > orcamento && pilha.size() > 1){
+        usado -= tamanho(pilha.front());
+        pilha.pop_front();
+    }
+    if(usado > orcamento){
+        // Sozinho o passo nao cabe: as duas pilhas ficam vazias
+        usado -= tamanho(pilha.back());
+        pilha.pop_back();
+        return false;
+    }
+    return true;
+}
+
+// Descarta todos os passos, inclusive o aberto
+void Historico::limpa(){
+    desfazer.clear();
+    refazer.clear();
+    usado = 0;
+    if(passoAberto){
+        liberaAtual();
+    }
+}
+
+// Desmarca os blocos do passo aberto e devolve a memoria dele
+void Historico::liberaAtual(){
+    for(size_t t=0; t<atual.blocos.size(); t++){
+        const Bloco &b = atual.blocos[t];
+        guardado[((size_t)b.kz*bx + b.kx)*by + b.w] = 0;
+    }
+    atual = Passo();
+    atual.x0 = atual.z0 = 0;
+    atual.x1 = atual.z1 = -1;
+}
@@ -0,0 +1,128 @@
+#ifndef HISTORICO_H
+#define HISTORICO_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include "voxelstore.h"
+
+/**
+ * @brief A classe Historico
+ * guarda os passos de edicao do escultor para desfazer e refazer.
+ *
+ * Cada passo guarda apenas o conteudo anterior dos blocos que ele alterou (os mesmos blocos de BLOCO_Z planos x
+ * BLOCO_X linhas x 64 colunas do VoxelStoreEsparso), comprimidos no formato dos blocos dos arquivos .sculpt;
+ * blocos que estavam vazios nao ocupam nada alem da sua posicao. Desfazer (ou refazer) um passo troca o conteudo
+ * atual desses blocos pelo guardado, guardando o atual para a operacao inversa, logo o tempo e a memoria sao
+ * proporcionais ao tamanho da edicao e nao ao do escultor.
+ *
+ * A memoria usada pelos passos, inclusive o aberto, eh limitada por um orcamento; quando ele eh ultrapassado os
+ * passos mais antigos sao descartados. Um passo aberto que sozinho nao cabe no orcamento deixa de ser guardado e,
+ * como os passos anteriores nao poderiam mais ser desfeitos sobre ele, todo o historico eh descartado.
+ * Com orcamento zero o historico fica desligado e nada eh guardado.
+ */
+class Historico
+{
+public:
+    /**
+     * @brief Historico : cria o historico (desligado) de um escultor nx x ny x nz
+     */
+    Historico(int _nx, int _ny, int _nz);
+
+    /**
+     * @brief setOrcamento : define quantos bytes os passos guardados podem ocupar (0 desliga o historico e descarta os passos)
+     */
+    void setOrcamento(size_t bytes);
+
+    size_t getOrcamento() const { return orcamento; }
+
+    /**
+     * @brief ativo : true se o historico esta ligado
+     */
+    bool ativo() const { return orcamento > 0; }
+
+    /**
+     * @brief memoria : bytes ocupados pelos passos guardados e pelo passo aberto
+     */
+    size_t memoria() const { return usado + (passoAberto ? tamanho(atual) : 0); }
+
+    /**
+     * @brief inicia : abre um novo passo; as alteracoes registradas ate conclui() formam um unico passo
+     */
+    void inicia();
+
+    /**
+     * @brief aberto : true se ha um passo aberto
+     */
+    bool aberto() const { return passoAberto; }
+
+    /**
+     * @brief registra : guarda o conteudo atual dos blocos que contem a regiao x∈[x0,x1], y∈[y0,y1], z∈[z0,z1]
+     * e que ainda nao foram guardados no passo aberto. Deve ser chamado antes de alterar a regiao.
+     */
+    void registra(const VoxelStore *v, int x0, int x1, int y0, int y1, int z0, int z1);
+
+    /**
+     * @brief conclui : fecha o passo aberto; se ele alterou algo, passa a ser o proximo a ser desfeito e os passos
+     * desfeitos deixam de poder ser refeitos
+     */
+    void conclui();
+
+    bool podeDesfazer() const { return !desfazer.empty(); }
+    bool podeRefazer() const { return !refazer.empty(); }
+
+    /**
+     * @brief desfaz, refaz : restaura em v o ultimo passo feito (ou desfeito)
+     * @param x0, x1, z0, z1 : recebem as linhas alteradas
+     * @return false se nao ha passo para desfazer (refazer)
+     */
+    bool desfaz(VoxelStore *v, int &x0, int &x1, int &z0, int &z1);
+    bool refaz(VoxelStore *v, int &x0, int &x1, int &z0, int &z1);
+
+    /**
+     * @brief limpa : descarta todos os passos
+     */
+    void limpa();
+
+private:
+    struct Bloco{
+        int kz, kx, w;
+        // Trecho dos dados do passo com o bloco comprimido (tamanho zero: bloco vazio)
+        size_t inicio, tamanho;
+    };
+    struct Passo{
+        std::vector<Bloco> blocos;
+        std::vector<unsigned char> dados;
+        int x0, x1, z0, z1;
+    };
+
+    int nx, ny, nz;
+    // Numero de blocos em z, em x e em y
+    int bz, bx, by;
+    size_t orcamento, usado;
+    bool passoAberto;
+    // O passo aberto ultrapassou o orcamento e nao eh mais guardado ate conclui()
+    bool passoDescartado;
+    Passo atual;
+    // Indica, para cada bloco, se ele ja foi guardado no passo aberto
+    std::vector<char> guardado;
+    std::deque<Passo> desfazer;
+    std::deque<Passo> refazer;
+
+    // Bytes ocupados por um passo
+    static size_t tamanho(const Passo &p);
+    // Guarda o conteudo atual de um bloco no passo p
+    void guardaBloco(const VoxelStore *v, int kz, int kx, int w, Passo &p);
+    // Restaura os blocos de p em v, guardando em inverso o conteudo que eles tinham
+    void troca(const Passo &p, VoxelStore *v, Passo &inverso);
+    // Descarta os passos mais antigos ate que a memoria usada, mais reservado, caiba no orcamento
+    void respeitaOrcamento(size_t reservado = 0);
+    // Depois de mover um passo para o topo de pilha (desfazer ou refazer), descarta primeiro os passos mais antigos
+    // de outra e depois os de pilha, mas nunca o que acabou de ser movido, salvo se ele sozinho nao cabe no
+    // orcamento; retorna false nesse caso
+    bool acomoda(std::deque<Passo> &pilha, std::deque<Passo> &outra);
+    // Libera o passo aberto, desmarcando os seus blocos
+    void liberaAtual();
+};
+
+#endif // HISTORICO_H
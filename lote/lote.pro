@@ -0,0 +1,48 @@
+#-------------------------------------------------
+#
+# Execucao de roteiros do escultor sem interface grafica:
+# usa apenas o nucleo do escultor (sem Qt)
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt app_bundle
+CONFIG   += console c++11
+
+TARGET = escultor_lote
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+unix: LIBS += -lpthread
+
+SOURCES += \
+        main.cpp \
+        roteiro.cpp \
+        ../arquivosculpt.cpp \
+        ../arvorecsg.cpp \
+        ../diagnostico.cpp \
+        ../historico.cpp \
+        ../pooltrabalho.cpp \
+        ../saidabufferizada.cpp \
+        ../sculptor.cpp \
+        ../voxelstore.cpp \
+        ../voxelstoreesparso.cpp
+
+HEADERS += \
+        roteiro.h \
+        ../arquivosculpt.h \
+        ../arvorecsg.h \
+        ../diagnostico.h \
+        ../historico.h \
+        ../pooltrabalho.h \
+        ../primitiva.h \
+        ../saidabufferizada.h \
+        ../sculptor.h \
+        ../voxelstore.h \
+        ../voxelstoreesparso.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,92 @@
+#include "roteiro.h"
+#include "pooltrabalho.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Executa roteiros do escultor sem interface grafica.
+// Varios roteiros sao executados ao mesmo tempo (um por thread); os nucleos restantes sao divididos entre os escultores.
+static void uso(const char *programa){
+    cerr << "uso: " << programa << " [-j roteiros_em_paralelo] [-t threads_por_escultor] roteiro...\n"
+         << "     '-' le os caminhos dos roteiros da entrada padrao, um por linha\n";
+}
+
+int main(int argc, char *argv[])
+{
+    int paralelos = 0, threads = -1;
+    vector<string> roteiros;
+    for(int t=1; t<argc; t++){
+        if((strcmp(argv[t], "-j") == 0 || strcmp(argv[t], "-t") == 0) && t+1 < argc){
+            int valor = atoi(argv[t+1]);
+            if(valor < 0){
+                uso(argv[0]);
+                return 2;
+            }
+            (argv[t][1] == 'j' ? paralelos : threads) = valor;
+            t++;
+        }
+        else if(strcmp(argv[t], "-") == 0){
+            string linha;
+            while(getline(cin, linha)){
+                if(!linha.empty()){
+                    roteiros.push_back(linha);
+                }
+            }
+        }
+        else if(argv[t][0] == '-'){
+            uso(argv[0]);
+            return 2;
+        }
+        else{
+            roteiros.push_back(argv[t]);
+        }
+    }
+    if(roteiros.empty()){
+        uso(argv[0]);
+        return 2;
+    }
+
+    int nucleos = max(1, (int)thread::hardware_concurrency());
+    if(paralelos == 0){
+        paralelos = nucleos;
+    }
+    paralelos = min(paralelos, (int)roteiros.size());
+    // Sem -t, cada escultor usa a sua parte dos nucleos (um roteiro sozinho usa todos)
+    if(threads < 0){
+        threads = max(1, nucleos/paralelos);
+    }
+
+    mutex saida;
+    int falhas = 0;
+    PoolTrabalho pool(paralelos);
+    pool.executa((int)roteiros.size(), [&](int t){
+        auto inicio = chrono::steady_clock::now();
+        Roteiro roteiro(threads);
+        bool ok = roteiro.executa(roteiros[t]);
+        double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+
+        lock_guard<mutex> guarda(saida);
+        if(ok){
+            printf("ok %s (%d arquivos, %.3f s)\n", roteiros[t].c_str(), (int)roteiro.getGravados().size(), segundos);
+        }
+        else{
+            fprintf(stderr, "%s\n", roteiro.getErro().c_str());
+            falhas++;
+        }
+    });
+
+    if(falhas > 0){
+        fprintf(stderr, "%d de %d roteiros falharam\n", falhas, (int)roteiros.size());
+        return 1;
+    }
+    return 0;
+}
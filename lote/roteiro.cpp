@@ -0,0 +1,263 @@
+#include "roteiro.h"
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+// Palavra em minusculas, para comparar comandos e opcoes
+static string minusculas(string s){
+    for(size_t t=0; t<s.size(); t++){
+        s[t] = (char)tolower((unsigned char)s[t]);
+    }
+    return s;
+}
+
+// Converte a palavra inteira em um int; false se ela nao for um inteiro valido
+static bool leInteiro(const string &s, int &valor){
+    char *fim;
+    errno = 0;
+    long v = strtol(s.c_str(), &fim, 10);
+    if(s.empty() || *fim != '\0' || errno != 0 || v < INT_MIN || v > INT_MAX){
+        return false;
+    }
+    valor = (int)v;
+    return true;
+}
+
+// Converte a palavra inteira em um float; false se ela nao for um numero valido
+static bool leReal(const string &s, float &valor){
+    char *fim;
+    valor = strtof(s.c_str(), &fim);
+    return !s.empty() && *fim == '\0';
+}
+
+// Formato de gravacao pela extensao do arquivo ("" se desconhecida)
+static string formatoDaExtensao(const string &arquivo){
+    size_t ponto = arquivo.find_last_of('.');
+    size_t barra = arquivo.find_last_of('/');
+    if(ponto == string::npos || (barra != string::npos && ponto < barra)){
+        return "";
+    }
+    string extensao = minusculas(arquivo.substr(ponto + 1));
+    if(extensao == "off" || extensao == "vect" || extensao == "ply" || extensao == "stl" || extensao == "sculpt"){
+        return extensao;
+    }
+    return "";
+}
+
+Roteiro::Roteiro(int _threads){
+    threads = _threads;
+    sculptor = nullptr;
+}
+
+Roteiro::~Roteiro(){
+    delete sculptor;
+}
+
+bool Roteiro::executa(const string &caminho){
+    erro.clear();
+    gravados.clear();
+    pendentes.clear();
+    delete sculptor;
+    sculptor = nullptr;
+
+    ifstream entrada(caminho.c_str());
+    if(!entrada){
+        erro = caminho + ": nao foi possivel abrir o roteiro";
+        return false;
+    }
+    size_t barra = caminho.find_last_of('/');
+    string diretorio = (barra == string::npos) ? "" : caminho.substr(0, barra + 1);
+
+    string linha;
+    int numero = 0;
+    while(getline(entrada, linha)){
+        numero++;
+        size_t comentario = linha.find('#');
+        if(comentario != string::npos){
+            linha.erase(comentario);
+        }
+        istringstream palavras(linha);
+        vector<string> cmd;
+        string palavra;
+        while(palavras >> palavra){
+            cmd.push_back(palavra);
+        }
+        if(cmd.empty()){
+            continue;
+        }
+        string mensagem;
+        bool ok;
+        // Falta de memoria interrompe so este roteiro, com a linha que a causou, e nao o lote inteiro
+        try{
+            ok = comando(cmd, diretorio, mensagem);
+        }
+        catch(const bad_alloc &){
+            ok = false;
+            mensagem = "memoria insuficiente para executar o comando";
+        }
+        catch(const length_error &){
+            ok = false;
+            mensagem = "memoria insuficiente para executar o comando (tamanho excessivo)";
+        }
+        if(!ok){
+            ostringstream s;
+            s << caminho << ":" << numero << ": " << mensagem;
+            erro = s.str();
+            return false;
+        }
+    }
+    return true;
+}
+
+void Roteiro::aplicaPendentes(){
+    if(!pendentes.empty()){
+        sculptor->aplicaLote(pendentes);
+        pendentes.clear();
+    }
+}
+
+bool Roteiro::comando(const vector<string> &palavras, const string &diretorio, string &mensagem){
+    string nome = minusculas(palavras[0]);
+    int argumentos = (int)palavras.size() - 1;
+
+    if(nome == "dim"){
+        int n[3];
+        if(argumentos < 3 || argumentos > 5){
+            mensagem = "uso: dim nx ny nz [denso|esparso] [aos|soa]";
+            return false;
+        }
+        for(int t=0; t<3; t++){
+            if(!leInteiro(palavras[t+1], n[t]) || n[t] <= 0){
+                mensagem = "dimensao invalida: " + palavras[t+1];
+                return false;
+            }
+        }
+        VoxelStore::Backend backend = VoxelStore::Denso;
+        VoxelStore::Layout layout = VoxelStore::SoA;
+        for(int t=4; t<=argumentos; t++){
+            string opcao = minusculas(palavras[t]);
+            if(opcao == "denso") backend = VoxelStore::Denso;
+            else if(opcao == "esparso") backend = VoxelStore::Esparso;
+            else if(opcao == "aos") layout = VoxelStore::AoS;
+            else if(opcao == "soa") layout = VoxelStore::SoA;
+            else{
+                mensagem = "opcao desconhecida: " + palavras[t];
+                return false;
+            }
+        }
+        // Com um orcamento de memoria (SCULPTOR_ORCAMENTO_MEMORIA) o denso pode virar esparso ou o escultor ser recusado
+        string erro;
+        if(!Sculptor::cabeNoOrcamento(n[0], n[1], n[2], layout, backend, &erro)){
+            mensagem = erro;
+            return false;
+        }
+        pendentes.clear();
+        delete sculptor;
+        sculptor = nullptr;
+        sculptor = new Sculptor(n[0], n[1], n[2], layout, backend);
+        sculptor->setThreads(threads);
+        return true;
+    }
+
+    if(nome == "threads"){
+        int n;
+        if(argumentos != 1 || !leInteiro(palavras[1], n) || n < 0){
+            mensagem = "uso: threads n (n >= 0)";
+            return false;
+        }
+        threads = n;
+        if(sculptor != nullptr){
+            sculptor->setThreads(n);
+        }
+        return true;
+    }
+
+    if(sculptor == nullptr){
+        mensagem = "o comando " + palavras[0] + " precisa de um escultor (use dim antes)";
+        return false;
+    }
+
+    if(nome == "setcolor"){
+        float c[4];
+        if(argumentos != 4){
+            mensagem = "uso: setColor r g b a";
+            return false;
+        }
+        for(int t=0; t<4; t++){
+            if(!leReal(palavras[t+1], c[t])){
+                mensagem = "componente de cor invalida: " + palavras[t+1];
+                return false;
+            }
+        }
+        pendentes.push_back(Operacao::setColor(c[0], c[1], c[2], c[3]));
+        return true;
+    }
+
+    if(nome == "write"){
+        if(argumentos < 1 || argumentos > 2){
+            mensagem = "uso: write arquivo [off|offcompacto|vect|ply|stl|sculpt]";
+            return false;
+        }
+        string arquivo = palavras[1];
+        if(arquivo[0] != '/'){
+            arquivo = diretorio + arquivo;
+        }
+        string formato = (argumentos == 2) ? minusculas(palavras[2]) : formatoDaExtensao(arquivo);
+        aplicaPendentes();
+        bool gravado;
+        if(formato == "off") gravado = sculptor->writeOFF(arquivo, Sculptor::CubosPorVoxel);
+        else if(formato == "offcompacto") gravado = sculptor->writeOFF(arquivo, Sculptor::MalhaGulosa);
+        else if(formato == "vect") gravado = sculptor->writeVECT(arquivo);
+        else if(formato == "ply") gravado = sculptor->writePLY(arquivo);
+        else if(formato == "stl") gravado = sculptor->writeSTL(arquivo);
+        else if(formato == "sculpt") gravado = sculptor->writeSCULPT(arquivo);
+        else{
+            mensagem = formato.empty() ? "formato desconhecido para " + palavras[1] : "formato desconhecido: " + palavras[2];
+            return false;
+        }
+        if(!gravado){
+            mensagem = "nao foi possivel gravar " + arquivo;
+            return false;
+        }
+        gravados.push_back(arquivo);
+        return true;
+    }
+
+    // Primitivas: o nome, a operacao e o numero de parametros inteiros de cada uma
+    static const struct { const char *nome; Operacao::Tipo tipo; int parametros; } primitivas[] = {
+        {"putvoxel", Operacao::PutVoxel, 3}, {"cutvoxel", Operacao::CutVoxel, 3},
+        {"putbox", Operacao::PutBox, 6}, {"cutbox", Operacao::CutBox, 6},
+        {"putsphere", Operacao::PutSphere, 4}, {"cutsphere", Operacao::CutSphere, 4},
+        {"putellipsoid", Operacao::PutEllipsoid, 6}, {"cutellipsoid", Operacao::CutEllipsoid, 6}
+    };
+    for(size_t t=0; t<sizeof(primitivas)/sizeof(primitivas[0]); t++){
+        if(nome != primitivas[t].nome){
+            continue;
+        }
+        if(argumentos != primitivas[t].parametros){
+            ostringstream s;
+            s << palavras[0] << " espera " << primitivas[t].parametros << " parametros inteiros";
+            mensagem = s.str();
+            return false;
+        }
+        int p[6] = {0, 0, 0, 0, 0, 0};
+        for(int k=0; k<argumentos; k++){
+            if(!leInteiro(palavras[k+1], p[k])){
+                mensagem = "parametro invalido: " + palavras[k+1];
+                return false;
+            }
+        }
+        pendentes.push_back(Operacao::primitiva(primitivas[t].tipo, p[0], p[1], p[2], p[3], p[4], p[5]));
+        return true;
+    }
+
+    mensagem = "comando desconhecido: " + palavras[0];
+    return false;
+}
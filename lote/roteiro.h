@@ -0,0 +1,71 @@
+#ifndef ROTEIRO_H
+#define ROTEIRO_H
+
+#include <string>
+#include <vector>
+#include "sculptor.h"
+
+/**
+ * @brief A classe Roteiro
+ * executa um roteiro de comandos do escultor, lido de um arquivo texto com um comando por linha
+ * (maiusculas e minusculas sao equivalentes; o que vem depois de '#' eh comentario):
+ *
+ *     dim nx ny nz [denso|esparso] [aos|soa]   cria um novo escultor (por padrao denso e SoA)
+ *     threads n                                threads usadas pelo escultor (0 = uma por nucleo)
+ *     setColor r g b a                         cor atual, componentes entre 0 e 1
+ *     putVoxel x y z          cutVoxel x y z
+ *     putBox x0 x1 y0 y1 z0 z1                 cutBox x0 x1 y0 y1 z0 z1
+ *     putSphere xc yc zc raio                  cutSphere xc yc zc raio
+ *     putEllipsoid xc yc zc rx ry rz           cutEllipsoid xc yc zc rx ry rz
+ *     write arquivo [off|offcompacto|vect|ply|stl|sculpt]
+ *
+ * Sem o formato, o write o escolhe pela extensao do arquivo (.off, .vect, .ply, .stl ou .sculpt).
+ * Caminhos relativos sao relativos ao diretorio do roteiro. As operacoes de desenho entre dois write sao
+ * aplicadas de uma vez, com Sculptor::aplicaLote(). Um dim que nao cabe no orcamento de memoria
+ * (Sculptor::setOrcamentoMemoria) eh um erro; se apenas o denso nao cabe, o escultor eh esparso.
+ */
+class Roteiro
+{
+public:
+    /**
+     * @brief Roteiro : prepara a execucao de um roteiro
+     * @param _threads : threads de cada escultor, se o roteiro nao usar o comando threads (0 = uma por nucleo)
+     */
+    explicit Roteiro(int _threads = 0);
+    ~Roteiro();
+
+    /**
+     * @brief executa : le e executa o roteiro do arquivo caminho, parando no primeiro erro
+     * @return false se o roteiro nao pode ser lido, tem um comando invalido, falta memoria para algum comando
+     * ou algum arquivo nao pode ser gravado
+     */
+    bool executa(const std::string &caminho);
+
+    /**
+     * @brief getErro : mensagem do erro que interrompeu executa(), no formato "roteiro:linha: mensagem"
+     */
+    const std::string& getErro() const { return erro; }
+
+    /**
+     * @brief getGravados : arquivos gravados pela ultima chamada a executa()
+     */
+    const std::vector<std::string>& getGravados() const { return gravados; }
+
+private:
+    int threads;
+    Sculptor *sculptor;
+    // Operacoes de desenho ainda nao aplicadas ao escultor
+    std::vector<Operacao> pendentes;
+    std::string erro;
+    std::vector<std::string> gravados;
+
+    Roteiro(const Roteiro&) = delete;
+    Roteiro& operator=(const Roteiro&) = delete;
+
+    // Executa um comando ja separado em palavras; em caso de erro preenche mensagem e retorna false
+    bool comando(const std::vector<std::string> &palavras, const std::string &diretorio, std::string &mensagem);
+    // Aplica as operacoes pendentes ao escultor
+    void aplicaPendentes();
+};
+
+#endif // ROTEIRO_H
@@ -1,6 +1,5 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
-#include <QDebug>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -138,6 +137,47 @@ MainWindow::MainWindow(QWidget *parent) :
             ui->widget,
             SLOT(mudaR(int)));
 
+    // Habilitando Desfazer/Refazer (Ctrl+Z/Ctrl+Y) apenas quando ha o que desfazer ou refazer
+    connect(ui->widget,
+            SIGNAL(podeDesfazer(bool)),
+            ui->actionDesfazer,
+            SLOT(setEnabled(bool)));
+
+    connect(ui->widget,
+            SIGNAL(podeRefazer(bool)),
+            ui->actionRefazer,
+            SLOT(setEnabled(bool)));
+
+    // Gravacao em segundo plano: progresso e botao de cancelar na barra de status, visiveis apenas durante a gravacao
+    barraExportacao = new QProgressBar(this);
+    barraExportacao->setRange(0, 100);
+    barraExportacao->setMaximumWidth(200);
+    barraExportacao->hide();
+    botaoCancelarExportacao = new QPushButton(tr("Cancelar"), this);
+    botaoCancelarExportacao->hide();
+    ui->statusBar->addPermanentWidget(barraExportacao);
+    ui->statusBar->addPermanentWidget(botaoCancelarExportacao);
+
+    connect(ui->widget,
+            SIGNAL(exportacaoIniciada(QString)),
+            this,
+            SLOT(mostraExportacao(QString)));
+
+    connect(ui->widget,
+            SIGNAL(progressoExportacao(int)),
+            barraExportacao,
+            SLOT(setValue(int)));
+
+    connect(ui->widget,
+            SIGNAL(exportacaoTerminada(QString)),
+            this,
+            SLOT(escondeExportacao(QString)));
+
+    connect(botaoCancelarExportacao,
+            SIGNAL(clicked()),
+            ui->widget,
+            SLOT(cancelaExportacao()));
+
     ultimaAcao = "";
 
 }
@@ -176,46 +216,51 @@ void MainWindow::capturaAcao(bool checked)
 
 
     if(ui->actionPutVoxel->isChecked()){
-        qDebug() << ui->actionPutVoxel->text();
         emit nomeAcao(ui->actionPutVoxel->text());
         ultimaAcao = ui->actionPutVoxel->text();
     }
     else if (ui->actionCutVoxel->isChecked()) {
-        qDebug() << ui->actionCutVoxel->text();
         emit nomeAcao(ui->actionCutVoxel->text());
         ultimaAcao = ui->actionCutVoxel->text();
     }
     else if (ui->actionPutBox->isChecked()) {
-        qDebug() << ui->actionPutBox->text();
         emit nomeAcao(ui->actionPutBox->text());
         ultimaAcao = ui->actionPutBox->text();
     }
     else if (ui->actionCutBox->isChecked()) {
-        qDebug() << ui->actionCutBox->text();
         emit nomeAcao(ui->actionCutBox->text());
         ultimaAcao = ui->actionCutBox->text();
     }
     else if (ui->actionPutSphere->isChecked()) {
-        qDebug() << ui->actionPutSphere->text();
         emit nomeAcao(ui->actionPutSphere->text());
         ultimaAcao = ui->actionPutSphere->text();
     }
     else if (ui->actionCutSphere->isChecked()) {
-        qDebug() << ui->actionCutSphere->text();
         emit nomeAcao(ui->actionCutSphere->text());
         ultimaAcao = ui->actionCutSphere->text();
     }
     else if (ui->actionPutEllipsoid->isChecked()) {
-        qDebug() << ui->actionPutEllipsoid->text();
         emit nomeAcao(ui->actionPutEllipsoid->text());
         ultimaAcao = ui->actionPutEllipsoid->text();
     }
     else if (ui->actionCutEllipsoid->isChecked()) {
-        qDebug() << ui->actionCutEllipsoid->text();
         emit nomeAcao(ui->actionCutEllipsoid->text());
         ultimaAcao = ui->actionCutEllipsoid->text();
     }
 
 }
 
+void MainWindow::mostraExportacao(QString arquivo)
+{
+    barraExportacao->setValue(0);
+    barraExportacao->show();
+    botaoCancelarExportacao->show();
+    ui->statusBar->showMessage(tr("Gravando %1...").arg(arquivo));
+}
 
+void MainWindow::escondeExportacao(QString mensagem)
+{
+    barraExportacao->hide();
+    botaoCancelarExportacao->hide();
+    ui->statusBar->showMessage(mensagem, 5000);
+}
@@ -2,6 +2,8 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QProgressBar>
+#include <QPushButton>
 
 namespace Ui {
 class MainWindow;
@@ -29,6 +31,14 @@ public slots:
      * @brief capturaAcao: slot captura a acao que foi gatilhada na toolbar para modificar os elementos do escultor
      */
     void capturaAcao(bool);
+    /**
+     * @brief mostraExportacao : mostra na barra de status o arquivo sendo gravado, o progresso e o botao de cancelar
+     */
+    void mostraExportacao(QString arquivo);
+    /**
+     * @brief escondeExportacao : esconde o progresso da gravacao e mostra a mensagem final na barra de status
+     */
+    void escondeExportacao(QString mensagem);
 
 signals:
     /**
@@ -39,6 +49,9 @@ signals:
 private:
     Ui::MainWindow *ui;
     QString ultimaAcao;
+    // Progresso e cancelamento da gravacao em segundo plano, na barra de status
+    QProgressBar *barraExportacao;
+    QPushButton *botaoCancelarExportacao;
 };
 
 #endif // MAINWINDOW_H
@@ -1,29 +1,41 @@
 ﻿#include "plotter.h"
 #include <QPaintEvent>
+#include <QResizeEvent>
 #include <QPainter>
 #include <QBrush>
 #include <QPen>
 #include <QColor>
 #include <QMouseEvent>
+#include <QPoint>
 #include <QColorDialog>
 #include <algorithm>
-#include <QDebug>
+#include "diagnostico.h"
 #include <math.h>
 #include<QFileDialog>
 #include<QMessageBox>
+#include<QApplication>
 
 #include<stdlib.h>
 #include<iostream>
 using namespace std;
 
-
+// Memoria maxima dos passos de desfazer/refazer; os mais antigos sao descartados quando ela eh ultrapassada
+static const size_t ORCAMENTO_HISTORICO = 256*1024*1024;
+// Memoria maxima alocada na criacao de um escultor, se a variavel SCULPTOR_ORCAMENTO_MEMORIA nao definir outra;
+// acima dela o escultor eh esparso ou, se nem assim couber, nao eh criado
+static const size_t ORCAMENTO_ESCULTOR = 1024*1024*1024;
 
 Plotter::Plotter(QWidget *parent) : QWidget(parent)
 {
     // Dimensões do Escultor
     num_linhas = num_colunas = num_planos = 0;
+    // Orcamento de memoria dos escultores, verificado antes de cada alocacao
+    if (Sculptor::getOrcamentoMemoria() == 0){
+        Sculptor::setOrcamentoMemoria(ORCAMENTO_ESCULTOR);
+    }
     // Instanciando um escultor zerado
     sculptor = new Sculptor(num_linhas,num_colunas,num_planos);
+    backendEscultor = VoxelStore::Denso;
     // Indices do escultor no momento de um click
     id_plano = id_linha = id_coluna = 0;
     // Espacamentos entre as linhas do paint
@@ -38,6 +50,18 @@ Plotter::Plotter(QWidget *parent) : QWidget(parent)
     raioXEllipsoid = raioYEllipsoid = raioZEllipsoid = 0;
     // Cor do desenho
     cor = QColor(0,0,0,255);
+    // Vista 3D, criada quando for aberta pela primeira vez
+    visualizador = nullptr;
+    // Nenhuma gravacao em andamento
+    exportador = nullptr;
+    // Traco do mouse: os carimbos acumulados sao aplicados a cada quadro (~60 por segundo)
+    tracando = false;
+    temporizadorTraco.setSingleShot(true);
+    temporizadorTraco.setInterval(16);
+    connect(&temporizadorTraco,
+            SIGNAL(timeout()),
+            this,
+            SLOT(aplicaTraco()));
 
 }
 
@@ -47,8 +71,6 @@ void Plotter::paintEvent(QPaintEvent *event)
     QBrush brush;
     QPen pen;
 
-    painter.setRenderHint(QPainter::Antialiasing);
-
     // Configurando o preenchimento da area de desenho
     brush.setColor(QColor(255,255,255));
     brush.setStyle(Qt::SolidPattern);
@@ -63,289 +85,203 @@ void Plotter::paintEvent(QPaintEvent *event)
     painter.setBrush(brush);
     painter.drawRect(0,0,width(),height());
 
-    // Desenhando o gradeado para o escultor
-    if(num_linhas !=0 && num_colunas!=0 && num_planos !=0){
-         h_altura = (double)height()/num_linhas;
-         h_largura = (double)width()/num_colunas;
-
-         pen.setWidth(2);
-         painter.setPen(pen);
-
-         for (int i=1;i<=num_linhas;i++){
-            painter.drawLine(0,i*h_altura,width(),i*h_altura);
-        }
-
-         for (int i=1;i<=num_colunas;i++){
-            painter.drawLine(i*h_largura,0,i*h_largura,height());
-        }
-
-    }
-
-    // Atualizando o plano com os Voxels que foram ativados
-    brush.setColor(QColor(0,0,0));
-    painter.setBrush(brush);
-    for (int i=0;i<num_linhas;i++) {
-        for(int j=0; j<num_colunas; j++){
-            if (plano_atual[i][j].isOn == true){
-                qDebug() << "entrou";
-                int pos_linha = i*h_altura;
-                int pos_coluna = j*h_largura;
-
-                brush.setColor(QColor(211, 215, 207));
-                painter.setBrush(brush);
-                painter.drawRect(pos_coluna,pos_linha,h_largura,h_altura);
-
-                Voxel aux = plano_atual[i][j];
-                brush.setColor(QColor(aux.r,aux.g,aux.b,aux.a));
-                painter.setBrush(brush);
-                painter.drawEllipse(pos_coluna,pos_linha,h_largura,h_altura);
-            }
+    if(num_linhas !=0 && num_colunas !=0 && num_planos !=0 && h_altura > 0 && h_largura > 0){
+        // Apenas as celulas dentro das areas invalidadas sao copiadas da imagem do plano (um pixel por voxel),
+        // ampliadas em uma unica chamada por area; o gradeado ja desenhado eh copiado por cima
+        for (const QRect &area : event->region()){
+            int i0 = max(0, (int)(area.top()/h_altura) - 1);
+            int i1 = min(num_linhas-1, (int)(area.bottom()/h_altura) + 1);
+            int j0 = max(0, (int)(area.left()/h_largura) - 1);
+            int j1 = min(num_colunas-1, (int)(area.right()/h_largura) + 1);
+
+            QRectF destino(j0*h_largura, i0*h_altura, (j1-j0+1)*h_largura, (i1-i0+1)*h_altura);
+            painter.drawImage(destino, imagemPlano, QRectF(j0, i0, j1-j0+1, i1-i0+1));
+            painter.drawPixmap(area, gradeado, area);
         }
-
     }
 
+}
 
+void Plotter::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    desenhaGradeado();
 }
 
 void Plotter::mousePressEvent(QMouseEvent *event)
 {
 
-    if(num_linhas !=0 && num_colunas !=0 && num_planos !=0){
+    if(num_linhas !=0 && num_colunas !=0 && num_planos !=0 && h_altura > 0 && h_largura > 0){
         if(event->button() == Qt::LeftButton){
 
-            // Posicao do Click
-            int pos_coluna = event->x();
-            int pos_linha = event->y();
-
-            // Posição na Vector do Escultor
-            id_linha = pos_linha/h_altura;
-            id_coluna = pos_coluna/h_largura;
-
-            //QColor cor(0,0,0,255);
-
-            sculptor->setColor(cor.red()/255.0f,cor.green()/255.0f,cor.blue()/255.0f,cor.alpha()/255.0f);
-
-            if(acao.compare("PutVoxel",Qt::CaseInsensitive) == 0){
-                if (dentroDosLimites(id_linha,id_coluna,id_plano)){
-                    ativaVoxel(painter_sculptor[id_plano][id_linha][id_coluna],cor);
-                    sculptor->putVoxel(id_linha,id_coluna,id_plano);
-                }
-                //sculptor->print_sculptor();
-            }
-
-            else if (acao.compare("CutVoxel",Qt::CaseInsensitive) == 0) {
-                if (dentroDosLimites(id_linha,id_coluna,id_plano)){
-                    desativaVoxel(painter_sculptor[id_plano][id_linha][id_coluna]);
-                    sculptor->cutVoxel(id_linha,id_coluna,id_plano);
-                }
-            }
-            else if (acao.compare("PutBox",Qt::CaseInsensitive) == 0) {
-                for(int k=0; k<z_caixa;k++){
-                    for(int i=0;i<x_caixa;i++){
-                        for(int j=0; j<y_caixa;j++){
-                            if (dentroDosLimites(id_linha+i,id_coluna+j,id_plano+k)){
-                                ativaVoxel(painter_sculptor[id_plano+k][id_linha+i][id_coluna+j],cor);
-                                sculptor->putVoxel(id_linha+i,id_coluna+j,id_plano+k);
-                            }
-                        }
-                    }
-                }
-            }
-
-            else if (acao.compare("CutBox",Qt::CaseInsensitive) == 0) {
-                for(int k=0; k<z_caixa;k++){
-                    for(int i=0;i<x_caixa;i++){
-                        for(int j=0; j<y_caixa;j++){
-                            if (dentroDosLimites(id_linha+i,id_coluna+j,id_plano+k)){
-                                desativaVoxel(painter_sculptor[id_plano+k][id_linha+i][id_coluna+j]);
-                                sculptor->cutVoxel(id_linha+i,id_coluna+j,id_plano+k);
-                            }
-                        }
-                    }
-                }
-            }
-
-            else if (acao.compare("PutSphere",Qt::CaseInsensitive) == 0) {
-                double dist;
-                for(int k=id_plano - raioEsfera; k<=id_plano + raioEsfera; k++){
-                    for (int i=id_linha - raioEsfera; i<=id_linha + raioEsfera; i++) {
-                        for (int j=id_coluna - raioEsfera; j<=id_coluna + raioEsfera; j++){
-                           dist = pow(i-id_linha,2) + pow(j-id_coluna,2) + pow(k-id_plano,2);
-                           if (dist <= pow(raioEsfera,2)){
-                               if (dentroDosLimites(i,j,k)){
-                                   ativaVoxel(painter_sculptor[k][i][j],cor);
-                                   sculptor->putVoxel(i,j,k);
-                               }
-                           }
-                        }
-                    }
-                }
-            }
-
-            else if (acao.compare("CutSphere",Qt::CaseInsensitive) == 0) {
-                double dist;
-                for(int k=id_plano - raioEsfera; k<=id_plano + raioEsfera; k++){
-                    for (int i=id_linha - raioEsfera; i<=id_linha + raioEsfera; i++) {
-                        for (int j=id_coluna - raioEsfera; j<=id_coluna + raioEsfera; j++){
-                           dist = pow(i-id_linha,2) + pow(j-id_coluna,2) + pow(k-id_plano,2);
-                           if (dist <= pow(raioEsfera,2)){
-                               if (dentroDosLimites(i,j,k)){
-                                   desativaVoxel(painter_sculptor[k][i][j]);
-                                   sculptor->cutVoxel(i,j,k);
-                               }
-                           }
-                        }
-                    }
-                }
-            }
-
-            else if (acao.compare("PutEllipsoid", Qt::CaseInsensitive)==0) {
-                double dist;
-
-                if (raioXEllipsoid ==0){
-                    for (int k=id_plano - raioZEllipsoid;k<=id_plano + raioZEllipsoid;k++) {
-                        for (int j=id_coluna - raioYEllipsoid;j<=id_coluna + raioYEllipsoid;j++) {
-                            dist =  pow(j-id_coluna,2)/pow(raioYEllipsoid,2) + pow(k-id_plano,2)/pow(raioZEllipsoid,2);
-                            if(dist<=1){
-                                if (dentroDosLimites(id_linha,j,k)){
-                                    ativaVoxel(painter_sculptor[k][id_linha][j],cor);
-                                    sculptor->putVoxel(id_linha,j,k);
-                                }
-                                //t.putVoxel(id_linha,j,k);
-                          }
-                        }
-                    }
-                }
-
-                else if(raioYEllipsoid==0){
-                    for (int k=id_plano - raioZEllipsoid;k<=id_plano + raioZEllipsoid;k++) {
-                        for (int i=id_linha - raioXEllipsoid;i<=id_linha + raioXEllipsoid;i++) {
-                            dist =  pow(i-id_linha,2)/pow(raioXEllipsoid,2) + pow(k-id_plano,2)/pow(raioZEllipsoid,2);
-                            if(dist<=1){
-                                if (dentroDosLimites(i,id_coluna,k)){
-                                    ativaVoxel(painter_sculptor[k][i][id_coluna],cor);
-                                    sculptor->putVoxel(i,id_coluna,k);
-                                }
-                                //t.putVoxel(i,id_coluna,k);
-                          }
-                        }
-                    }
-                }
-                else if (raioZEllipsoid==0) {
-                    for (int i=id_linha - raioXEllipsoid;i<=id_linha + raioXEllipsoid;i++) {
-                        for (int j=id_coluna - raioYEllipsoid;j<=id_coluna + raioYEllipsoid;j++) {
-                            dist =  pow(i-id_linha,2)/pow(raioXEllipsoid,2) + pow(j-id_coluna,2)/pow(raioYEllipsoid,2);
-                            if(dist<=1){
-                                if (dentroDosLimites(i,j,id_plano)){
-                                    ativaVoxel(painter_sculptor[id_plano][i][j],cor);
-                                    sculptor->putVoxel(i,j,id_plano);
-                                }
-                                //t.putVoxel(i,j,id_plano);
-                          }
-                        }
-                    }
-                }
-                else{
-                for (int k=id_plano - raioZEllipsoid;k<=id_plano + raioZEllipsoid;k++) {
-                    for (int i=id_linha - raioXEllipsoid;i<=id_linha + raioXEllipsoid;i++) {
-                        for (int j=id_coluna - raioYEllipsoid;j<=id_coluna + raioYEllipsoid;j++) {
-                              dist = pow(i-id_linha,2)/pow(raioXEllipsoid,2) + pow(j-id_coluna,2)/pow(raioYEllipsoid,2) + pow(k-id_plano,2)/pow(raioZEllipsoid,2);
-                            if(dist<=1){
-                                if (dentroDosLimites(i,j,k)){
-                                    ativaVoxel(painter_sculptor[k][i][j],cor);
-                                    sculptor->putVoxel(i,j,k);
-                                }
-                                //t.putVoxel(i,j,k);
-                            }
-
-                        }
-
-                    }
-                 }
-              }
+            // Posicao do Click no escultor
+            celulaDoPonto(event->pos(),id_linha,id_coluna);
+
+            DIAGNOSTICO(Diagnostico::Depuracao, "Click no plano " << id_plano << ", linha " << id_linha << ", coluna " << id_coluna);
+
+            // Todas as alteracoes de um traco (do click ate soltar o botao) formam um unico passo do historico
+            sculptor->iniciaPasso();
+            tracando = true;
+            // Desfazer no meio do traco fecharia o passo aberto; as acoes voltam ao soltar o botao
+            emit podeDesfazer(false);
+            emit podeRefazer(false);
+            centrosTraco.clear();
+            ultimoCentro[0] = id_linha;
+            ultimoCentro[1] = id_coluna;
+            ultimoCentro[2] = id_plano;
+            adicionaCentro(id_linha,id_coluna,id_plano);
+            // O primeiro carimbo eh aplicado imediatamente
+            aplicaTraco();
 
+        }
+    }
 
-            }
-
-            else if (acao.compare("CutEllipsoid", Qt::CaseInsensitive)==0) {
-                double dist;
-
-                if (raioXEllipsoid ==0){
-                    for (int k=id_plano - raioZEllipsoid;k<=id_plano + raioZEllipsoid;k++) {
-                        for (int j=id_coluna - raioYEllipsoid;j<=id_coluna + raioYEllipsoid;j++) {
-                            dist =  pow(j-id_coluna,2)/pow(raioYEllipsoid,2) + pow(k-id_plano,2)/pow(raioZEllipsoid,2);
-                            if(dist<=1){
-                                if (dentroDosLimites(id_linha,j,k)){
-                                    desativaVoxel(painter_sculptor[k][id_linha][j]);
-                                    sculptor->cutVoxel(id_linha,j,k);
-                                }
-                                //t.putVoxel(id_linha,j,k);
-                          }
-                        }
-                    }
-                }
+}
 
-                else if(raioYEllipsoid==0){
-                    for (int k=id_plano - raioZEllipsoid;k<=id_plano + raioZEllipsoid;k++) {
-                        for (int i=id_linha - raioXEllipsoid;i<=id_linha + raioXEllipsoid;i++) {
-                            dist =  pow(i-id_linha,2)/pow(raioXEllipsoid,2) + pow(k-id_plano,2)/pow(raioZEllipsoid,2);
-                            if(dist<=1){
-                                if (dentroDosLimites(i,id_coluna,k)){
-                                    desativaVoxel(painter_sculptor[k][i][id_coluna]);
-                                    sculptor->cutVoxel(i,id_coluna,k);
-                                }
-                                //t.putVoxel(i,id_coluna,k);
-                          }
-                        }
-                    }
-                }
-                else if (raioZEllipsoid==0) {
-                    for (int i=id_linha - raioXEllipsoid;i<=id_linha + raioXEllipsoid;i++) {
-                        for (int j=id_coluna - raioYEllipsoid;j<=id_coluna + raioYEllipsoid;j++) {
-                            dist =  pow(i-id_linha,2)/pow(raioXEllipsoid,2) + pow(j-id_coluna,2)/pow(raioYEllipsoid,2);
-                            if(dist<=1){
-                                if (dentroDosLimites(i,j,id_plano)){
-                                    desativaVoxel(painter_sculptor[id_plano][i][j]);
-                                    sculptor->cutVoxel(i,j,id_plano);
-                                }
-                                //t.putVoxel(i,j,id_plano);
-                          }
-                        }
-                    }
-                }
-                else{
-                for (int k=id_plano - raioZEllipsoid;k<=id_plano + raioZEllipsoid;k++) {
-                    for (int i=id_linha - raioXEllipsoid;i<=id_linha + raioXEllipsoid;i++) {
-                        for (int j=id_coluna - raioYEllipsoid;j<=id_coluna + raioYEllipsoid;j++) {
-                              dist = pow(i-id_linha,2)/pow(raioXEllipsoid,2) + pow(j-id_coluna,2)/pow(raioYEllipsoid,2) + pow(k-id_plano,2)/pow(raioZEllipsoid,2);
-                            if(dist<=1){
-                                if (dentroDosLimites(i,j,k)){
-                                    desativaVoxel(painter_sculptor[k][i][j]);
-                                    sculptor->cutVoxel(i,j,k);
-                                }
-                                //t.putVoxel(i,j,k);
-                            }
-
-                        }
-
-                    }
-                 }
-              }
+void Plotter::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!tracando || !(event->buttons() & Qt::LeftButton)){
+        return;
+    }
+    int linha, coluna;
+    celulaDoPonto(event->pos(),linha,coluna);
+    if (linha == ultimoCentro[0] && coluna == ultimoCentro[1] && id_plano == ultimoCentro[2]){
+        return;
+    }
+    // Liga a amostra anterior a atual, para que movimentos rapidos nao deixem buracos no traco
+    percorreSegmento(ultimoCentro[0],ultimoCentro[1],ultimoCentro[2],linha,coluna,id_plano);
+    ultimoCentro[0] = linha;
+    ultimoCentro[1] = coluna;
+    ultimoCentro[2] = id_plano;
+    id_linha = linha;
+    id_coluna = coluna;
+
+    // Os carimbos acumulados sao aplicados no maximo uma vez por quadro
+    if (!temporizadorTraco.isActive()){
+        temporizadorTraco.start();
+    }
+}
 
-            }
+void Plotter::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!tracando || event->button() != Qt::LeftButton){
+        return;
+    }
+    temporizadorTraco.stop();
+    aplicaTraco();
+    tracando = false;
+    centrosTraco.clear();
+    sculptor->concluiPasso();
+    atualizaHistorico();
+}
 
+void Plotter::celulaDoPonto(const QPoint &ponto, int &linha, int &coluna)
+{
+    // Pontos fora do widget (durante um traco) sao levados para a borda
+    linha = min(max((int)floor(ponto.y()/h_altura),0),num_linhas-1);
+    coluna = min(max((int)floor(ponto.x()/h_largura),0),num_colunas-1);
+}
 
+void Plotter::percorreSegmento(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+    // Bresenham 3D: o eixo de maior variacao avanca uma celula por passo e os outros dois acumulam o erro
+    int dx = abs(x1-x0), dy = abs(y1-y0), dz = abs(z1-z0);
+    int sx = x1 > x0 ? 1 : -1, sy = y1 > y0 ? 1 : -1, sz = z1 > z0 ? 1 : -1;
+    int passos = max(dx,max(dy,dz));
+    int ex = 2*dx - passos, ey = 2*dy - passos, ez = 2*dz - passos;
+    int x = x0, y = y0, z = z0;
+    // O centro inicial ja foi adicionado pela amostra anterior
+    for (int p=0;p<passos;p++){
+        if (ex >= 0 && dx != passos){ x += sx; ex -= 2*passos; }
+        if (ey >= 0 && dy != passos){ y += sy; ey -= 2*passos; }
+        if (ez >= 0 && dz != passos){ z += sz; ez -= 2*passos; }
+        ex += 2*dx; ey += 2*dy; ez += 2*dz;
+        if (dx == passos){ x += sx; }
+        if (dy == passos){ y += sy; }
+        if (dz == passos){ z += sz; }
+        adicionaCentro(x,y,z);
+    }
+}
 
-            qDebug() << "Pos Plano: " << id_plano;
-            qDebug() << "Pos Linha: " << id_linha;
-            qDebug() << "Pos Coluna: " << id_coluna;
+void Plotter::adicionaCentro(int linha, int coluna, int plano)
+{
+    // Cada centro eh carimbado uma unica vez por traco, mesmo que o mouse passe por ele varias vezes
+    long long chave = ((long long)plano*num_linhas + linha)*num_colunas + coluna;
+    if (centrosTraco.insert(chave).second){
+        centrosPendentes.push_back(linha);
+        centrosPendentes.push_back(coluna);
+        centrosPendentes.push_back(plano);
+    }
+}
 
-            plano_atual = painter_sculptor[id_plano];
-            repaint();
+bool Plotter::operacaoPincel(int linha, int coluna, int plano, Operacao &op)
+{
+    if (acao.compare("PutVoxel",Qt::CaseInsensitive) == 0){
+        op = Operacao::primitiva(Operacao::PutVoxel,linha,coluna,plano);
+    }
+    else if (acao.compare("CutVoxel",Qt::CaseInsensitive) == 0){
+        op = Operacao::primitiva(Operacao::CutVoxel,linha,coluna,plano);
+    }
+    else if (acao.compare("PutBox",Qt::CaseInsensitive) == 0){
+        op = Operacao::primitiva(Operacao::PutBox,linha,linha+x_caixa-1,coluna,coluna+y_caixa-1,plano,plano+z_caixa-1);
+    }
+    else if (acao.compare("CutBox",Qt::CaseInsensitive) == 0){
+        op = Operacao::primitiva(Operacao::CutBox,linha,linha+x_caixa-1,coluna,coluna+y_caixa-1,plano,plano+z_caixa-1);
+    }
+    else if (acao.compare("PutSphere",Qt::CaseInsensitive) == 0){
+        op = Operacao::primitiva(Operacao::PutSphere,linha,coluna,plano,raioEsfera);
+    }
+    else if (acao.compare("CutSphere",Qt::CaseInsensitive) == 0){
+        op = Operacao::primitiva(Operacao::CutSphere,linha,coluna,plano,raioEsfera);
+    }
+    else if (acao.compare("PutEllipsoid",Qt::CaseInsensitive) == 0){
+        op = Operacao::primitiva(Operacao::PutEllipsoid,linha,coluna,plano,raioXEllipsoid,raioYEllipsoid,raioZEllipsoid);
+    }
+    else if (acao.compare("CutEllipsoid",Qt::CaseInsensitive) == 0){
+        op = Operacao::primitiva(Operacao::CutEllipsoid,linha,coluna,plano,raioXEllipsoid,raioYEllipsoid,raioZEllipsoid);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
 
+void Plotter::aplicaTraco()
+{
+    if (centrosPendentes.empty()){
+        return;
+    }
+    // Os carimbos pendentes formam um unico lote: cada voxel coberto por varios deles eh gravado uma so vez
+    vector<Operacao> lote;
+    lote.push_back(Operacao::setColor(cor.redF(),cor.greenF(),cor.blueF(),cor.alphaF()));
+    Operacao op;
+    for (size_t c=0;c<centrosPendentes.size();c+=3){
+        if (operacaoPincel(centrosPendentes[c],centrosPendentes[c+1],centrosPendentes[c+2],op)){
+            lote.push_back(op);
         }
     }
+    if (lote.size() > 1){
+        sculptor->aplicaLote(lote);
+        notificaVisualizador();
+    }
 
+    // Invalidando apenas as celulas do plano atual que cada carimbo pode ter alterado
+    for (size_t c=0;c<centrosPendentes.size();c+=3){
+        int linha = centrosPendentes[c], coluna = centrosPendentes[c+1];
+        if (acao.contains("Box",Qt::CaseInsensitive)){
+            invalidaCelulas(linha,linha+x_caixa-1,coluna,coluna+y_caixa-1);
+        }
+        else if (acao.contains("Sphere",Qt::CaseInsensitive)){
+            invalidaCelulas(linha-raioEsfera,linha+raioEsfera,coluna-raioEsfera,coluna+raioEsfera);
+        }
+        else if (acao.contains("Ellipsoid",Qt::CaseInsensitive)){
+            invalidaCelulas(linha-raioXEllipsoid,linha+raioXEllipsoid,coluna-raioYEllipsoid,coluna+raioYEllipsoid);
+        }
+        else {
+            invalidaCelulas(linha,linha,coluna,coluna);
+        }
+    }
+    centrosPendentes.clear();
 }
 
 void Plotter::abreDialogEscultor()
@@ -353,52 +289,28 @@ void Plotter::abreDialogEscultor()
     DialogEscultor e;
     if(e.exec() == QDialog::Accepted){
         // Pegando as dimensões do escultor
-        num_linhas = e.getNumLinhas();
-        num_colunas = e.getNumColunas();
-        num_planos = e.getNumPlanos();
-        if(num_linhas !=0 && num_colunas !=0 && num_planos !=0){
-            // Voxel com todas as proprieades iguais a zero
-            Voxel voxel_zero;
-            voxel_zero.r = voxel_zero.b = voxel_zero.g = 0;
-            voxel_zero.a = 0.0f;
-            voxel_zero.isOn = false;
-
-            painter_sculptor.clear();
-            // Craindo o escultor 3D com Voxels zerados
-            for (int k=0;k<num_planos;k++) {
-                vector<vector<Voxel>> aux1;
-                for(int i=0;i<num_linhas; i++){
-                    vector<Voxel> aux2;
-                    for(int j=0;j<num_colunas; j++){
-                        aux2.push_back(voxel_zero);
-                    }
-                    aux1.push_back(aux2);
-                }
-                painter_sculptor.push_back(aux1);
+        int linhas = e.getNumLinhas();
+        int colunas = e.getNumColunas();
+        int planos = e.getNumPlanos();
+        if(linhas !=0 && colunas !=0 && planos !=0){
+            // A memoria eh verificada antes de alocar: o escultor anterior so eh removido se o novo couber no orcamento
+            VoxelStore::Backend backend = VoxelStore::Denso;
+            string erro;
+            if (!Sculptor::cabeNoOrcamento(linhas,colunas,planos,VoxelStore::SoA,backend,&erro)){
+                QMessageBox::warning(this, tr("Novo Escultor"), QString::fromStdString(erro));
+                return;
             }
-
-            // Definido como a primeira tela de desenho o plano zero(XY)
-            plano_atual = painter_sculptor[0];
-
+            num_linhas = linhas;
+            num_colunas = colunas;
+            num_planos = planos;
             // Removendo o escultor anterior anterior
             delete sculptor;
             // Instanciando o escultor atual
-            sculptor = new Sculptor(num_linhas,num_colunas,num_planos);
-            sculptor->print_sculptor();
-
-            // Redefinindo as propriedades dos sliders (emitindo sinais para mainwindow)
-            emit alteraSlidersX(0,num_linhas-1);
-            emit alteraSlidersY(0,num_colunas-1);
-            emit alteraSlidersZ(0,num_planos-1);
-
-            int re[] = {num_linhas-1,num_planos-1,num_colunas-1};
-            emit alteraSliderRaioEsfera(0,*min_element(re,re+3));
+            sculptor = new Sculptor(num_linhas,num_colunas,num_planos,VoxelStore::SoA,backend);
+            backendEscultor = backend;
+            sculptor->setOrcamentoHistorico(ORCAMENTO_HISTORICO);
 
-            qDebug() << "Num Linhas: " << num_linhas;
-            qDebug() << "Num Colunas: " << num_colunas;
-            qDebug() << "Num Planos: " << num_planos;
-
-            repaint();
+            preparaEscultor();
             }
         else {
             num_linhas = num_planos = num_colunas = 0;
@@ -409,6 +321,178 @@ void Plotter::abreDialogEscultor()
     }
 }
 
+void Plotter::abreEscultor()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Abra um Escultor"),"",tr("Projeto do Escultor (*.sculpt);;All Files (*)"));
+    if (!fileName.compare("")){
+        return;
+    }
+    // Se o arquivo nao pode ser aberto o escultor atual eh mantido
+    string erro;
+    Sculptor *aberto = Sculptor::readSCULPT(fileName.toStdString(), VoxelStore::SoA, VoxelStore::Esparso, &erro);
+    if (aberto == nullptr){
+        QMessageBox::warning(this, tr("Abra um Escultor"), QString::fromStdString("Nao foi possivel abrir o arquivo: " + erro));
+        return;
+    }
+    // Removendo o escultor anterior
+    delete sculptor;
+    sculptor = aberto;
+    backendEscultor = VoxelStore::Esparso;
+    sculptor->setOrcamentoHistorico(ORCAMENTO_HISTORICO);
+    num_linhas = sculptor->getNx();
+    num_colunas = sculptor->getNy();
+    num_planos = sculptor->getNz();
+    preparaEscultor();
+}
+
+void Plotter::preparaEscultor()
+{
+    // Definido como a primeira tela de desenho o plano zero(XY)
+    id_plano = 0;
+    imagemPlano = QImage(num_colunas,num_linhas,QImage::Format_ARGB32);
+    atualizaImagem(0,num_linhas-1,0,num_colunas-1);
+    desenhaGradeado();
+    notificaVisualizador();
+
+    // Redefinindo as propriedades dos sliders (emitindo sinais para mainwindow)
+    emit alteraSlidersX(0,num_linhas-1);
+    emit alteraSlidersY(0,num_colunas-1);
+    emit alteraSlidersZ(0,num_planos-1);
+
+    int re[] = {num_linhas-1,num_planos-1,num_colunas-1};
+    emit alteraSliderRaioEsfera(0,*min_element(re,re+3));
+    atualizaHistorico();
+
+    DIAGNOSTICO(Diagnostico::Info, "Escultor com " << num_linhas << " linhas, " << num_colunas << " colunas e " << num_planos << " planos");
+    DIAGNOSTICO(Diagnostico::Info, "Memoria: " << getMemoria().escultor.total() << " bytes do escultor, "
+                << getMemoria().plano << " bytes do plano desenhado");
+
+    update();
+}
+
+MemoriaPlotter Plotter::getMemoria() const
+{
+    MemoriaPlotter m;
+    m.escultor = sculptor->getMemoria();
+    m.plano = (size_t)imagemPlano.bytesPerLine()*imagemPlano.height()
+              + (size_t)gradeado.width()*gradeado.height()*gradeado.depth()/8;
+    Memoria nenhuma = {0, 0, 0, 0};
+    m.exportacao = (exportador != nullptr) ? exportador->getMemoria() : nenhuma;
+    return m;
+}
+
+void Plotter::atualizaImagem(int i0, int i1, int j0, int j1)
+{
+    // Os voxels sao lidos trecho a trecho de cada linha; trechos sem voxels alocados ficam transparentes de uma vez
+    PlanoVoxels plano = sculptor->plano(id_plano);
+    Trecho t;
+    for (int i=i0;i<=i1;i++) {
+        QRgb *pixels = reinterpret_cast<QRgb*>(imagemPlano.scanLine(i));
+        int j = j0;
+        while (j <= j1){
+            plano.trecho(i,j,t);
+            int fim = min(j1, t.y0 + t.n - 1);
+            if (t.bits == nullptr){
+                fill(pixels + j, pixels + fim + 1, qRgba(0,0,0,0));
+                j = fim + 1;
+                continue;
+            }
+            for(; j<=fim; j++){
+                int y = j - t.y0;
+                if ((t.bits[y >> 6] >> (y & 63)) & 1){
+                    int s = y*t.passo;
+                    pixels[j] = qRgba((int)(t.r[s]*255 + 0.5f),(int)(t.g[s]*255 + 0.5f),(int)(t.b[s]*255 + 0.5f),(int)(t.a[s]*255 + 0.5f));
+                }
+                else {
+                    pixels[j] = qRgba(0,0,0,0);
+                }
+            }
+        }
+    }
+}
+
+void Plotter::desenhaGradeado()
+{
+    if (num_linhas == 0 || num_colunas == 0 || num_planos == 0 || width() <= 0 || height() <= 0){
+        return;
+    }
+    h_altura = (double)height()/num_linhas;
+    h_largura = (double)width()/num_colunas;
+
+    gradeado = QPixmap(size());
+    gradeado.fill(Qt::transparent);
+    QPainter painter(&gradeado);
+    QPen pen;
+    pen.setColor(QColor(0,0,0));
+    pen.setStyle(Qt::SolidLine);
+    pen.setWidth(2);
+    painter.setPen(pen);
+
+    for (int i=1;i<=num_linhas;i++){
+        painter.drawLine(0,i*h_altura,width(),i*h_altura);
+    }
+
+    for (int i=1;i<=num_colunas;i++){
+        painter.drawLine(i*h_largura,0,i*h_largura,height());
+    }
+}
+
+void Plotter::invalidaCelulas(int i0, int i1, int j0, int j1)
+{
+    i0 = max(i0,0); i1 = min(i1,num_linhas-1);
+    j0 = max(j0,0); j1 = min(j1,num_colunas-1);
+    if (i0 > i1 || j0 > j1){
+        return;
+    }
+    atualizaImagem(i0,i1,j0,j1);
+    if (h_altura <= 0 || h_largura <= 0){
+        return;
+    }
+    // A area cobre as celulas e as linhas do gradeado em volta delas (caneta de ate 3 pixels)
+    int esquerda = (int)floor(j0*h_largura) - 2, topo = (int)floor(i0*h_altura) - 2;
+    int direita = (int)ceil((j1+1)*h_largura) + 2, base = (int)ceil((i1+1)*h_altura) + 2;
+    // update() apenas agenda o desenho: as areas invalidadas ate o proximo quadro sao unidas em um unico paintEvent
+    update(QRect(esquerda, topo, direita - esquerda + 1, base - topo + 1));
+}
+
+void Plotter::atualizaHistorico()
+{
+    emit podeDesfazer(sculptor->podeDesfazer());
+    emit podeRefazer(sculptor->podeRefazer());
+}
+
+void Plotter::desfaz()
+{
+    // Durante um traco o passo ainda esta aberto e o traco deve ser desfeito inteiro, depois de concluido
+    if (tracando){
+        return;
+    }
+    int x0, x1, z0, z1;
+    // Apenas os blocos alterados pelo passo sao restaurados e apenas as suas linhas no plano atual sao redesenhadas
+    if(sculptor->desfaz(x0,x1,z0,z1)){
+        if (id_plano >= z0 && id_plano <= z1){
+            invalidaCelulas(x0,x1,0,num_colunas-1);
+        }
+        notificaVisualizador();
+    }
+    atualizaHistorico();
+}
+
+void Plotter::refaz()
+{
+    if (tracando){
+        return;
+    }
+    int x0, x1, z0, z1;
+    if(sculptor->refaz(x0,x1,z0,z1)){
+        if (id_plano >= z0 && id_plano <= z1){
+            invalidaCelulas(x0,x1,0,num_colunas-1);
+        }
+        notificaVisualizador();
+    }
+    atualizaHistorico();
+}
+
 void Plotter::alteraCor()
 {
     QColor c;
@@ -434,61 +518,161 @@ void Plotter::alteraCor()
 
 void Plotter::salvaEscultor()
 {
+  if (exportador != nullptr){
+      QMessageBox::information(this, tr("Salvar"), tr("Aguarde o fim da gravacao de %1 ou cancele-a.").arg(exportador->getArquivo()));
+      return;
+  }
   if (num_linhas != 0 && num_colunas !=0 && num_planos !=0){
-   QString fileName = QFileDialog::getSaveFileName(this, tr("Salve o Escultor em formato .off"),"",tr("(*.off);;All Files (*)"));
+   QString filtroOFF = tr("(*.off)");
+   QString filtroCompacto = tr("OFF compacto (*.off)");
+   QString filtroPLY = tr("PLY binario (*.ply)");
+   QString filtroSTL = tr("STL binario (*.stl)");
+   QString filtroSCULPT = tr("Projeto do Escultor (*.sculpt)");
+   QString filtro;
+   QString fileName = QFileDialog::getSaveFileName(this, tr("Salve o Escultor"),"",
+                                                   filtroOFF + ";;" + filtroCompacto + ";;" + filtroPLY + ";;" + filtroSTL
+                                                   + ";;" + filtroSCULPT + ";;" + tr("All Files (*)"), &filtro);
    if (fileName.compare("")){
-    sculptor->writeOFF(fileName.toStdString());
+    // Sem um filtro de formato, o formato eh escolhido pela extensao do arquivo
+    if (filtro != filtroCompacto && filtro != filtroPLY && filtro != filtroSTL && filtro != filtroSCULPT){
+        if (fileName.endsWith(".ply", Qt::CaseInsensitive)){
+            filtro = filtroPLY;
+        }
+        else if (fileName.endsWith(".stl", Qt::CaseInsensitive)){
+            filtro = filtroSTL;
+        }
+        else if (fileName.endsWith(".sculpt", Qt::CaseInsensitive)){
+            filtro = filtroSCULPT;
+        }
+    }
+    Exportador::Formato formato;
+    if (filtro == filtroPLY){
+        formato = Exportador::PLY;
+    }
+    else if (filtro == filtroSTL){
+        formato = Exportador::STL;
+    }
+    else if (filtro == filtroSCULPT){
+        formato = Exportador::SCULPT;
+    }
+    else {
+        // O OFF compacto une as faces expostas em retangulos; o padrao mantem um cubo por voxel
+        formato = (filtro == filtroCompacto) ? Exportador::OFFCompacto : Exportador::OFF;
+    }
+    // A copia eh feita aqui, na thread da janela, para que a gravacao veja o escultor exatamente como ele estava
+    string erro;
+    Sculptor *copia = sculptor->copia(&erro);
+    if (copia == nullptr){
+        // Sem memoria para a copia o proprio escultor eh gravado, com a janela parada ate o fim da gravacao
+        QMessageBox::warning(this, tr("Salvar"), QString::fromStdString(erro)
+                             + tr(".\nO arquivo sera gravado sem copia e a janela ficara bloqueada durante a gravacao."));
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        bool gravado = Exportador::grava(sculptor, fileName.toStdString(), formato);
+        QApplication::restoreOverrideCursor();
+        if (gravado){
+            emit exportacaoTerminada(tr("Arquivo %1 gravado").arg(fileName));
+        }
+        else {
+            QString mensagem = tr("Nao foi possivel gravar o arquivo %1").arg(fileName);
+            emit exportacaoTerminada(mensagem);
+            QMessageBox::warning(this, tr("Salvar"), mensagem);
+        }
+        return;
+    }
+    exportador = new Exportador(copia, fileName, formato, this);
+    connect(exportador,
+            SIGNAL(progresso(int)),
+            this,
+            SIGNAL(progressoExportacao(int)));
+    connect(exportador,
+            SIGNAL(concluido(QString)),
+            this,
+            SLOT(exportacaoConcluida(QString)));
+    connect(exportador,
+            SIGNAL(cancelado(QString)),
+            this,
+            SLOT(exportacaoCancelada(QString)));
+    connect(exportador,
+            SIGNAL(falhou(QString)),
+            this,
+            SLOT(exportacaoFalhou(QString)));
+    emit exportacaoIniciada(fileName);
+    exportador->start(QThread::LowPriority);
    }
   }
   else {
       QMessageBox box;
-      box.setText("O Escultor está vazio, não é possível salvar o arquivo .off");
+      box.setText("O Escultor está vazio, não é possível salvar o arquivo");
       box.exec();
   }
 
 }
 
-void Plotter::executaGeomview()
+void Plotter::cancelaExportacao()
 {
-    if(num_linhas !=0 && num_colunas !=0 && num_planos !=0){
-        std::string fileName = "/tmp/sculptortmp.off";
-        sculptor->writeOFF(fileName);
-        std::string comando = "geomview "+ fileName;
-        std::system(comando.c_str());
-
+    if (exportador != nullptr){
+        exportador->cancela();
     }
+}
 
+void Plotter::exportacaoConcluida(QString arquivo)
+{
+    // O destrutor do exportador espera a thread, que ja esta terminando
+    exportador->deleteLater();
+    exportador = nullptr;
+    emit exportacaoTerminada(tr("Arquivo %1 gravado").arg(arquivo));
 }
 
-void Plotter::limpaEscultor()
+void Plotter::exportacaoCancelada(QString arquivo)
+{
+    exportador->deleteLater();
+    exportador = nullptr;
+    emit exportacaoTerminada(tr("Gravacao de %1 cancelada").arg(arquivo));
+}
+
+void Plotter::exportacaoFalhou(QString mensagem)
+{
+    exportador->deleteLater();
+    exportador = nullptr;
+    emit exportacaoTerminada(mensagem);
+    QMessageBox::warning(this, tr("Salvar"), mensagem);
+}
+
+void Plotter::abreVisualizador()
 {
     if(num_linhas !=0 && num_colunas !=0 && num_planos !=0){
-        // Voxel com todas as proprieades iguais a zero
-        Voxel voxel_zero;
-        voxel_zero.r = voxel_zero.b = voxel_zero.g = 0;
-        voxel_zero.a = 0.0f;
-        voxel_zero.isOn = false;
-
-        painter_sculptor.clear();
-        // Craindo o escultor 3D com Voxels zerados
-        for (int k=0;k<num_planos;k++) {
-            vector<vector<Voxel>> aux1;
-            for(int i=0;i<num_linhas; i++){
-                vector<Voxel> aux2;
-                for(int j=0;j<num_colunas; j++){
-                    aux2.push_back(voxel_zero);
-                }
-                aux1.push_back(aux2);
-            }
-            painter_sculptor.push_back(aux1);
+        // A vista 3D eh desenhada diretamente dos voxels, sem gravar arquivos nem chamar programas externos
+        if (visualizador == nullptr){
+            visualizador = new Visualizador(this);
         }
+        visualizador->setEscultor(sculptor);
+        visualizador->show();
+        visualizador->raise();
+        visualizador->activateWindow();
+    }
+
+}
+
+void Plotter::notificaVisualizador()
+{
+    // O visualizador so redesenha quando esta visivel
+    if (visualizador != nullptr){
+        visualizador->setEscultor(sculptor);
+    }
+}
 
-        plano_atual = painter_sculptor[id_plano];
+void Plotter::limpaEscultor()
+{
+    if(num_linhas !=0 && num_colunas !=0 && num_planos !=0){
          // Removendo o escultor anterior anterior
         delete sculptor;
         // Instanciando o escultor atual
-        sculptor = new Sculptor(num_linhas,num_colunas,num_planos);
-        repaint();
+        sculptor = new Sculptor(num_linhas,num_colunas,num_planos,VoxelStore::SoA,backendEscultor);
+        sculptor->setOrcamentoHistorico(ORCAMENTO_HISTORICO);
+        imagemPlano.fill(qRgba(0,0,0,0));
+        notificaVisualizador();
+        atualizaHistorico();
+        update();
 
     }
     else {
@@ -501,14 +685,16 @@ void Plotter::limpaEscultor()
 void Plotter::mudaPlanoZ(int planoZ)
 {
     id_plano = planoZ;
-    plano_atual = painter_sculptor[id_plano];
-    repaint();
+    if(num_linhas !=0 && num_colunas !=0 && num_planos !=0){
+        atualizaImagem(0,num_linhas-1,0,num_colunas-1);
+    }
+    update();
 }
 
 void Plotter::acaoSelecionada(QString _acao)
 {
     acao = _acao;
-    qDebug() << "Acao Selecionada " << acao;
+    DIAGNOSTICO(Diagnostico::Depuracao, "Acao selecionada " << acao.toStdString());
 }
 
 void Plotter::mudaXCaixa(int _x)
@@ -561,20 +747,6 @@ void Plotter::mudaG(int _g)
     cor.setGreen(_g);
 }
 
-void Plotter::ativaVoxel(Voxel &v, QColor cor)
-{
-    v.isOn = true;
-    v.r = cor.red();
-    v.g = cor.green();
-    v.b = cor.blue();
-    v.a = cor.alpha();
-}
-
-void Plotter::desativaVoxel(Voxel &v)
-{
-    v.isOn = false;
-}
-
 bool Plotter::dentroDosLimites(int linha, int coluna, int plano)
 {
     if ((plano < num_planos && plano >= 0) && (linha < num_linhas && linha >= 0) && (coluna < num_colunas && coluna >=0)){
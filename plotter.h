@@ -2,14 +2,34 @@
 #define PLOTTER_H
 
 #include <QWidget>
+#include <QImage>
+#include <QPixmap>
+#include <QTimer>
+#include <unordered_set>
 #include <vector>
 #include <QColor>
 #include <QString>
 #include "dialogescultor.h"
+#include "exportador.h"
 #include "sculptor.h"
+#include "visualizador.h"
 
 using namespace std;
 
+/**
+ * @brief The MemoriaPlotter struct: bytes alocados pelo Plotter em cada estrutura, consultados com Plotter::getMemoria()
+ * @param escultor : escultor sendo editado (veja Memoria)
+ * @param plano : copia do plano atual usada para desenhar (imagem com um pixel por voxel) e o gradeado
+ * @param exportacao : copia do escultor sendo gravada em segundo plano e os buffers da gravacao (zeros sem gravacao)
+ */
+struct MemoriaPlotter{
+    Memoria escultor;
+    size_t plano;
+    Memoria exportacao;
+
+    size_t total() const { return escultor.total() + plano + exportacao.total(); }
+};
+
 /**
  * @brief The Plotter class
  * representa a area em que o escultor 3D sera desenhado;
@@ -23,12 +43,10 @@ class Plotter : public QWidget
 private:
     // Dimensões do escultor
     int num_linhas, num_colunas, num_planos;
-    // Vector 3D que armazena todo o escultor
-    vector<vector<vector<Voxel>>> painter_sculptor;
-    // Plano atual do escultor que eh mostrado na tela
-    vector<vector<Voxel>> plano_atual;
-    // Ponteiro para o escultor
+    // Ponteiro para o escultor (o plano mostrado na tela eh lido diretamente dele)
     Sculptor* sculptor;
+    // Armazenamento do escultor atual, mantido ao limpa-lo (o esparso quando o denso nao cabe no orcamento de memoria)
+    VoxelStore::Backend backendEscultor;
     // Indices do escultor no momento de um click
     int id_plano, id_linha, id_coluna;
     // Espacamentos entre as linhas do paint
@@ -46,12 +64,50 @@ private:
     // Cor do desenho
     QColor cor;
 
-    // Ativa um Voxel
-    void ativaVoxel(Voxel &v, QColor cor);
-    // Desativa um Voxel
-    void desativaVoxel(Voxel &v);
+    // Plano atual com um pixel por voxel (voxels desativados sao transparentes), ampliado no paintEvent
+    QImage imagemPlano;
+    // Linhas do gradeado no tamanho do widget, redesenhadas apenas quando o widget ou o escultor mudam de tamanho
+    QPixmap gradeado;
+
+    // Indica se ha um traco em andamento (botao esquerdo pressionado)
+    bool tracando;
+    // Ultimo centro (linha, coluna, plano) adicionado ao traco
+    int ultimoCentro[3];
+    // Centros ja carimbados no traco atual, indexados por (plano*num_linhas + linha)*num_colunas + coluna
+    unordered_set<long long> centrosTraco;
+    // Centros (linha, coluna, plano) ainda nao aplicados ao escultor, em sequencia
+    vector<int> centrosPendentes;
+    // Agenda a aplicacao dos centros pendentes para o proximo quadro
+    QTimer temporizadorTraco;
+
+    // Janela com a vista 3D do escultor (nullptr ate ser aberta)
+    Visualizador *visualizador;
+
+    // Gravacao em andamento em segundo plano (nullptr se nenhuma)
+    Exportador *exportador;
+
     // Verifica se o Voxel estao dentro dos limites
     bool dentroDosLimites(int linha, int coluna, int plano);
+    // Celula (linha, coluna) do plano atual sob o ponto, limitada as bordas do escultor
+    void celulaDoPonto(const QPoint &ponto, int &linha, int &coluna);
+    // Adiciona ao traco as celulas do segmento 3D entre duas amostras do mouse (sem a inicial)
+    void percorreSegmento(int x0, int y0, int z0, int x1, int y1, int z1);
+    // Adiciona um centro aos pendentes, se ele ainda nao foi carimbado no traco
+    void adicionaCentro(int linha, int coluna, int plano);
+    // Operacao do pincel (acao selecionada) centrada na celula; false se nenhuma acao foi selecionada
+    bool operacaoPincel(int linha, int coluna, int plano, Operacao &op);
+    // Mostra o primeiro plano do escultor atual e atualiza os sliders
+    void preparaEscultor();
+    // Copia os voxels i∈[i0,i1], j∈[j0,j1] do plano atual para imagemPlano
+    void atualizaImagem(int i0, int i1, int j0, int j1);
+    // Redesenha o gradeado e recalcula os espacamentos para o tamanho atual do widget
+    void desenhaGradeado();
+    // Atualiza na imagem as celulas i∈[i0,i1], j∈[j0,j1] do plano atual e invalida (com update) apenas a area do widget delas
+    void invalidaCelulas(int i0, int i1, int j0, int j1);
+    // Informa ao visualizador que o escultor mudou (ou foi substituido)
+    void notificaVisualizador();
+    // Informa a janela principal se ha passos a desfazer e a refazer
+    void atualizaHistorico();
 
 
 public:
@@ -65,10 +121,31 @@ public:
      */
     void paintEvent(QPaintEvent *event);
     /**
-     * @brief mousePressEvent : metodo resposavel por capturar o indice do escultor em que o mouse foi clicado e em seguida alterar as propriedades do escultor de acordo com a acao selecionada
+     * @brief mousePressEvent : metodo resposavel por capturar o indice do escultor em que o mouse foi clicado e iniciar um traco,
+     * aplicando imediatamente a acao selecionada nessa posicao
      * @param event : eventos relacionados ao click do mouse
      */
     void mousePressEvent(QMouseEvent *event);
+    /**
+     * @brief mouseMoveEvent : com o botao esquerdo pressionado, continua o traco ate a celula sob o mouse, aplicando o pincel
+     * em todas as celulas do caminho
+     * @param event : eventos relacionados ao movimento do mouse
+     */
+    void mouseMoveEvent(QMouseEvent *event);
+    /**
+     * @brief mouseReleaseEvent : termina o traco, que passa a ser um unico passo do historico
+     * @param event : eventos relacionados ao click do mouse
+     */
+    void mouseReleaseEvent(QMouseEvent *event);
+    /**
+     * @brief resizeEvent : redesenha o gradeado no novo tamanho do widget
+     * @param event : eventos relacionados ao redimensionamento
+     */
+    void resizeEvent(QResizeEvent *event);
+    /**
+     * @brief getMemoria : bytes alocados no momento pelo escultor, pela copia do plano e pela gravacao em andamento
+     */
+    MemoriaPlotter getMemoria() const;
 
 signals:
     /**
@@ -100,29 +177,74 @@ signals:
 
      */
     void alteraSliderB(int);
+    /**
+     * @brief podeDesfazer : sinal emitido apos cada alteracao do escultor, indicando se ha alguma alteracao a desfazer.
+     */
+    void podeDesfazer(bool);
+    /**
+     * @brief podeRefazer : sinal emitido apos cada alteracao do escultor, indicando se ha alguma alteracao desfeita a refazer.
+     */
+    void podeRefazer(bool);
+    /**
+     * @brief exportacaoIniciada : sinal emitido quando uma gravacao em segundo plano comeca, com o nome do arquivo.
+     */
+    void exportacaoIniciada(QString);
+    /**
+     * @brief progressoExportacao : sinal emitido com a porcentagem (entre 0 e 100) ja gravada.
+     */
+    void progressoExportacao(int);
+    /**
+     * @brief exportacaoTerminada : sinal emitido quando a gravacao termina (concluida, cancelada ou com erro), com a mensagem
+     * a ser mostrada na barra de status.
+     */
+    void exportacaoTerminada(QString);
 
+private slots:
+    // Aplica ao escultor, em um unico lote, os carimbos pendentes do traco e invalida as suas celulas
+    void aplicaTraco();
+    // Resultados do exportador: informam a janela principal (e o usuario, em caso de erro) e liberam o exportador
+    void exportacaoConcluida(QString arquivo);
+    void exportacaoCancelada(QString arquivo);
+    void exportacaoFalhou(QString mensagem);
 
 public slots:
     /**
      * @brief abreDialogEscultor : slot que abre a caixa de Dialogo do Escultor.
      */
     void abreDialogEscultor();
+    /**
+     * @brief abreEscultor : slot que abre uma caixa de dialogo para abrir um escultor salvo no formato .sculpt.
+     */
+    void abreEscultor();
     /**
      * @brief alteraCor : slot que abre uma caixa de dialogo para selecionar a cor para desenhar.
      */
     void alteraCor();
     /**
-     * @brief salvaEscultor : slot que abre uma caixa de dialogo para salvar o escultor no formato .off.
+     * @brief salvaEscultor : slot que abre uma caixa de dialogo para salvar o escultor (.off, .ply, .stl ou .sculpt).
+     * Uma copia do escultor eh gravada em segundo plano; enquanto isso ele pode continuar sendo alterado.
      */
     void salvaEscultor();
     /**
-     * @brief executaGeomview : slot que abre o GeomView com o escultor atual.
+     * @brief cancelaExportacao : interrompe a gravacao em segundo plano; o arquivo incompleto eh removido.
+     */
+    void cancelaExportacao();
+    /**
+     * @brief abreVisualizador : slot que abre a janela com a vista 3D do escultor atual.
      */
-    void executaGeomview();
+    void abreVisualizador();
     /**
      * @brief limpaEscultor: limpa do escultor zerando todos os Voxels e mantendo as dimensões do escultor atual.
      */
     void limpaEscultor();
+    /**
+     * @brief desfaz : desfaz a ultima alteracao do escultor (um click do mouse).
+     */
+    void desfaz();
+    /**
+     * @brief refaz : refaz a ultima alteracao desfeita.
+     */
+    void refaz();
     /**
      * @brief mudaPlanoZ : altera o plano Z mostrado na tela de acordo com o sinal mandado pelo SliderZ.
      * @param planoZ : indice referente ao plano Z selecionado.
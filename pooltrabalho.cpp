@@ -0,0 +1,85 @@
+#include "pooltrabalho.h"
+
+using namespace std;
+
+// Cria as n-1 threads auxiliares
+PoolTrabalho::PoolTrabalho(int n){
+    geracao = 0;
+    encerrando = false;
+    tarefa = nullptr;
+    totalTarefas = 0;
+    proxima = 0;
+    ocupadas = 0;
+    for(int t=1; t<n; t++){
+        auxiliares.push_back(thread(&PoolTrabalho::trabalha, this));
+    }
+}
+
+// Acorda as threads auxiliares para que terminem e aguarda cada uma
+PoolTrabalho::~PoolTrabalho(){
+    {
+        lock_guard<mutex> guarda(trava);
+        encerrando = true;
+    }
+    inicio.notify_all();
+    for(size_t t=0; t<auxiliares.size(); t++){
+        auxiliares[t].join();
+    }
+}
+
+// Processa tarefas do trabalho atual ate que nao reste nenhuma
+void PoolTrabalho::processa(){
+    int t;
+    while((t = proxima.fetch_add(1)) < totalTarefas){
+        (*tarefa)(t);
+    }
+}
+
+// Executa as tarefas com as threads auxiliares e a thread atual
+void PoolTrabalho::executa(int tarefas, const std::function<void(int)> &f){
+    if(tarefas <= 0){
+        return;
+    }
+    if(auxiliares.empty() || tarefas == 1){
+        for(int t=0; t<tarefas; t++){
+            f(t);
+        }
+        return;
+    }
+    {
+        lock_guard<mutex> guarda(trava);
+        tarefa = &f;
+        totalTarefas = tarefas;
+        proxima = 0;
+        ocupadas = (int)auxiliares.size();
+        geracao++;
+    }
+    inicio.notify_all();
+    processa();
+
+    // Aguarda as threads auxiliares terminarem as tarefas que ja pegaram
+    unique_lock<mutex> guarda(trava);
+    fim.wait(guarda, [this]{ return ocupadas == 0; });
+    tarefa = nullptr;
+}
+
+// Laco das threads auxiliares: espera um novo trabalho, processa e avisa quando terminou
+void PoolTrabalho::trabalha(){
+    unsigned long vista = 0;
+    while(true){
+        {
+            unique_lock<mutex> guarda(trava);
+            inicio.wait(guarda, [&]{ return encerrando || geracao != vista; });
+            if(encerrando){
+                return;
+            }
+            vista = geracao;
+        }
+        processa();
+        {
+            lock_guard<mutex> guarda(trava);
+            ocupadas--;
+        }
+        fim.notify_one();
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef POOLTRABALHO_H
+#define POOLTRABALHO_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/**
+ * @brief A classe PoolTrabalho
+ * mantem um conjunto fixo de threads que executam em paralelo as tarefas de uma chamada a executa().
+ * As threads ficam bloqueadas enquanto nao ha trabalho; a thread que chama executa() tambem processa tarefas
+ * e so retorna quando todas terminaram. As tarefas sao distribuidas dinamicamente (cada thread pega a proxima
+ * ainda nao iniciada), o que equilibra tarefas de custos diferentes.
+ */
+class PoolTrabalho
+{
+public:
+    /**
+     * @brief PoolTrabalho : cria o pool com n threads no total (contando a que chama executa()), ou seja, n-1 threads auxiliares
+     */
+    explicit PoolTrabalho(int n);
+
+    /**
+     * @brief ~PoolTrabalho : encerra e aguarda as threads auxiliares
+     */
+    ~PoolTrabalho();
+
+    /**
+     * @brief tamanho : numero total de threads que executam tarefas
+     */
+    int tamanho() const { return (int)auxiliares.size() + 1; }
+
+    /**
+     * @brief executa : chama f(t) para t∈[0,tarefas), em paralelo, e aguarda o termino de todas as chamadas.
+     * Nao deve ser chamado de dentro de uma tarefa.
+     */
+    void executa(int tarefas, const std::function<void(int)> &f);
+
+private:
+    std::vector<std::thread> auxiliares;
+    std::mutex trava;
+    std::condition_variable inicio, fim;
+    // Trabalho atual: incrementada a cada chamada a executa() para acordar as threads auxiliares
+    unsigned long geracao;
+    bool encerrando;
+    const std::function<void(int)> *tarefa;
+    int totalTarefas;
+    std::atomic<int> proxima;
+    // Threads auxiliares que ainda estao processando o trabalho atual
+    int ocupadas;
+
+    PoolTrabalho(const PoolTrabalho&) = delete;
+    PoolTrabalho& operator=(const PoolTrabalho&) = delete;
+
+    // Laco das threads auxiliares
+    void trabalha();
+    // Processa tarefas do trabalho atual ate que nao reste nenhuma
+    void processa();
+};
+
+#endif // POOLTRABALHO_H
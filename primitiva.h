@@ -0,0 +1,196 @@
+#ifndef PRIMITIVA_H
+#define PRIMITIVA_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+/*
+ * Rasterizacao das primitivas do Sculptor (caixa, esfera e elipsoide) em intervalos de y por linha (z,x).
+ * Usada pelas operacoes imediatas do Sculptor e pela avaliacao adiada da ArvoreCSG, que assim geram os mesmos voxels.
+ */
+
+// Parcela de um eixo na equacao do elipsoide, calculada exatamente como na varredura original
+// (para que o conjunto de voxels seja o mesmo, inclusive quando o raio eh zero)
+inline double parcela(int d, int raio){
+    return std::pow(d,2)/std::pow(raio,2);
+}
+
+// Maior h >= 0 tal que dentro(h) seja verdadeiro, partindo da estimativa h; retorna -1 se dentro(0) for falso.
+// dentro() deve ser monotona: verdadeira ate certo h e falsa a partir dele.
+template <typename Predicado>
+inline int maiorMeiaLargura(int h, int limite, Predicado dentro){
+    if(!dentro(0)){
+        return -1;
+    }
+    h = std::max(0, std::min(h, limite));
+    while(h > 0 && !dentro(h)){
+        h--;
+    }
+    while(h < limite && dentro(h+1)){
+        h++;
+    }
+    return h;
+}
+
+// Caixa, esfera ou elipsoide recortados aos limites do escultor.
+// A caixa envolvente (x0..x1, z0..z1) limita as linhas percorridas; em cada linha (z,x) o intervalo em y eh calculado
+// por intervalo(). Os casos do elipsoide com um raio zero geram uma elipse no plano do centro.
+struct Primitiva{
+    enum Forma { Vazia, Caixa, Esfera, Elipsoide, ElipsePlanoX, ElipsePlanoY, ElipsePlanoZ };
+    Forma forma;
+    int x0, x1, z0, z1;
+    // Intervalo em y da caixa
+    int yc0, yc1;
+    int xcenter, ycenter, zcenter;
+    int rx, ry, rz;
+    long long raio2;
+
+    static Primitiva caixa(int x0, int x1, int y0, int y1, int z0, int z1, int nx, int ny, int nz){
+        Primitiva p;
+        p.forma = Caixa;
+        p.x0 = std::max(x0, 0); p.yc0 = std::max(y0, 0); p.z0 = std::max(z0, 0);
+        p.x1 = std::min(x1, nx-1); p.yc1 = std::min(y1, ny-1); p.z1 = std::min(z1, nz-1);
+        if (p.x0 > p.x1 || p.yc0 > p.yc1 || p.z0 > p.z1){
+            p.forma = Vazia;
+        }
+        return p;
+    }
+
+    static Primitiva esfera(int xcenter, int ycenter, int zcenter, int radius, int nx, int nz){
+        Primitiva p;
+        p.forma = Esfera;
+        long long raio = std::abs(radius);
+        p.raio2 = raio*raio;
+        p.z0 = (int)std::max<long long>(zcenter - raio, 0); p.z1 = (int)std::min<long long>(zcenter + raio, nz-1);
+        p.x0 = (int)std::max<long long>(xcenter - raio, 0); p.x1 = (int)std::min<long long>(xcenter + raio, nx-1);
+        p.xcenter = xcenter; p.ycenter = ycenter; p.zcenter = zcenter;
+        return p;
+    }
+
+    static Primitiva elipsoide(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz, int nx, int ny, int nz){
+        Primitiva p;
+        int ax = std::abs(rx), az = std::abs(rz);
+        p.z0 = std::max(zcenter - az, 0); p.z1 = std::min(zcenter + az, nz-1);
+        p.x0 = std::max(xcenter - ax, 0); p.x1 = std::min(xcenter + ax, nx-1);
+        p.xcenter = xcenter; p.ycenter = ycenter; p.zcenter = zcenter;
+        p.rx = rx; p.ry = ry; p.rz = rz;
+        if(rx == 0){
+            // Elipse no plano x = xcenter
+            p.forma = (xcenter < 0 || xcenter >= nx) ? Vazia : ElipsePlanoX;
+            p.x0 = p.x1 = xcenter;
+        }
+        else if(ry == 0){
+            // Elipse no plano y = ycenter: um unico voxel por linha
+            p.forma = (ycenter < 0 || ycenter >= ny) ? Vazia : ElipsePlanoY;
+        }
+        else if(rz == 0){
+            // Elipse no plano z = zcenter
+            p.forma = (zcenter < 0 || zcenter >= nz) ? Vazia : ElipsePlanoZ;
+            p.z0 = p.z1 = zcenter;
+        }
+        else{
+            p.forma = Elipsoide;
+        }
+        return p;
+    }
+
+    // Intervalo em y da caixa envolvente, recortado a [0, ny-1] (vazio se y0 > y1)
+    void limitesY(int ny, int &y0, int &y1) const{
+        long long a, b;
+        switch(forma){
+        case Caixa:
+            a = yc0; b = yc1;
+            break;
+        case Esfera:{
+            long long raio = (long long)std::sqrt((double)raio2);
+            while(raio*raio > raio2){
+                raio--;
+            }
+            while((raio+1)*(raio+1) <= raio2){
+                raio++;
+            }
+            a = ycenter - raio; b = ycenter + raio;
+            break;
+        }
+        case ElipsePlanoY:
+            a = b = ycenter;
+            break;
+        case Vazia:
+            a = 0; b = -1;
+            break;
+        default:
+            a = ycenter - (long long)std::abs(ry); b = ycenter + (long long)std::abs(ry);
+            break;
+        }
+        y0 = (int)std::max<long long>(a, 0);
+        y1 = (int)std::min<long long>(b, ny-1);
+    }
+
+    // Intervalo [y0,y1] ocupado na linha (k,i) da caixa envolvente (ainda nao recortado em y); false se nao houver
+    bool intervalo(int k, int i, int &y0, int &y1) const{
+        switch(forma){
+        case Caixa:
+            y0 = yc0;
+            y1 = yc1;
+            return true;
+        case Esfera:{
+            long long dz = k - zcenter, dx = i - xcenter;
+            long long resto = raio2 - dz*dz - dx*dx;
+            if(resto < 0){
+                return false;
+            }
+            // h = floor(sqrt(resto)), corrigido para evitar erros de arredondamento
+            long long h = (long long)std::sqrt((double)resto);
+            while(h*h > resto){
+                h--;
+            }
+            while((h+1)*(h+1) <= resto){
+                h++;
+            }
+            y0 = (int)std::max<long long>(ycenter - h, INT_MIN);
+            y1 = (int)std::min<long long>(ycenter + h, INT_MAX);
+            return true;
+        }
+        case Elipsoide:{
+            // A ordem das somas eh a mesma da equacao original
+            double pz = parcela(k-zcenter, rz), px = parcela(i-xcenter, rx);
+            int ay = std::abs(ry);
+            int h = maiorMeiaLargura((int)(ay*std::sqrt(std::max(0.0, 1 - px - pz))), ay, [&](int dy){
+                return px + parcela(dy, ry) + pz <= 1;
+            });
+            y0 = ycenter - h;
+            y1 = ycenter + h;
+            return h >= 0;
+        }
+        case ElipsePlanoX:{
+            double pz = parcela(k-zcenter, rz);
+            int ay = std::abs(ry);
+            int h = maiorMeiaLargura((int)(ay*std::sqrt(std::max(0.0, 1 - pz))), ay, [&](int dy){
+                return parcela(dy, ry) + pz <= 1;
+            });
+            y0 = ycenter - h;
+            y1 = ycenter + h;
+            return h >= 0;
+        }
+        case ElipsePlanoY:
+            y0 = y1 = ycenter;
+            return parcela(i-xcenter, rx) + parcela(k-zcenter, rz) <= 1;
+        case ElipsePlanoZ:{
+            double px = parcela(i-xcenter, rx);
+            int ay = std::abs(ry);
+            int h = maiorMeiaLargura((int)(ay*std::sqrt(std::max(0.0, 1 - px))), ay, [&](int dy){
+                return px + parcela(dy, ry) <= 1;
+            });
+            y0 = ycenter - h;
+            y1 = ycenter + h;
+            return h >= 0;
+        }
+        default:
+            return false;
+        }
+    }
+};
+
+#endif // PRIMITIVA_H
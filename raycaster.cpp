@@ -0,0 +1,226 @@
+#include "raycaster.h"
+#include "pooltrabalho.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+// Cor de fundo, abertura vertical da camera e intensidade minima das faces (luz vinda da propria camera)
+static const uint32_t FUNDO = 0xff3c3c3c;
+static const double ABERTURA = 40.0;
+static const double AMBIENTE = 0.35;
+static const double INFINITO = 1e300;
+
+// Cria o raycaster sem volume; o pool de threads so eh criado no primeiro desenho
+Raycaster::Raycaster(int _threads){
+    v = nullptr;
+    nx = ny = nz = 0;
+    celX = celY = celZ = 0;
+    azimute = elevacao = 0;
+    distancia = 1.5;
+    threads = _threads > 0 ? _threads : max(1, (int)thread::hardware_concurrency());
+    pool = nullptr;
+}
+
+Raycaster::~Raycaster(){
+    delete pool;
+}
+
+// Marca as celulas com algum voxel ativo: cada byte de uma palavra da ocupacao corresponde a uma celula em y
+void Raycaster::setVolume(const VoxelStore *_v){
+    v = _v;
+    nx = v ? v->getNx() : 0;
+    ny = v ? v->getNy() : 0;
+    nz = v ? v->getNz() : 0;
+    celX = (nx + CELULA - 1)/CELULA;
+    celY = (ny + CELULA - 1)/CELULA;
+    celZ = (nz + CELULA - 1)/CELULA;
+    ocupadas.assign((size_t)celX*celY*celZ, 0);
+    if(ocupadas.empty()){
+        return;
+    }
+    if(pool == nullptr){
+        pool = new PoolTrabalho(threads);
+    }
+    // Cada tarefa marca uma camada de celulas em z, logo as tarefas nao escrevem nas mesmas posicoes
+    pool->executa(celZ, [&](int kz){
+        vector<uint64_t> buffer(v->palavrasPorLinha());
+        for(int z=kz*CELULA; z<min(nz, kz*CELULA + CELULA); z++){
+            for(int x=0; x<nx; x++){
+                if(v->linhaVazia(x, z)){
+                    continue;
+                }
+                const uint64_t *bits = v->ocupacao(x, z, &buffer[0]);
+                unsigned char *linha = &ocupadas[((size_t)kz*celX + x/CELULA)*celY];
+                for(int w=0; w<v->palavrasPorLinha(); w++){
+                    for(int k=0; k<8 && bits[w] != 0; k++){
+                        if((bits[w] >> (8*k)) & 0xff){
+                            linha[w*8 + k] = 1;
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+void Raycaster::setCamera(double _azimute, double _elevacao, double _distancia){
+    // A elevacao nao chega aos polos, onde a direcao "para cima" da tela ficaria indefinida
+    const double limite = 1.55;
+    azimute = _azimute;
+    elevacao = max(-limite, min(limite, _elevacao));
+    distancia = max(0.05, _distancia);
+}
+
+// Percorre a grade a partir da entrada do raio na caixa do escultor, pulando as celulas vazias inteiras
+uint32_t Raycaster::tracaRaio(const double o[3], const double d[3]) const{
+    const int n[3] = {nx, ny, nz};
+
+    // Intervalo [t0,t1] do raio dentro da caixa [0,n); eixo guarda a face de entrada (-1 se a camera esta dentro)
+    double t0 = 0, t1 = INFINITO;
+    int eixo = -1;
+    for(int a=0; a<3; a++){
+        if(d[a] == 0){
+            if(o[a] < 0 || o[a] >= n[a]){
+                return FUNDO;
+            }
+            continue;
+        }
+        double ta = (0 - o[a])/d[a], tb = (n[a] - o[a])/d[a];
+        if(ta > tb){
+            swap(ta, tb);
+        }
+        if(ta > t0){
+            t0 = ta;
+            eixo = a;
+        }
+        t1 = min(t1, tb);
+    }
+    if(t0 >= t1){
+        return FUNDO;
+    }
+
+    int passo[3], p[3];
+    double tMax[3], tDelta[3];
+    for(int a=0; a<3; a++){
+        passo[a] = d[a] > 0 ? 1 : -1;
+        tDelta[a] = d[a] != 0 ? fabs(1/d[a]) : INFINITO;
+        p[a] = (int)floor(o[a] + t0*d[a]);
+        p[a] = max(0, min(n[a]-1, p[a]));
+    }
+    // Na face de entrada o voxel eh o primeiro do lado de dentro, mesmo com erros de arredondamento
+    if(eixo >= 0){
+        p[eixo] = passo[eixo] > 0 ? 0 : n[eixo]-1;
+    }
+
+    // Cada volta avanca pelo menos uma celula; o limite so protege contra erros de arredondamento nas bordas
+    int voltas = 4*(celX + celY + celZ) + 16;
+    while(voltas-- > 0){
+        for(int a=0; a<3; a++){
+            tMax[a] = d[a] != 0 ? ((p[a] + (passo[a] > 0 ? 1 : 0)) - o[a])/d[a] : INFINITO;
+        }
+        if(!celulaOcupada(p[0], p[1], p[2])){
+            // Sai da celula pela primeira face que o raio atravessa
+            double tSaida = INFINITO;
+            int saida = 0;
+            for(int a=0; a<3; a++){
+                if(d[a] == 0){
+                    continue;
+                }
+                int borda = passo[a] > 0 ? min(n[a], (p[a]/CELULA + 1)*CELULA) : (p[a]/CELULA)*CELULA;
+                double t = (borda - o[a])/d[a];
+                if(t < tSaida){
+                    tSaida = t;
+                    saida = a;
+                }
+            }
+            eixo = saida;
+            p[saida] = passo[saida] > 0 ? min(n[saida], (p[saida]/CELULA + 1)*CELULA) : (p[saida]/CELULA)*CELULA - 1;
+            if(p[saida] < 0 || p[saida] >= n[saida]){
+                return FUNDO;
+            }
+            for(int a=0; a<3; a++){
+                if(a != saida){
+                    p[a] = max(0, min(n[a]-1, (int)floor(o[a] + tSaida*d[a])));
+                }
+            }
+            continue;
+        }
+
+        // DDA voxel a voxel ate atingir um voxel ativo ou sair da celula
+        int c[3] = {p[0]/CELULA, p[1]/CELULA, p[2]/CELULA};
+        while(true){
+            if(v->ativo(p[0], p[1], p[2])){
+                Cor cor = v->cor(p[0], p[1], p[2]);
+                double luz = eixo >= 0 ? AMBIENTE + (1 - AMBIENTE)*fabs(d[eixo]) : 1;
+                uint32_t r = (uint32_t)min(255.0, cor.r*luz*255 + 0.5);
+                uint32_t g = (uint32_t)min(255.0, cor.g*luz*255 + 0.5);
+                uint32_t b = (uint32_t)min(255.0, cor.b*luz*255 + 0.5);
+                return 0xff000000u | (r << 16) | (g << 8) | b;
+            }
+            int a = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+            p[a] += passo[a];
+            tMax[a] += tDelta[a];
+            eixo = a;
+            if(p[a] < 0 || p[a] >= n[a]){
+                return FUNDO;
+            }
+            if(p[a]/CELULA != c[a]){
+                break;
+            }
+        }
+    }
+    return FUNDO;
+}
+
+// Monta a base da camera e desenha os blocos de pixels em paralelo
+void Raycaster::renderiza(uint32_t *pixels, int largura, int altura){
+    if(largura <= 0 || altura <= 0){
+        return;
+    }
+    if(v == nullptr || ocupadas.empty()){
+        fill(pixels, pixels + (size_t)largura*altura, FUNDO);
+        return;
+    }
+    if(pool == nullptr){
+        pool = new PoolTrabalho(threads);
+    }
+
+    // Eixos da tela no espaco dos indices (x, y, z): "para cima" eh -x; com angulos zero a camera fica em z < 0
+    const double cima[3] = {-1, 0, 0};
+    double ce = cos(elevacao), se = sin(elevacao), ca = cos(azimute), sa = sin(azimute);
+    double dir[3] = {se*cima[0], ce*sa, -ce*ca};
+    double diagonal = sqrt((double)nx*nx + (double)ny*ny + (double)nz*nz);
+    double olho[3] = {nx/2.0 + distancia*diagonal*dir[0], ny/2.0 + distancia*diagonal*dir[1], nz/2.0 + distancia*diagonal*dir[2]};
+    double frente[3] = {-dir[0], -dir[1], -dir[2]};
+    // direita = cima x frente, acima = frente x direita
+    double direita[3] = {cima[1]*frente[2] - cima[2]*frente[1], cima[2]*frente[0] - cima[0]*frente[2], cima[0]*frente[1] - cima[1]*frente[0]};
+    double norma = sqrt(direita[0]*direita[0] + direita[1]*direita[1] + direita[2]*direita[2]);
+    for(int a=0; a<3; a++){
+        direita[a] /= norma;
+    }
+    double acima[3] = {frente[1]*direita[2] - frente[2]*direita[1], frente[2]*direita[0] - frente[0]*direita[2], frente[0]*direita[1] - frente[1]*direita[0]};
+    double escala = tan(ABERTURA*M_PI/360.0);
+    double aspecto = (double)largura/altura;
+
+    int tilesX = (largura + TILE - 1)/TILE, tilesY = (altura + TILE - 1)/TILE;
+    pool->executa(tilesX*tilesY, [&](int t){
+        int x0 = (t % tilesX)*TILE, y0 = (t / tilesX)*TILE;
+        for(int py=y0; py<min(altura, y0 + TILE); py++){
+            double sy = (1 - 2*(py + 0.5)/altura)*escala;
+            for(int px=x0; px<min(largura, x0 + TILE); px++){
+                double sx = (2*(px + 0.5)/largura - 1)*escala*aspecto;
+                double d[3];
+                for(int a=0; a<3; a++){
+                    d[a] = frente[a] + sx*direita[a] + sy*acima[a];
+                }
+                double n = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+                for(int a=0; a<3; a++){
+                    d[a] /= n;
+                }
+                pixels[(size_t)py*largura + px] = tracaRaio(olho, d);
+            }
+        }
+    });
+}
@@ -0,0 +1,81 @@
+#ifndef RAYCASTER_H
+#define RAYCASTER_H
+
+#include <cstdint>
+#include <vector>
+#include "voxelstore.h"
+
+class PoolTrabalho;
+
+/**
+ * @brief A classe Raycaster
+ * desenha uma vista 3D do escultor lancando um raio por pixel diretamente sobre os voxels, sem gerar malha.
+ *
+ * Cada raio percorre a grade com o DDA 3D (Amanatides-Woo), voxel a voxel, ate encontrar o primeiro voxel ativo.
+ * Para pular o espaco vazio o escultor eh dividido em celulas de CELULA³ voxels, marcadas como ocupadas ou vazias
+ * em setVolume(); as celulas vazias sao atravessadas de uma so vez. A imagem eh dividida em blocos de TILE x TILE
+ * pixels, desenhados em paralelo.
+ *
+ * A camera orbita em torno do centro do escultor: com angulos zero ela olha o plano z = 0 de frente, como o Plotter,
+ * com as linhas (x) crescendo para baixo e as colunas (y) para a direita.
+ */
+class Raycaster
+{
+public:
+    /**
+     * @brief CELULA : aresta das celulas usadas para pular o espaco vazio (um oitavo de uma palavra da ocupacao)
+     */
+    static const int CELULA = 8;
+
+    /**
+     * @brief TILE : aresta dos blocos de pixels distribuidos entre as threads
+     */
+    static const int TILE = 32;
+
+    /**
+     * @brief Raycaster : cria o raycaster sem volume
+     * @param threads : numero de threads usadas no desenho (0 = uma por nucleo)
+     */
+    explicit Raycaster(int threads = 0);
+    ~Raycaster();
+
+    /**
+     * @brief setVolume : define o armazenamento a ser desenhado e recalcula as celulas ocupadas. Deve ser chamado de novo
+     * sempre que o escultor for alterado; o armazenamento nao pode ser alterado durante renderiza().
+     */
+    void setVolume(const VoxelStore *_v);
+
+    /**
+     * @brief setCamera : posiciona a camera
+     * @param azimute : rotacao (em radianos) em torno do eixo vertical da tela
+     * @param elevacao : inclinacao (em radianos) acima do plano horizontal, entre -pi/2 e pi/2
+     * @param distancia : distancia ao centro do escultor, em multiplos da diagonal do escultor
+     */
+    void setCamera(double azimute, double elevacao, double distancia);
+
+    /**
+     * @brief renderiza : desenha a vista atual em pixels (largura x altura, linha a linha, no formato 0xAARRGGBB)
+     */
+    void renderiza(uint32_t *pixels, int largura, int altura);
+
+private:
+    const VoxelStore *v;
+    int nx, ny, nz;
+    // Numero de celulas em x, y e z e a marca de ocupacao de cada uma, na mesma ordem [z][x][y] dos voxels
+    int celX, celY, celZ;
+    std::vector<unsigned char> ocupadas;
+    double azimute, elevacao, distancia;
+    int threads;
+    PoolTrabalho *pool;
+
+    Raycaster(const Raycaster&) = delete;
+    Raycaster& operator=(const Raycaster&) = delete;
+
+    // Cor do pixel atingido pelo raio o + t*d (d normalizado)
+    uint32_t tracaRaio(const double o[3], const double d[3]) const;
+    bool celulaOcupada(int x, int y, int z) const {
+        return ocupadas[((size_t)(z/CELULA)*celX + x/CELULA)*celY + y/CELULA] != 0;
+    }
+};
+
+#endif // RAYCASTER_H
@@ -0,0 +1,123 @@
+#include "saidabufferizada.h"
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+// Abre o arquivo e aloca o buffer
+SaidaBufferizada::SaidaBufferizada(const std::string &filename){
+    arquivo = fopen(filename.c_str(), "wb");
+    destino = nullptr;
+    buffer = new char[TAMANHO_BUFFER];
+    usado = 0;
+    erro = false;
+}
+
+// Acumula a saida no vetor destino
+SaidaBufferizada::SaidaBufferizada(std::vector<char> *_destino){
+    arquivo = nullptr;
+    destino = _destino;
+    buffer = new char[TAMANHO_BUFFER];
+    usado = 0;
+    erro = false;
+}
+
+// Descarrega o buffer e fecha o arquivo
+SaidaBufferizada::~SaidaBufferizada(){
+    fecha();
+    delete [] buffer;
+}
+
+// Descarrega o buffer e fecha o arquivo (ou apenas descarrega, no caso de um vetor)
+bool SaidaBufferizada::fecha(){
+    if(destino != nullptr){
+        descarrega();
+        destino = nullptr;
+        return true;
+    }
+    if(arquivo == nullptr){
+        return false;
+    }
+    descarrega();
+    if(fclose(arquivo) != 0){
+        erro = true;
+    }
+    arquivo = nullptr;
+    return !erro;
+}
+
+// Grava o conteudo do buffer no arquivo (ou no vetor)
+void SaidaBufferizada::descarrega(){
+    if(usado > 0 && destino != nullptr){
+        destino->insert(destino->end(), buffer, buffer + usado);
+    }
+    else if(usado > 0 && arquivo != nullptr){
+        if(fwrite(buffer, 1, usado, arquivo) != usado){
+            erro = true;
+        }
+    }
+    usado = 0;
+}
+
+// Copia n bytes para a saida; blocos maiores que o buffer sao gravados diretamente
+void SaidaBufferizada::escreve(const void *dados, size_t n){
+    if(n >= TAMANHO_BUFFER){
+        descarrega();
+        if(destino != nullptr){
+            destino->insert(destino->end(), (const char*)dados, (const char*)dados + n);
+        }
+        else if(arquivo != nullptr && fwrite(dados, 1, n, arquivo) != n){
+            erro = true;
+        }
+        return;
+    }
+    reserva(n);
+    memcpy(buffer + usado, dados, n);
+    usado += n;
+}
+
+// Copia uma string terminada em zero para a saida
+void SaidaBufferizada::texto(const char *s){
+    escreve(s, strlen(s));
+}
+
+// Escreve um inteiro em base 10
+void SaidaBufferizada::inteiro(long long valor){
+    char digitos[24];
+    int n = 0;
+    unsigned long long u = valor < 0 ? 0ULL - (unsigned long long)valor : (unsigned long long)valor;
+    do{
+        digitos[n++] = (char)('0' + u % 10);
+        u /= 10;
+    }while(u);
+
+    reserva(n + 1);
+    if(valor < 0){
+        buffer[usado++] = '-';
+    }
+    while(n > 0){
+        buffer[usado++] = digitos[--n];
+    }
+}
+
+// Escreve um real com uma casa decimal.
+// valor*10 eh exato em double (24 bits de mantissa vezes 4 bits), entao arredondar esse produto para o inteiro
+// mais proximo no modo de arredondamento atual da exatamente o digito que o printf("%.1f") produziria.
+void SaidaBufferizada::real1(float valor){
+    double dezenas = fabs((double)valor*10.0);
+    if(!(dezenas < 9007199254740992.0)){
+        // Infinito, NaN ou grande demais: deixa a formatacao para a biblioteca
+        char texto[64];
+        int n = snprintf(texto, sizeof(texto), "%.1f", (double)valor);
+        escreve(texto, (size_t)n);
+        return;
+    }
+    long long n = (long long)nearbyint(dezenas);
+    if(signbit(valor)){
+        caractere('-');
+    }
+    inteiro(n/10);
+    reserva(2);
+    buffer[usado++] = '.';
+    buffer[usado++] = (char)('0' + n%10);
+}
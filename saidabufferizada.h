@@ -0,0 +1,126 @@
+#ifndef SAIDABUFFERIZADA_H
+#define SAIDABUFFERIZADA_H
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A classe SaidaBufferizada
+ * grava um arquivo atraves de um buffer de tamanho fixo, que eh descarregado no disco sempre que enche.
+ * Os numeros sao formatados diretamente no buffer, sem streams nem strings intermediarias,
+ * produzindo o mesmo texto que std::ostream (real1() equivale a "fixed << setprecision(1)");
+ * os formatos binarios usam inteiroBinario(), curtoBinario() e realBinario().
+ * Assim a memoria usada nao depende do tamanho do arquivo.
+ * Tambem pode acumular a saida num vetor, para que trechos formatados em paralelo sejam gravados depois em ordem.
+ */
+class SaidaBufferizada
+{
+public:
+    /**
+     * @brief TAMANHO_BUFFER : quantidade de bytes acumulados antes de cada gravacao no disco
+     */
+    static const size_t TAMANHO_BUFFER = 1 << 16;
+
+    /**
+     * @brief SaidaBufferizada : abre o arquivo filename para gravacao (em modo binario, sem conversao de fim de linha)
+     */
+    explicit SaidaBufferizada(const std::string &filename);
+
+    /**
+     * @brief SaidaBufferizada : acumula a saida no final do vetor destino em vez de grava-la num arquivo
+     */
+    explicit SaidaBufferizada(std::vector<char> *destino);
+
+    /**
+      * @brief ~SaidaBufferizada : descarrega o buffer e fecha o arquivo
+    */
+    ~SaidaBufferizada();
+
+    /**
+     * @brief aberto : retorna se o arquivo foi aberto corretamente
+     */
+    bool aberto() const { return arquivo != nullptr || destino != nullptr; }
+
+    /**
+     * @brief fecha : descarrega o buffer e fecha o arquivo
+     * @return false se alguma gravacao falhou
+     */
+    bool fecha();
+
+    /**
+     * @brief escreve : copia n bytes para a saida
+     */
+    void escreve(const void *dados, size_t n);
+
+    /**
+     * @brief texto : copia uma string terminada em zero para a saida
+     */
+    void texto(const char *s);
+
+    /**
+     * @brief caractere : copia um caractere para a saida
+     */
+    void caractere(char c){
+        if(usado == TAMANHO_BUFFER){
+            descarrega();
+        }
+        buffer[usado++] = c;
+    }
+
+    /**
+     * @brief inteiro : escreve um inteiro em base 10
+     */
+    void inteiro(long long valor);
+
+    /**
+     * @brief real1 : escreve um real com uma casa decimal, arredondado como em printf("%.1f")
+     */
+    void real1(float valor);
+
+    /**
+     * @brief inteiroBinario, curtoBinario, realBinario : escrevem o valor em binario little endian
+     * (4, 2 e 4 bytes), independente da ordem de bytes da maquina
+     */
+    void inteiroBinario(uint32_t valor){
+        reserva(4);
+        buffer[usado++] = (char)(valor & 0xFF);
+        buffer[usado++] = (char)((valor >> 8) & 0xFF);
+        buffer[usado++] = (char)((valor >> 16) & 0xFF);
+        buffer[usado++] = (char)(valor >> 24);
+    }
+    void curtoBinario(uint16_t valor){
+        reserva(2);
+        buffer[usado++] = (char)(valor & 0xFF);
+        buffer[usado++] = (char)(valor >> 8);
+    }
+    void realBinario(float valor){
+        uint32_t bits;
+        memcpy(&bits, &valor, sizeof(bits));
+        inteiroBinario(bits);
+    }
+
+private:
+    FILE *arquivo;
+    std::vector<char> *destino;
+    char *buffer;
+    size_t usado;
+    bool erro;
+
+    SaidaBufferizada(const SaidaBufferizada&) = delete;
+    SaidaBufferizada& operator=(const SaidaBufferizada&) = delete;
+
+    // Grava o conteudo do buffer no arquivo
+    void descarrega();
+    // Garante que ha pelo menos n bytes livres no buffer
+    void reserva(size_t n){
+        if(TAMANHO_BUFFER - usado < n){
+            descarrega();
+        }
+    }
+};
+
+#endif // SAIDABUFFERIZADA_H
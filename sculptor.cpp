@@ -1,67 +1,276 @@
 #include "sculptor.h"
+#include "saidabufferizada.h"
+#include "arquivosculpt.h"
+#include "arvorecsg.h"
+#include "historico.h"
+#include "voxelstoreesparso.h"
+#include "pooltrabalho.h"
+#include "primitiva.h"
+#include "diagnostico.h"
 #include <iostream>
+#include <iomanip>
+#include <sstream>
 #include <cmath>
+#include <cstdio>
 #include <string>
-#include <sstream>
-#include <fstream>
-#include <iomanip>
 #include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <limits>
+#include <cstring>
+#include <unordered_map>
+#include <thread>
 
 using namespace std;
 
 
+// Numero de planos de cada fatia usada pelas operacoes em paralelo e pela leitura dos arquivos .sculpt,
+// igual a altura dos blocos do armazenamento esparso
+static const int PLANOS_FATIA = VoxelStoreEsparso::BLOCO_Z;
+
+// Numero de faces gravadas entre duas chamadas de informaProgresso() nos formatos de malha
+static const size_t FACES_PROGRESSO = 1 << 16;
+
+// Orcamento inicial: o da variavel de ambiente SCULPTOR_ORCAMENTO_MEMORIA (em MiB), se valida, ou sem limite
+static size_t orcamentoInicial(){
+    const char *valor = getenv("SCULPTOR_ORCAMENTO_MEMORIA");
+    if(valor == nullptr){
+        return 0;
+    }
+    char *fim;
+    unsigned long long mib = strtoull(valor, &fim, 10);
+    if(fim == valor || *fim != '\0' || mib > numeric_limits<size_t>::max()/(1024*1024)){
+        return 0;
+    }
+    return (size_t)mib*1024*1024;
+}
+
+atomic<size_t> Sculptor::orcamentoMemoria(orcamentoInicial());
+
+// Bytes em MiB com uma casa decimal, para as mensagens
+static string descreveBytes(size_t bytes){
+    ostringstream s;
+    s << fixed << setprecision(1) << bytes/(1024.0*1024.0) << " MiB";
+    return s.str();
+}
+
 // Construtor da classe Sculptor
-Sculptor::Sculptor(int _nx, int _ny, int _nz){
-    nx = _nx;
-    ny = _ny;
-    nz = _nz;
+Sculptor::Sculptor(int _nx, int _ny, int _nz, VoxelStore::Layout layout, VoxelStore::Backend backend){
     // Verifica se as quantidades de linhas, colunas e planos sao positivas
-    if (nx <= 0 || ny <= 0|| nz <= 0){
-        nx = ny = nz = 0;
+    if (_nx <= 0 || _ny <= 0|| _nz <= 0){
+        _nx = _ny = _nz = 0;
     }
-    // Solicita um bloco de memoria com a quantidade de planos
-    v = new Voxel**[nz];
-    // Verifica se o bloco foi armazenado
-    if(v == nullptr){
-        exit(0);
+    // Verifica, antes de alocar, se o escultor cabe no orcamento de memoria (o denso pode ser trocado pelo esparso)
+    VoxelStore::Backend pedido = backend;
+    string erro;
+    if (!cabeNoOrcamento(_nx, _ny, _nz, layout, backend, &erro)){
+        DIAGNOSTICO(Diagnostico::Erro, erro);
+        _nx = _ny = _nz = 0;
     }
-    // Solicita um bloco que armazena o indice as linhas dos planos
-    v[0] = new Voxel*[nz*nx];
-    // Verifica se o bloco foi armazenado
-    if(v[0] == nullptr){
-        exit(0);
+    else if (backend != pedido){
+        DIAGNOSTICO(Diagnostico::Aviso, "Escultor " << _nx << "x" << _ny << "x" << _nz << " denso ("
+                    << descreveBytes(memoriaProjetada(_nx, _ny, _nz, layout, pedido)) << ") excede o orcamento de "
+                    << descreveBytes(getOrcamentoMemoria()) << "; usando o armazenamento esparso");
     }
+    // Solicita o armazenamento de todos os voxels na matriz 3D, ja zerados
+    inicializa(VoxelStore::cria(_nx, _ny, _nz, layout, backend));
+
+    DIAGNOSTICO(Diagnostico::Info, "Escultor " << nx << "x" << ny << "x" << nz << " ("
+                << (backend == VoxelStore::Esparso ? "esparso" : "denso") << ", "
+                << (layout == VoxelStore::AoS ? "AoS" : "SoA") << "): "
+                << getMemoria().total() << " bytes alocados");
+}
+
+// Cria o escultor sobre um armazenamento ja preenchido
+Sculptor::Sculptor(VoxelStore *_v){
+    inicializa(_v);
+}
+
+// Adota o armazenamento e cria as estruturas auxiliares
+void Sculptor::inicializa(VoxelStore *_v){
+    v = _v;
+    nx = v->getNx();
+    ny = v->getNy();
+    nz = v->getNz();
+    r = g = b = a = 0;
+    // Area de trabalho de atualizaSuperficie(): as cinco linhas de ocupacao envolvidas e a mascara dos ocultos
+    rascunho.assign(6*(size_t)v->palavrasPorLinha(), 0);
+    linhaSuja.assign((size_t)nx*nz, 0);
+    arquivo = nullptr;
+    fatiasPendentes = 0;
+    arvore = new ArvoreCSG(nx, ny, nz);
+    adiado = false;
+    historico = new Historico(nx, ny, nz);
+    threads = 0;
+    pool = nullptr;
+    memoriaGravacao = 0;
+    zeraEstatisticas();
+}
+
+// Bytes alocados por estrutura
+Memoria Sculptor::getMemoria() const{
+    Memoria m;
+    m.voxels = v->memoria();
+    m.auxiliares = rascunho.capacity()*sizeof(uint64_t) + linhaSuja.capacity() + linhasSujas.capacity()*sizeof(int)
+                   + fatiaPendente.capacity() + arvore->memoria();
+    m.historico = historico->memoria();
+    m.gravacao = memoriaGravacao;
+    return m;
+}
+
+void Sculptor::setOrcamentoMemoria(size_t bytes){
+    orcamentoMemoria = bytes;
+}
 
-    // Distribui os planos
-    for (int k=1;k<nz;k++){
-        v[k] = v[k-1] + nx;
+size_t Sculptor::getOrcamentoMemoria(){
+    return orcamentoMemoria;
+}
+
+// Armazenamento mais as areas alocadas por inicializa(): o rascunho da superficie e as marcas de linhas sujas
+size_t Sculptor::memoriaProjetada(int _nx, int _ny, int _nz, VoxelStore::Layout layout, VoxelStore::Backend backend){
+    if (_nx <= 0 || _ny <= 0|| _nz <= 0){
+        return 0;
+    }
+    size_t voxels = VoxelStore::memoriaProjetada(_nx, _ny, _nz, layout, backend);
+    double auxiliares = 6.0*(((int64_t)_ny + 63)/64)*sizeof(uint64_t) + (double)_nx*_nz;
+    if(voxels + auxiliares >= (double)numeric_limits<size_t>::max()){
+        return numeric_limits<size_t>::max();
     }
-    // Solicita um bloco de memoria que armazena todos os voxels na matriz 3D
-    v[0][0] = new Voxel[nz*nx*ny];
-    // Verifica se o bloco foi armazenado
-    if(v[0][0] == nullptr){
-        exit(0);
+    return voxels + (size_t)auxiliares;
+}
+
+// Verifica o backend pedido e, se ele for o denso, o esparso
+bool Sculptor::cabeNoOrcamento(int _nx, int _ny, int _nz, VoxelStore::Layout layout, VoxelStore::Backend &backend,
+                               string *erro){
+    size_t limite = orcamentoMemoria;
+    size_t necessaria = memoriaProjetada(_nx, _ny, _nz, layout, backend);
+    if(limite == 0 || necessaria <= limite){
+        return true;
     }
-    //Distribui as colunas entre as linhas e os planos
-    int n = 0;
-    for (int k=0; k<nz;k++){
-        for(int i=0; i<nx;i++){
-            v[k][i] = v[0][0] + n*ny;
-            n++;
+    if(backend == VoxelStore::Denso){
+        size_t esparso = memoriaProjetada(_nx, _ny, _nz, layout, VoxelStore::Esparso);
+        if(esparso <= limite){
+            backend = VoxelStore::Esparso;
+            return true;
         }
+        necessaria = esparso;
     }
-    inicializaMatriz3D();
-
+    if(erro != nullptr){
+        ostringstream s;
+        s << "O escultor " << _nx << "x" << _ny << "x" << _nz << " precisa de " << descreveBytes(necessaria)
+          << ", mais que o orcamento de memoria de " << descreveBytes(limite);
+        *erro = s.str();
+    }
+    return false;
 }
 
 // Destrutor da classe Sculptor
 Sculptor::~Sculptor(){
-    if (nx == 0 || ny == 0|| nz == 0){
+    delete v;
+    delete arquivo;
+    delete arvore;
+    delete historico;
+    delete pool;
+}
+
+// Copia o escultor ja materializado e com a superficie atualizada, de modo que a copia nao depende do arquivo
+// de origem nem das operacoes adiadas deste escultor
+Sculptor* Sculptor::copia(string *erro){
+    materializa(0, nz-1);
+    atualizaSuperficie();
+    // A copia convive com este escultor, logo os dois juntos devem caber no orcamento de memoria
+    size_t limite = orcamentoMemoria;
+    if(limite > 0){
+        VoxelStore::Layout layout = v->getLayout();
+        VoxelStore::Backend backend = v->getBackend();
+        size_t auxiliares = memoriaProjetada(nx, ny, nz, layout, backend)
+                            - VoxelStore::memoriaProjetada(nx, ny, nz, layout, backend);
+        size_t usada = getMemoria().total(), necessaria = v->memoria() + auxiliares;
+        if(usada > limite || necessaria > limite - usada){
+            ostringstream s;
+            s << "A copia do escultor precisa de " << descreveBytes(necessaria) << ", mas o escultor ja usa "
+              << descreveBytes(usada) << " do orcamento de memoria de " << descreveBytes(limite);
+            DIAGNOSTICO(Diagnostico::Aviso, s.str());
+            if(erro != nullptr){
+                *erro = s.str();
+            }
+            return nullptr;
+        }
+    }
+    Sculptor *s = new Sculptor(v->copia());
+    s->setColor(r, g, b, a);
+    s->threads = threads;
+    DIAGNOSTICO(Diagnostico::Depuracao, "Copia do escultor: " << s->v->memoria() << " bytes");
+    return s;
+}
+
+// Define a funcao que acompanha as gravacoes
+void Sculptor::setProgresso(const std::function<bool(double)> &f){
+    progresso = f;
+}
+
+// Informa o progresso da gravacao; retorna false se ela deve ser cancelada
+bool Sculptor::informaProgresso(double fracao){
+    return !progresso || progresso(fracao);
+}
+
+// Fecha o arquivo gravado e remove o arquivo incompleto em caso de falha ou cancelamento
+bool Sculptor::terminaGravacao(SaidaBufferizada &fout, const std::string &filename, const char *formato, bool cancelada){
+    bool gravado = fout.fecha();
+    memoriaGravacao = 0;
+    if(cancelada){
+        remove(filename.c_str());
+        DIAGNOSTICO(Diagnostico::Info, "Gravacao do arquivo " << formato << " " << filename << " cancelada");
+        return false;
+    }
+    if(!gravado){
+        remove(filename.c_str());
+        DIAGNOSTICO(Diagnostico::Erro, "Erro ao gravar o arquivo " << formato << " " << filename);
+        return false;
+    }
+    informaProgresso(1.0);
+    DIAGNOSTICO(Diagnostico::Info, "Arquivo " << formato << " gravado com sucesso");
+    return true;
+}
+
+// Define o numero de threads das primitivas; o pool eh recriado na proxima operacao
+void Sculptor::setThreads(int n){
+    threads = max(n, 0);
+    delete pool;
+    pool = nullptr;
+}
+
+// Numero de threads efetivamente usadas
+int Sculptor::getThreads() const{
+    if(threads > 0){
+        return threads;
+    }
+    return max(1, (int)thread::hardware_concurrency());
+}
+
+// Pool de threads, criado na primeira operacao que o usa
+PoolTrabalho* Sculptor::obtemPool(){
+    if(pool == nullptr){
+        pool = new PoolTrabalho(getThreads());
+    }
+    return pool;
+}
+
+// Executa f em cada fatia de planos; com mais de uma fatia e mais de uma thread, as fatias sao divididas pelo pool
+void Sculptor::paraCadaFatia(int z0, int z1, const std::function<void(int, int)> &f){
+    if(z0 > z1){
+        return;
+    }
+    int primeira = z0/PLANOS_FATIA, ultima = z1/PLANOS_FATIA;
+    if(getThreads() == 1 || primeira == ultima){
+        f(z0, z1);
         return;
     }
-    delete [] v[0][0];
-    delete [] v[0];
-    delete [] v;
+    obtemPool()->executa(ultima - primeira + 1, [&](int t){
+        int fatia = primeira + t;
+        f(max(z0, fatia*PLANOS_FATIA), min(z1, fatia*PLANOS_FATIA + PLANOS_FATIA - 1));
+    });
 }
 
 // Define a cor atual do desenho
@@ -75,335 +284,999 @@ void Sculptor::setColor(float _r, float _g, float _b, float alpha){
 // Ativa o voxel na posição (x,y,z) (fazendo isOn = true) e atribui ao mesmo a cor atual de desenho
 void Sculptor::putVoxel(int x, int y, int z){
     if(dentroDosLimites(x, y, z) == true){ // verificando se o usuário não está acessando algum elemento da matriz que não existe
-        v[z][x][y].isOn = true;
-        v[z][x][y].r = r;
-        v[z][x][y].g = g;
-        v[z][x][y].b = b;
-        v[z][x][y].a = a;
+        if(adiado){
+            aplicaPrimitiva(Primitiva::caixa(x, x, y, y, z, z, nx, ny, nz), true);
+            return;
+        }
+        bool automatico = iniciaPassoAutomatico();
+        materializa(z, z);
+        historico->registra(v, x, x, y, y, z, z);
+        Cor c = {r, g, b, a};
+        v->ativa(x, z, y, y, c);
+        marcaSujo(x, x, z, z);
+        if(automatico){
+            concluiPasso();
+        }
+    }
+    else{
+        estatisticas.escritasForaDosLimites++;
+        DIAGNOSTICO(Diagnostico::Depuracao, "putVoxel(" << x << "," << y << "," << z << ") fora dos limites");
     }
-
 }
 
 //Desativa o voxel na posição (x,y,z) (fazendo isOn = false)
 void Sculptor::cutVoxel(int x, int y, int z){
     if(dentroDosLimites(x, y, z) == true){ // verificando se o usuário não está acessando algum elemento da matriz que não existe
-        v[z][x][y].isOn = false;
+        if(adiado){
+            aplicaPrimitiva(Primitiva::caixa(x, x, y, y, z, z, nx, ny, nz), false);
+            return;
+        }
+        bool automatico = iniciaPassoAutomatico();
+        materializa(z, z);
+        historico->registra(v, x, x, y, y, z, z);
+        v->desativa(x, z, y, y);
+        marcaSujo(x, x, z, z);
+        if(automatico){
+            concluiPasso();
+        }
+    }
+    else{
+        estatisticas.escritasForaDosLimites++;
+        DIAGNOSTICO(Diagnostico::Depuracao, "cutVoxel(" << x << "," << y << "," << z << ") fora dos limites");
     }
 }
 
 // Ativa todos os voxels no intervalo x∈[x0,x1], y∈[y0,y1], z∈[z0,z1] e atribui aos mesmos a cor atual de desenho
 void Sculptor::putBox(int x0, int x1, int y0, int y1, int z0, int z1){
-    for (int k=z0; k<=z1; k++){
-        for (int i=x0; i<=x1; i++) {
-            for (int j=y0; j<=y1; j++) {
-                putVoxel(i,j,k);
-            }
-        }
-    }
+    contaRecorte(x0, x1, y0, y1, z0, z1);
+    aplicaPrimitiva(Primitiva::caixa(x0, x1, y0, y1, z0, z1, nx, ny, nz), true);
 }
 
 // Desativa todos os voxels no intervalo x∈[x0,x1], y∈[y0,y1], z∈[z0,z1] e atribui aos mesmos a cor atual de desenho
 void Sculptor::cutBox(int x0, int x1, int y0, int y1, int z0, int z1){
-    for (int k=z0; k<=z1; k++){
-        for (int i=x0; i<=x1; i++) {
-            for (int j=y0; j<=y1; j++) {
-                cutVoxel(i,j,k);
-            }
-        }
-    }
+    contaRecorte(x0, x1, y0, y1, z0, z1);
+    aplicaPrimitiva(Primitiva::caixa(x0, x1, y0, y1, z0, z1, nx, ny, nz), false);
 }
 
 //Ativa todos os voxels que satisfazem à equação da esfera e atribui aos mesmos a cor atual de desenho
 void Sculptor::putSphere(int xcenter, int ycenter, int zcenter, int radius){
-    double dist;
-    for(int k=0; k<nz; k++){
-        for (int i=0; i<nx; i++) {
-            for (int j=0; j<ny; j++){
-               dist = pow(i-xcenter,2) + pow(j-ycenter,2) + pow(k-zcenter,2);
-               if (dist <= pow(radius,2)){
-                   putVoxel(i,j,k);
-               }
-            }
-
-        }
-    }
+    long long raio = abs(radius);
+    contaRecorte(xcenter - raio, xcenter + raio, ycenter - raio, ycenter + raio, zcenter - raio, zcenter + raio);
+    aplicaPrimitiva(Primitiva::esfera(xcenter, ycenter, zcenter, radius, nx, nz), true);
 }
 
 //Desativa todos os voxels que satisfazem à equação da esfera
 void Sculptor::cutSphere(int xcenter, int ycenter, int zcenter, int radius){
-    double dist;
-    for(int k=0; k<nz; k++){
-        for (int i=0; i<nx; i++) {
-            for (int j=0; j<ny; j++){
-               dist = pow(i-xcenter,2) + pow(j-ycenter,2) + pow(k-zcenter,2);
-               if (dist <= pow(radius,2)){
-                   cutVoxel(i,j,k);
-               }
-            }
-
-        }
-    }
+    long long raio = abs(radius);
+    contaRecorte(xcenter - raio, xcenter + raio, ycenter - raio, ycenter + raio, zcenter - raio, zcenter + raio);
+    aplicaPrimitiva(Primitiva::esfera(xcenter, ycenter, zcenter, radius, nx, nz), false);
 }
 
 //Ativa todos os voxels que satisfazem à equação do elipsóide e atribui aos mesmos a cor atual de desenho
 void Sculptor::putEllipsoid(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz){
-    double dist;
-
-    if (rx ==0){
-        for (int k=0;k<nz;k++) {
-            for (int j=0;j<ny;j++) {
-                dist =  pow(j-ycenter,2)/pow(ry,2) + pow(k-zcenter,2)/pow(rz,2);
-                if(dist<=1){
-                    putVoxel(xcenter,j,k);
-              }
-            }
-        }
+    contaRecorte(xcenter - (long long)abs(rx), xcenter + (long long)abs(rx), ycenter - (long long)abs(ry),
+                 ycenter + (long long)abs(ry), zcenter - (long long)abs(rz), zcenter + (long long)abs(rz));
+    aplicaPrimitiva(Primitiva::elipsoide(xcenter, ycenter, zcenter, rx, ry, rz, nx, ny, nz), true);
+}
+
+// Desativa todos os voxels que satisfazem à equação do elipsóide
+void Sculptor::cutEllipsoid(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz){
+    contaRecorte(xcenter - (long long)abs(rx), xcenter + (long long)abs(rx), ycenter - (long long)abs(ry),
+                 ycenter + (long long)abs(ry), zcenter - (long long)abs(rz), zcenter + (long long)abs(rz));
+    aplicaPrimitiva(Primitiva::elipsoide(xcenter, ycenter, zcenter, rx, ry, rz, nx, ny, nz), false);
+}
+
+// Ativa (ou desativa) os voxels y∈[y0,y1] da linha (z,x), recortando o intervalo aos limites do escultor
+void Sculptor::aplicaSpan(int x, int z, int y0, int y1, bool ativa){
+    y0 = max(y0, 0);
+    y1 = min(y1, ny-1);
+    if(y0 > y1){
+        return;
     }
-    else if(ry==0){
-        for (int k=0;k<nz;k++) {
-            for (int i=0;i<nx;i++) {
-                dist =  pow(i-xcenter,2)/pow(rx,2) + pow(k-zcenter,2)/pow(rz,2);
-                if(dist<=1){
-                    putVoxel(i,ycenter,k);
-              }
-            }
-        }
+    if(ativa){
+        Cor c = {r, g, b, a};
+        v->ativa(x, z, y0, y1, c);
     }
-    else if (rz==0) {
-        for (int i=0;i<nx;i++) {
-            for (int j=0;j<ny;j++) {
-                dist =  pow(i-xcenter,2)/pow(rx,2) + pow(j-ycenter,2)/pow(ry,2);
-                if(dist<=1){
-                    putVoxel(i,j,zcenter);
-              }
-            }
-        }
+    else{
+        v->desativa(x, z, y0, y1);
+    }
+}
+
+// Percorre apenas a caixa envolvente da primitiva, aplicando em cada linha (z,x) o seu intervalo em y
+void Sculptor::aplicaPrimitiva(const Primitiva &p, bool ativa){
+    if(p.forma == Primitiva::Vazia){
+        return;
+    }
+    bool automatico = iniciaPassoAutomatico();
+    if(adiado){
+        Cor c = {r, g, b, a};
+        arvore->adiciona(p, ativa, c);
     }
     else{
-    for (int k=0;k<nz;k++) {
-        for (int i=0;i<nx;i++) {
-            for (int j=0;j<ny;j++) {
-                  dist = pow(i-xcenter,2)/pow(rx,2) + pow(j-ycenter,2)/pow(ry,2) + pow(k-zcenter,2)/pow(rz,2);
-                if(dist<=1){
-                    putVoxel(i,j,k);
+        materializa(p.z0, p.z1);
+        int y0, y1;
+        p.limitesY(ny, y0, y1);
+        historico->registra(v, p.x0, p.x1, y0, y1, p.z0, p.z1);
+        paraCadaFatia(p.z0, p.z1, [&](int za, int zb){
+            for(int k=za; k<=zb; k++){
+                for(int i=p.x0; i<=p.x1; i++){
+                    int y0, y1;
+                    if(p.intervalo(k, i, y0, y1)){
+                        aplicaSpan(i, k, y0, y1, ativa);
+                    }
                 }
-
             }
-
-        }
-      }
+        });
+        marcaSujo(p.x0, p.x1, p.z0, p.z1);
+    }
+    if(automatico){
+        concluiPasso();
     }
 }
 
-// Desativa todos os voxels que satisfazem à equação do elipsóide
-void Sculptor::cutEllipsoid(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz){
-    double dist;
-
-    if (rx ==0){
-        for (int k=0;k<nz;k++) {
-            for (int j=0;j<ny;j++) {
-                dist =  pow(j-ycenter,2)/pow(ry,2) + pow(k-zcenter,2)/pow(rz,2);
-                if(dist<=1){
-                    cutVoxel(xcenter,j,k);
-              }
+// Executa as operacoes em lote: registradas na arvore, cada fatia que elas interceptam eh avaliada uma unica vez
+void Sculptor::aplicaLote(const std::vector<Operacao> &ops){
+    bool automatico = iniciaPassoAutomatico();
+    // Registra as operacoes na arvore, aplicando as mudancas de cor na ordem em que aparecem
+    int zmin = INT_MAX, zmax = INT_MIN;
+    for(size_t o=0; o<ops.size(); o++){
+        const Operacao &op = ops[o];
+        const int *p = op.p;
+        Primitiva prim;
+        switch(op.tipo){
+        case Operacao::SetColor:
+            setColor(op.cor[0], op.cor[1], op.cor[2], op.cor[3]);
+            continue;
+        case Operacao::PutVoxel:
+        case Operacao::CutVoxel:
+            if(dentroDosLimites(p[0], p[1], p[2]) == false){
+                estatisticas.escritasForaDosLimites++;
+                continue;
             }
+            prim = Primitiva::caixa(p[0], p[0], p[1], p[1], p[2], p[2], nx, ny, nz);
+            break;
+        case Operacao::PutBox:
+        case Operacao::CutBox:
+            contaRecorte(p[0], p[1], p[2], p[3], p[4], p[5]);
+            prim = Primitiva::caixa(p[0], p[1], p[2], p[3], p[4], p[5], nx, ny, nz);
+            break;
+        case Operacao::PutSphere:
+        case Operacao::CutSphere:
+        {
+            long long raio = abs(p[3]);
+            contaRecorte(p[0] - raio, p[0] + raio, p[1] - raio, p[1] + raio, p[2] - raio, p[2] + raio);
+            prim = Primitiva::esfera(p[0], p[1], p[2], p[3], nx, nz);
+            break;
         }
-    }
-    else if(ry==0){
-        for (int k=0;k<nz;k++) {
-            for (int i=0;i<nx;i++) {
-                dist =  pow(i-xcenter,2)/pow(rx,2) + pow(k-zcenter,2)/pow(rz,2);
-                if(dist<=1){
-                    cutVoxel(i,ycenter,k);
-              }
-            }
+        default:
+            contaRecorte(p[0] - (long long)abs(p[3]), p[0] + (long long)abs(p[3]), p[1] - (long long)abs(p[4]),
+                         p[1] + (long long)abs(p[4]), p[2] - (long long)abs(p[5]), p[2] + (long long)abs(p[5]));
+            prim = Primitiva::elipsoide(p[0], p[1], p[2], p[3], p[4], p[5], nx, ny, nz);
+            break;
         }
-    }
-    else if (rz==0) {
-        for (int i=0;i<nx;i++) {
-            for (int j=0;j<ny;j++) {
-                dist =  pow(i-xcenter,2)/pow(rx,2) + pow(j-ycenter,2)/pow(ry,2);
-                if(dist<=1){
-                    cutVoxel(i,j,zcenter);
-              }
-            }
+        if(prim.forma == Primitiva::Vazia || prim.x0 > prim.x1 || prim.z0 > prim.z1){
+            continue;
         }
+        bool ativa = op.tipo == Operacao::PutVoxel || op.tipo == Operacao::PutBox ||
+                     op.tipo == Operacao::PutSphere || op.tipo == Operacao::PutEllipsoid;
+        Cor c = {r, g, b, a};
+        arvore->adiciona(prim, ativa, c);
+        zmin = min(zmin, prim.z0);
+        zmax = max(zmax, prim.z1);
     }
-    else{
-    for (int k=0;k<nz;k++) {
-        for (int i=0;i<nx;i++) {
-            for (int j=0;j<ny;j++) {
-                  dist = pow(i-xcenter,2)/pow(rx,2) + pow(j-ycenter,2)/pow(ry,2) + pow(k-zcenter,2)/pow(rz,2);
-                if(dist<=1){
-                    cutVoxel(i,j,k);
-                }
+    // Fora do modo adiado a arvore esta vazia, e so as fatias dessas operacoes sao avaliadas
+    if(!adiado && zmin <= zmax){
+        materializa(zmin, zmax);
+    }
+    if(automatico){
+        concluiPasso();
+    }
+}
 
-            }
+// Liga ou desliga a avaliacao adiada; ao desligar, as operacoes pendentes sao aplicadas
+void Sculptor::setAvaliacaoAdiada(bool adiada){
+    adiado = adiada;
+    if(!adiado){
+        materializa(0, nz-1);
+    }
+}
+
+// Liga (orcamento > 0) ou desliga o historico; operacoes adiadas anteriores nao fazem parte de nenhum passo
+void Sculptor::setOrcamentoHistorico(size_t bytes){
+    concluiPasso();
+    if(bytes > 0 && !historico->ativo()){
+        avaliaPendentes();
+    }
+    historico->setOrcamento(bytes);
+}
+
+// Memoria ocupada pelos passos guardados
+size_t Sculptor::memoriaHistorico() const{
+    return historico->memoria();
+}
+
+// Abre um passo do historico (se ele estiver ligado)
+void Sculptor::iniciaPasso(){
+    if(historico->ativo()){
+        historico->inicia();
+    }
+}
 
+// Abre um passo para uma unica operacao, se o historico esta ligado e nenhum passo foi aberto
+bool Sculptor::iniciaPassoAutomatico(){
+    if(!historico->ativo() || historico->aberto()){
+        return false;
+    }
+    historico->inicia();
+    return true;
+}
+
+// Fecha o passo aberto; as operacoes adiadas sao avaliadas antes, para que o passo guarde o que elas alteram
+void Sculptor::concluiPasso(){
+    if(!historico->aberto()){
+        return;
+    }
+    avaliaPendentes();
+    historico->conclui();
+}
+
+// Avalia apenas as fatias com operacoes adiadas (as demais fatias de um arquivo .sculpt continuam pendentes)
+void Sculptor::avaliaPendentes(){
+    for(int f=0; f<(nz + PLANOS_FATIA - 1)/PLANOS_FATIA && !arvore->vazia(); f++){
+        if(arvore->pendente(f)){
+            materializa(f*PLANOS_FATIA, f*PLANOS_FATIA + PLANOS_FATIA - 1);
         }
     }
+}
+
+// Desfaz o ultimo passo
+bool Sculptor::desfaz(int &x0, int &x1, int &z0, int &z1){
+    concluiPasso();
+    if(!historico->desfaz(v, x0, x1, z0, z1)){
+        return false;
+    }
+    marcaSujo(x0, x1, z0, z1);
+    return true;
+}
+
+bool Sculptor::desfaz(){
+    int x0, x1, z0, z1;
+    return desfaz(x0, x1, z0, z1);
+}
+
+// Refaz o ultimo passo desfeito
+bool Sculptor::refaz(int &x0, int &x1, int &z0, int &z1){
+    concluiPasso();
+    if(!historico->refaz(v, x0, x1, z0, z1)){
+        return false;
     }
+    marcaSujo(x0, x1, z0, z1);
+    return true;
+}
+
+bool Sculptor::refaz(){
+    int x0, x1, z0, z1;
+    return refaz(x0, x1, z0, z1);
 }
-//grava a escultura no formato VECT no arquivo filename
-void Sculptor::writeVECT(std::string filename){
-    ofstream fout;
-    string pontos, cores;
-    int contador = 0;
 
-    otimizar();
+bool Sculptor::podeDesfazer() const{
+    return historico->podeDesfazer();
+}
+
+bool Sculptor::podeRefazer() const{
+    return historico->podeRefazer();
+}
+
+//grava a escultura no formato VECT no arquivo filename
+bool Sculptor::writeVECT(std::string filename){
     // Abrindo o arquivo
-    fout.open(filename);
+    SaidaBufferizada fout(filename);
     // Verificiando se o arquivo foi aberto corretamente
-    if (fout.is_open()){
-        cout << "Arquivo VECT aberto com sucesso" << endl;
+    if (fout.aberto()){
+        DIAGNOSTICO(Diagnostico::Info, "Arquivo VECT aberto com sucesso");
     }
     else{
-        cout << "Nao foi possivel abrir o arquivo VECT" << endl;
-        exit(0);
-    }
-    // Criando as stings com os pontos e as cores
-    pontos = "";
-    cores = "";
-    for (int k=0;k<nz;k++) {
-        for(int i=0;i<nx;i++){
-            for(int j=0;j<ny;j++){
-                if(v[k][i][j].isOn == true){
-                    stringstream ponto;
-                    ponto << k << " " << i << " " << j << endl;
-                    pontos = pontos + ponto.str();
-                    stringstream cor;
-                    cor << fixed << setprecision(1) << v[k][i][j].r << " " << v[k][i][j].g << " " << v[k][i][j].b << " " << v[k][i][j].a <<endl;
-                    cores = cores + cor.str();
-                    contador++;
-                }
-            }
-        }
+        DIAGNOSTICO(Diagnostico::Erro, "Nao foi possivel abrir o arquivo VECT " << filename);
+        return false;
     }
-    fout << "VECT"<<endl; // Linha 1
-    fout << contador << " " << contador << " " << contador << endl; // Linha 2
+    // A quantidade de voxels visiveis eh conhecida antes de percorrer a superficie
+    size_t contador = contaVisiveis();
+    // Cada fatia eh percorrida com a sua propria area de trabalho, pois pode ser formatada em outra thread
+    int palavras = v->palavrasPorLinha();
+
+    fout.texto("VECT\n"); // Linha 1
+    // Linha 2
+    fout.inteiro(contador); fout.caractere(' ');
+    fout.inteiro(contador); fout.caractere(' ');
+    fout.inteiro(contador); fout.caractere('\n');
     // Linhas 3 e 4
     for(int k=0; k<2; k++){
-        for (int i=0;i<contador;i++) {
-            fout << 1 <<" ";
+        for (size_t i=0;i<contador;i++) {
+            fout.escreve("1 ", 2);
         }
-        fout<<endl;
+        fout.caractere('\n');
     }
 
-    // Os voxels que possuem isOn == true
-    fout<<pontos;
+    // Os voxels visiveis
+    bool completo = gravaPorFatias(fout, 0.0, 0.5, [&](int f, SaidaBufferizada &saida){
+        vector<uint64_t> buffer(palavras);
+        percorreSuperficie(f*PLANOS_FATIA, f*PLANOS_FATIA + PLANOS_FATIA - 1, buffer.data(), [&](int i, int j, int k, const Cor &){
+            saida.inteiro(k); saida.caractere(' ');
+            saida.inteiro(i); saida.caractere(' ');
+            saida.inteiro(j); saida.caractere('\n');
+        });
+    });
     // As cores referentes aos voxels
-    fout << cores;
+    completo = completo && gravaPorFatias(fout, 0.5, 1.0, [&](int f, SaidaBufferizada &saida){
+        vector<uint64_t> buffer(palavras);
+        percorreSuperficie(f*PLANOS_FATIA, f*PLANOS_FATIA + PLANOS_FATIA - 1, buffer.data(), [&](int, int, int, const Cor &vox){
+            saida.real1(vox.r); saida.caractere(' ');
+            saida.real1(vox.g); saida.caractere(' ');
+            saida.real1(vox.b); saida.caractere(' ');
+            saida.real1(vox.a); saida.caractere('\n');
+        });
+    });
     // Fecha o arquivo
-    fout.close();
+    return terminaGravacao(fout, filename, "VECT", !completo);
 }
 
-//grava a escultura no formato OFF no arquivo filename
-void Sculptor::writeOFF(std::string filename){
-    ofstream fout;
-    string pontos, faces;
-    int contador;
-
-    otimizar();
-    // Definindo os pesos para desenhar os cubos
-    vector<vector<float> > pesos;
-    vector<float> v1;
-    v1 = {-0.5, 0.5, -0.5};
-    pesos.push_back(v1);
-    v1 = {-0.5, -0.5, -0.5};
-    pesos.push_back(v1);
-    v1 = {0.5,- 0.5, -0.5};
-    pesos.push_back(v1);
-    v1 = {0.5, 0.5, -0.5};
-    pesos.push_back(v1);
-    v1 = {-0.5, 0.5, 0.5};
-    pesos.push_back(v1);
-    v1 = {-0.5, -0.5, 0.5};
-    pesos.push_back(v1);
-    v1 = {0.5, -0.5, 0.5};
-    pesos.push_back(v1);
-    v1 = {0.5, 0.5, 0.5};
-    pesos.push_back(v1);
-
-    // Definindo a sequencia inicial para as faces
-    vector<vector<int> > pontos_faces;
-    vector<int> v2;
-    v2 = {0, 3, 2, 1};
-    pontos_faces.push_back(v2);
-    v2 = {4, 5, 6, 7};
-    pontos_faces.push_back(v2);
-    v2 = {0, 1, 5, 4};
-    pontos_faces.push_back(v2);
-    v2 = {0, 4, 7, 3};
-    pontos_faces.push_back(v2);
-    v2 = {3, 7, 6, 2};
-    pontos_faces.push_back(v2);
-    v2 = {1, 2, 6, 5};
-    pontos_faces.push_back(v2);
-
+// Definindo os pesos para desenhar os cubos
+static const float pesos[8][3] = {
+    {-0.5, 0.5, -0.5}, {-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, {0.5, 0.5, -0.5},
+    {-0.5, 0.5, 0.5}, {-0.5, -0.5, 0.5}, {0.5, -0.5, 0.5}, {0.5, 0.5, 0.5}
+};
+// Definindo a sequencia inicial para as faces
+static const int pontos_faces[6][4] = {
+    {0, 3, 2, 1}, {4, 5, 6, 7}, {0, 1, 5, 4}, {0, 4, 7, 3}, {3, 7, 6, 2}, {1, 2, 6, 5}
+};
 
+//grava a escultura no formato OFF no arquivo filename
+bool Sculptor::writeOFF(std::string filename, ModoMalha modo){
+    if(modo == MalhaGulosa){
+        return writeOFFMalha(filename);
+    }
     //Abre o arquivo
-    fout.open(filename);
+    SaidaBufferizada fout(filename);
     // Verifica se o arquivo foi aberto corretamente
-    if(fout.is_open()){
-        cout << "Arquivo OFF aberto com sucesso" << endl;
+    if(fout.aberto()){
+        DIAGNOSTICO(Diagnostico::Info, "Arquivo OFF aberto com sucesso");
+    }
+    else{
+        memoriaGravacao = 0;
+        DIAGNOSTICO(Diagnostico::Erro, "Nao foi possivel abrir o arquivo OFF " << filename);
+        return false;
+    }
+    // A quantidade de voxels visiveis antes de cada fatia da o indice do primeiro cubo de cada fatia
+    vector<size_t> antes;
+    contaVisiveisPorFatia(antes);
+    size_t total = antes.back();
+    int palavras = v->palavrasPorLinha();
+
+    //Configurando o arquivo OFF
+    fout.texto("OFF\n");
+    fout.inteiro(total*8); fout.caractere(' ');
+    fout.inteiro(total*6); fout.caractere(' ');
+    fout.inteiro(0); fout.caractere('\n');
+
+    // Configurando para cada voxel visivel ser representado como um cubo de aresta igual a 1
+    bool completo = gravaPorFatias(fout, 0.0, 0.5, [&](int f, SaidaBufferizada &saida){
+        vector<uint64_t> buffer(palavras);
+        percorreSuperficie(f*PLANOS_FATIA, f*PLANOS_FATIA + PLANOS_FATIA - 1, buffer.data(), [&](int i, int j, int k, const Cor &){
+            int coord[3] = {j,-i,-k};
+            for (int a=0;a<8;a++) {
+                for(int t=0;t<3;t++){
+                    saida.real1(coord[t] + pesos[a][t]);
+                    saida.caractere(' ');
+                }
+                saida.caractere('\n');
+            }
+        });
+    });
+    completo = completo && gravaPorFatias(fout, 0.5, 1.0, [&](int f, SaidaBufferizada &saida){
+        vector<uint64_t> buffer(palavras);
+        size_t contador = antes[f];
+        percorreSuperficie(f*PLANOS_FATIA, f*PLANOS_FATIA + PLANOS_FATIA - 1, buffer.data(), [&](int, int, int, const Cor &vox){
+            for (int a=0;a<6;a++) {
+                saida.escreve("4 ", 2);
+                for(int t=0;t<4;t++){
+                    saida.inteiro(contador*8 + pontos_faces[a][t]);
+                    saida.caractere(' ');
+                }
+                saida.real1(vox.r); saida.caractere(' ');
+                saida.real1(vox.g); saida.caractere(' ');
+                saida.real1(vox.b); saida.caractere(' ');
+                saida.real1(vox.a); saida.caractere('\n');
+            }
+            contador++;
+        });
+    });
+
+    //Fecha o arquivo
+    return terminaGravacao(fout, filename, "OFF", !completo);
+}
+
+// Bytes alocados pelos vetores da malha
+static size_t memoriaMalha(const Malha &malha){
+    return malha.vertices.capacity()*sizeof(float) + malha.faces.capacity()*sizeof(int) + malha.cores.capacity()*sizeof(Cor);
+}
+
+// Grava a malha gulosa no formato OFF
+bool Sculptor::writeOFFMalha(std::string filename){
+    Malha malha;
+    geraMalha(malha);
+    memoriaGravacao = memoriaMalha(malha) + SaidaBufferizada::TAMANHO_BUFFER;
+    if(!informaProgresso(0.5)){
+        memoriaGravacao = 0;
+        DIAGNOSTICO(Diagnostico::Info, "Gravacao do arquivo OFF " << filename << " cancelada");
+        return false;
+    }
+
+    SaidaBufferizada fout(filename);
+    if(fout.aberto()){
+        DIAGNOSTICO(Diagnostico::Info, "Arquivo OFF aberto com sucesso");
     }
     else{
-        cout << "Nao foi possivel abrir o arquivo OFF"<< endl;
-        exit(0);
-    }
-    // Inicializa as string
-    pontos = "";
-    faces = "";
-    contador = 0;
-    // Configurando para cada voxel ser representado como um cubo de aresta igual a 1
-    for (int k=0;k<nz;k++) {
-        for (int i=0;i<nx;i++) {
-            for(int j=0;j<ny;j++){
-                if(v[k][i][j].isOn == true){
-                    vector<int> coord;
-                    coord = {j,-i,-k};
-
-                    for (unsigned int a=0;a<8;a++) {
-                        stringstream ponto;
-                        for(unsigned int t=0;t<3;t++){
-                            ponto << fixed << setprecision(1) << coord[t] + pesos[a][t] << " ";
+        memoriaGravacao = 0;
+        DIAGNOSTICO(Diagnostico::Erro, "Nao foi possivel abrir o arquivo OFF " << filename);
+        return false;
+    }
+
+    size_t nv = malha.vertices.size()/3, nf = malha.cores.size();
+    fout.texto("OFF\n");
+    fout.inteiro(nv); fout.caractere(' ');
+    fout.inteiro(nf); fout.caractere(' ');
+    fout.inteiro(0); fout.caractere('\n');
+    for(size_t t=0; t<malha.vertices.size(); t+=3){
+        fout.real1(malha.vertices[t]); fout.caractere(' ');
+        fout.real1(malha.vertices[t+1]); fout.caractere(' ');
+        fout.real1(malha.vertices[t+2]); fout.escreve(" \n", 2);
+    }
+    bool cancelada = false;
+    for(size_t f=0; f<nf; f++){
+        if(f % FACES_PROGRESSO == 0 && !informaProgresso(0.5 + 0.5*f/nf)){
+            cancelada = true;
+            break;
+        }
+        fout.escreve("4 ", 2);
+        for(int t=0; t<4; t++){
+            fout.inteiro(malha.faces[4*f + t]);
+            fout.caractere(' ');
+        }
+        const Cor &c = malha.cores[f];
+        fout.real1(c.r); fout.caractere(' ');
+        fout.real1(c.g); fout.caractere(' ');
+        fout.real1(c.b); fout.caractere(' ');
+        fout.real1(c.a); fout.caractere('\n');
+    }
+    return terminaGravacao(fout, filename, "OFF", cancelada);
+}
+
+// Gera a malha da superficie no modo escolhido
+void Sculptor::geraMalha(Malha &malha, ModoMalha modo){
+    malha.vertices.clear();
+    malha.faces.clear();
+    malha.cores.clear();
+    if(modo == CubosPorVoxel){
+        geraMalhaCubos(malha);
+    }
+    else{
+        geraMalhaGulosa(malha);
+    }
+}
+
+// Gera um cubo (8 vertices e 6 faces, na mesma ordem do writeOFF) para cada voxel visivel
+void Sculptor::geraMalhaCubos(Malha &malha){
+    size_t visiveis = contaVisiveis();
+    malha.vertices.reserve(24*visiveis);
+    malha.faces.reserve(24*visiveis);
+    malha.cores.reserve(6*visiveis);
+    percorreSuperficie([&](int i, int j, int k, const Cor &vox){
+        int base = (int)(malha.vertices.size()/3);
+        float coord[3] = {(float)j, (float)-i, (float)-k};
+        for(int a=0; a<8; a++){
+            for(int t=0; t<3; t++){
+                malha.vertices.push_back(coord[t] + pesos[a][t]);
+            }
+        }
+        for(int f=0; f<6; f++){
+            for(int t=0; t<4; t++){
+                malha.faces.push_back(base + pontos_faces[f][t]);
+            }
+            malha.cores.push_back(vox);
+        }
+    });
+}
+
+// Converte uma componente de cor (0 a 1) para um byte
+static uint8_t componenteByte(float c){
+    if(!(c > 0.0f)){
+        return 0;
+    }
+    if(c >= 1.0f){
+        return 255;
+    }
+    return (uint8_t)lround(c*255.0f);
+}
+
+// Grava a escultura no formato PLY binario
+bool Sculptor::writePLY(std::string filename, ModoMalha modo){
+    Malha malha;
+    geraMalha(malha, modo);
+    memoriaGravacao = memoriaMalha(malha) + SaidaBufferizada::TAMANHO_BUFFER;
+    if(!informaProgresso(0.5)){
+        memoriaGravacao = 0;
+        DIAGNOSTICO(Diagnostico::Info, "Gravacao do arquivo PLY " << filename << " cancelada");
+        return false;
+    }
+
+    SaidaBufferizada fout(filename);
+    if(fout.aberto()){
+        DIAGNOSTICO(Diagnostico::Info, "Arquivo PLY aberto com sucesso");
+    }
+    else{
+        memoriaGravacao = 0;
+        DIAGNOSTICO(Diagnostico::Erro, "Nao foi possivel abrir o arquivo PLY " << filename);
+        return false;
+    }
+
+    size_t nv = malha.vertices.size()/3, nf = malha.cores.size();
+    fout.texto("ply\nformat binary_little_endian 1.0\nelement vertex ");
+    fout.inteiro(nv);
+    fout.texto("\nproperty float x\nproperty float y\nproperty float z\nelement face ");
+    fout.inteiro(nf);
+    fout.texto("\nproperty list uchar int vertex_indices\n"
+               "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n"
+               "end_header\n");
+    for(size_t t=0; t<malha.vertices.size(); t++){
+        fout.realBinario(malha.vertices[t]);
+    }
+    bool cancelada = false;
+    for(size_t f=0; f<nf; f++){
+        if(f % FACES_PROGRESSO == 0 && !informaProgresso(0.5 + 0.5*f/nf)){
+            cancelada = true;
+            break;
+        }
+        fout.caractere(4);
+        for(int t=0; t<4; t++){
+            fout.inteiroBinario((uint32_t)malha.faces[4*f + t]);
+        }
+        const Cor &c = malha.cores[f];
+        fout.caractere((char)componenteByte(c.r));
+        fout.caractere((char)componenteByte(c.g));
+        fout.caractere((char)componenteByte(c.b));
+        fout.caractere((char)componenteByte(c.a));
+    }
+    return terminaGravacao(fout, filename, "PLY", cancelada);
+}
+
+// Grava a escultura no formato STL binario
+bool Sculptor::writeSTL(std::string filename, ModoMalha modo){
+    Malha malha;
+    geraMalha(malha, modo);
+    memoriaGravacao = memoriaMalha(malha) + SaidaBufferizada::TAMANHO_BUFFER;
+    if(!informaProgresso(0.5)){
+        memoriaGravacao = 0;
+        DIAGNOSTICO(Diagnostico::Info, "Gravacao do arquivo STL " << filename << " cancelada");
+        return false;
+    }
+
+    SaidaBufferizada fout(filename);
+    if(fout.aberto()){
+        DIAGNOSTICO(Diagnostico::Info, "Arquivo STL aberto com sucesso");
+    }
+    else{
+        memoriaGravacao = 0;
+        DIAGNOSTICO(Diagnostico::Erro, "Nao foi possivel abrir o arquivo STL " << filename);
+        return false;
+    }
+
+    // Cabecalho de 80 bytes (nao pode comecar com "solid", que indica o formato texto) e numero de triangulos
+    char cabecalho[80];
+    memset(cabecalho, 0, sizeof(cabecalho));
+    strncpy(cabecalho, "Paint Escultor 3D", sizeof(cabecalho));
+    fout.escreve(cabecalho, sizeof(cabecalho));
+    size_t nf = malha.cores.size();
+    fout.inteiroBinario((uint32_t)(2*nf));
+
+    // Cada face (quadrilatero plano) vira os triangulos (0,1,2) e (0,2,3), com a mesma normal
+    static const int triangulos[2][3] = {{0, 1, 2}, {0, 2, 3}};
+    bool cancelada = false;
+    for(size_t f=0; f<nf; f++){
+        if(f % FACES_PROGRESSO == 0 && !informaProgresso(0.5 + 0.5*f/nf)){
+            cancelada = true;
+            break;
+        }
+        const float *p[4];
+        for(int t=0; t<4; t++){
+            p[t] = &malha.vertices[3*(size_t)malha.faces[4*f + t]];
+        }
+        float e1[3], e2[3], n[3];
+        for(int t=0; t<3; t++){
+            e1[t] = p[1][t] - p[0][t];
+            e2[t] = p[2][t] - p[1][t];
+        }
+        n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+        n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+        n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+        float norma = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if(norma > 0){
+            n[0] /= norma;
+            n[1] /= norma;
+            n[2] /= norma;
+        }
+        const Cor &c = malha.cores[f];
+        uint16_t atributo = (uint16_t)(0x8000 | ((componenteByte(c.r) >> 3) << 10) | ((componenteByte(c.g) >> 3) << 5)
+                                       | (componenteByte(c.b) >> 3));
+        for(int tri=0; tri<2; tri++){
+            fout.realBinario(n[0]);
+            fout.realBinario(n[1]);
+            fout.realBinario(n[2]);
+            for(int t=0; t<3; t++){
+                const float *q = p[triangulos[tri][t]];
+                fout.realBinario(q[0]);
+                fout.realBinario(q[1]);
+                fout.realBinario(q[2]);
+            }
+            fout.curtoBinario(atributo);
+        }
+    }
+    return terminaGravacao(fout, filename, "STL", cancelada);
+}
+
+// Chave de uma cor para a tabela de cores da malha (compara os bits das quatro componentes)
+struct ChaveCor{
+    uint64_t rg, ba;
+    bool operator==(const ChaveCor &o) const { return rg == o.rg && ba == o.ba; }
+};
+struct HashChaveCor{
+    size_t operator()(const ChaveCor &c) const { return std::hash<uint64_t>()(c.rg*0x9E3779B97F4A7C15ULL ^ c.ba); }
+};
+
+// Gera a malha gulosa das faces expostas.
+// Para cada um dos seis sentidos, as faces expostas de cada fatia (plano perpendicular ao eixo) sao listadas
+// na ordem de varredura (b, a); a partir de cada face ainda nao usada o retangulo cresce primeiro em a e depois em b,
+// enquanto as faces tiverem a mesma cor. O custo eh proporcional ao numero de faces expostas.
+void Sculptor::geraMalhaGulosa(Malha &malha){
+    if(nx == 0){
+        return;
+    }
+    materializa(0, nz-1);
+    int palavras = v->palavrasPorLinha();
+
+    // Copia da ocupacao, para consultar as linhas vizinhas sem depender do armazenamento
+    vector<uint64_t> ocup((size_t)nz*nx*palavras, 0);
+    for(int k=0; k<nz; k++){
+        for(int i=0; i<nx; i++){
+            if(!v->linhaVazia(i, k)){
+                uint64_t *destino = &ocup[((size_t)k*nx + i)*palavras];
+                const uint64_t *linha = v->ocupacao(i, k, destino);
+                if(linha != destino){
+                    copy(linha, linha + palavras, destino);
+                }
+            }
+        }
+    }
+    auto linha = [&](int i, int k) -> const uint64_t* { return &ocup[((size_t)k*nx + i)*palavras]; };
+
+    // Tabela de cores: a mascara de cada fatia guarda o indice da cor de cada face
+    vector<Cor> paleta;
+    unordered_map<ChaveCor, int, HashChaveCor> indiceCor;
+    auto idCor = [&](int i, int j, int k) -> int {
+        Cor c = v->cor(i, j, k);
+        ChaveCor chave;
+        uint32_t bits[4];
+        memcpy(bits, &c, sizeof(bits));
+        chave.rg = ((uint64_t)bits[0] << 32) | bits[1];
+        chave.ba = ((uint64_t)bits[2] << 32) | bits[3];
+        auto it = indiceCor.find(chave);
+        if(it != indiceCor.end()){
+            return it->second;
+        }
+        paleta.push_back(c);
+        indiceCor[chave] = (int)paleta.size() - 1;
+        return (int)paleta.size() - 1;
+    };
+
+    // Vertices compartilhados, identificados pelo canto (ci,cj,ck) da grade
+    unordered_map<uint64_t, int> indiceVertice;
+    auto vertice = [&](long long ci, long long cj, long long ck) -> int {
+        uint64_t chave = ((uint64_t)ci*(ny+1) + cj)*(nz+1) + ck;
+        auto it = indiceVertice.find(chave);
+        if(it != indiceVertice.end()){
+            return it->second;
+        }
+        int idx = (int)indiceVertice.size();
+        indiceVertice[chave] = idx;
+        malha.vertices.push_back(cj - 0.5f);
+        malha.vertices.push_back(0.5f - ci);
+        malha.vertices.push_back(0.5f - ck);
+        return idx;
+    };
+
+    int n[3] = {nx, ny, nz};
+    // Eixos (a, b) de cada fatia: para as faces em x e em z, a = y (bits contiguos da linha); para as faces em y, a = x
+    const int eixoA[3] = {1, 0, 1};
+    const int eixoB[3] = {2, 2, 0};
+
+    vector<int> mascara;
+    vector<pair<int,int> > celulas;
+    vector<vector<pair<int,int> > > baldes;
+
+    for(int eixo=0; eixo<3; eixo++){
+        int na = n[eixoA[eixo]], nb = n[eixoB[eixo]];
+        mascara.assign((size_t)na*nb, -1);
+        for(int sentido=-1; sentido<=1; sentido+=2){
+            // Normal externa nas coordenadas do arquivo: x -> -Y, y -> +X, z -> -Z
+            float normal[3] = {0, 0, 0};
+            if(eixo == 0) normal[1] = -sentido;
+            if(eixo == 1) normal[0] = sentido;
+            if(eixo == 2) normal[2] = -sentido;
+
+            // As faces em y sao distribuidas em baldes por fatia numa unica passada pelas linhas
+            if(eixo == 1){
+                baldes.assign(ny, vector<pair<int,int> >());
+                for(int k=0; k<nz; k++){
+                    for(int i=0; i<nx; i++){
+                        const uint64_t *c = linha(i, k);
+                        for(int w=0; w<palavras; w++){
+                            uint64_t vizinho;
+                            if(sentido > 0){
+                                vizinho = (c[w] >> 1) | (w+1 < palavras ? c[w+1] << 63 : 0);
+                            }
+                            else{
+                                vizinho = (c[w] << 1) | (w > 0 ? c[w-1] >> 63 : 0);
+                            }
+                            uint64_t expostas = c[w] & ~vizinho;
+                            while(expostas){
+                                int j = w*64 + primeiroBit(expostas);
+                                expostas &= expostas - 1;
+                                baldes[j].push_back(make_pair(i, k));
+                            }
                         }
-                        ponto << endl;
-                        pontos = pontos + ponto.str();
                     }
-                    for (unsigned int a=0;a<6;a++) {
-                        stringstream face;
-                        face << 4 << " ";
-                        for(unsigned int t=0;t<4;t++){
-                            face << contador*8 + pontos_faces[a][t] << " ";
+                }
+            }
+
+            for(int s=0; s<n[eixo]; s++){
+                // Lista as faces expostas da fatia s, na ordem de varredura
+                celulas.clear();
+                if(eixo == 1){
+                    celulas.swap(baldes[s]);
+                }
+                else{
+                    for(int t=0; t<nb; t++){
+                        int i = (eixo == 0) ? s : t;
+                        int k = (eixo == 0) ? t : s;
+                        const uint64_t *c = linha(i, k);
+                        const uint64_t *viz = nullptr;
+                        if(eixo == 0 && i + sentido >= 0 && i + sentido < nx){
+                            viz = linha(i + sentido, k);
+                        }
+                        if(eixo == 2 && k + sentido >= 0 && k + sentido < nz){
+                            viz = linha(i, k + sentido);
+                        }
+                        for(int w=0; w<palavras; w++){
+                            uint64_t expostas = c[w] & ~(viz ? viz[w] : 0);
+                            while(expostas){
+                                int j = w*64 + primeiroBit(expostas);
+                                expostas &= expostas - 1;
+                                celulas.push_back(make_pair(j, t));
+                            }
                         }
-                        face << fixed << setprecision(1) << v[k][i][j].r << " "<< v[k][i][j].g << " "<< v[k][i][j].b << " " << v[k][i][j].a <<endl;
-                        faces = faces + face.str();
                     }
+                }
+                for(size_t t=0; t<celulas.size(); t++){
+                    int a = celulas[t].first, b = celulas[t].second;
+                    int p[3];
+                    p[eixo] = s; p[eixoA[eixo]] = a; p[eixoB[eixo]] = b;
+                    mascara[(size_t)b*na + a] = idCor(p[0], p[1], p[2]);
+                }
 
-                    contador++;
+                // Une as faces em retangulos
+                for(size_t t=0; t<celulas.size(); t++){
+                    int a0 = celulas[t].first, b0 = celulas[t].second;
+                    int id = mascara[(size_t)b0*na + a0];
+                    if(id < 0){
+                        continue;
+                    }
+                    int w = 1;
+                    while(a0 + w < na && mascara[(size_t)b0*na + a0 + w] == id){
+                        w++;
+                    }
+                    int h = 1;
+                    while(b0 + h < nb){
+                        int *fileira = &mascara[(size_t)(b0 + h)*na + a0];
+                        int d = 0;
+                        while(d < w && fileira[d] == id){
+                            d++;
+                        }
+                        if(d < w){
+                            break;
+                        }
+                        h++;
+                    }
+                    for(int bb=b0; bb<b0+h; bb++){
+                        fill(&mascara[(size_t)bb*na + a0], &mascara[(size_t)bb*na + a0] + w, -1);
+                    }
 
+                    // Cantos do retangulo na grade de cantos, no plano da face
+                    long long cantos[4][3];
+                    int as[4] = {a0, a0 + w, a0 + w, a0};
+                    int bs[4] = {b0, b0, b0 + h, b0 + h};
+                    for(int q=0; q<4; q++){
+                        cantos[q][eixo] = s + (sentido > 0 ? 1 : 0);
+                        cantos[q][eixoA[eixo]] = as[q];
+                        cantos[q][eixoB[eixo]] = bs[q];
+                    }
+                    // Ordem dos cantos de modo que a face aponte para fora
+                    float e1[3] = {(float)(cantos[1][1] - cantos[0][1]), (float)(cantos[0][0] - cantos[1][0]), (float)(cantos[0][2] - cantos[1][2])};
+                    float e2[3] = {(float)(cantos[2][1] - cantos[1][1]), (float)(cantos[1][0] - cantos[2][0]), (float)(cantos[1][2] - cantos[2][2])};
+                    float produto = (e1[1]*e2[2] - e1[2]*e2[1])*normal[0]
+                                  + (e1[2]*e2[0] - e1[0]*e2[2])*normal[1]
+                                  + (e1[0]*e2[1] - e1[1]*e2[0])*normal[2];
+                    int ordem[4] = {0, 1, 2, 3};
+                    if(produto < 0){
+                        ordem[1] = 3;
+                        ordem[3] = 1;
+                    }
+                    for(int q=0; q<4; q++){
+                        const long long *c = cantos[ordem[q]];
+                        malha.faces.push_back(vertice(c[0], c[1], c[2]));
+                    }
+                    malha.cores.push_back(paleta[id]);
                 }
             }
+        }
+    }
+}
 
+// Grava o escultor no formato nativo .sculpt
+bool Sculptor::writeSCULPT(std::string filename){
+    materializa(0, nz-1);
+    bool cancelada = false;
+    bool gravado = ArquivoSculpt::grava(filename, v, [&](double fracao){
+        cancelada = !informaProgresso(fracao);
+        return !cancelada;
+    });
+    if(cancelada){
+        DIAGNOSTICO(Diagnostico::Info, "Gravacao do arquivo SCULPT " << filename << " cancelada");
+        return false;
+    }
+    if(!gravado){
+        DIAGNOSTICO(Diagnostico::Erro, "Nao foi possivel gravar o arquivo SCULPT " << filename);
+        return false;
+    }
+    informaProgresso(1.0);
+    DIAGNOSTICO(Diagnostico::Info, "Arquivo SCULPT gravado com sucesso");
+    return true;
+}
+
+// Abre um escultor .sculpt; apenas o cabecalho e a tabela de blocos sao lidos agora
+Sculptor* Sculptor::readSCULPT(std::string filename, VoxelStore::Layout layout, VoxelStore::Backend backend,
+                               string *erro){
+    ArquivoSculpt *arq = ArquivoSculpt::abre(filename);
+    if(arq == nullptr){
+        DIAGNOSTICO(Diagnostico::Erro, "Nao foi possivel abrir o arquivo SCULPT " << filename);
+        if(erro != nullptr){
+            *erro = "O arquivo nao existe ou nao esta no formato .sculpt";
+        }
+        return nullptr;
+    }
+    // As dimensoes do arquivo passam pelo orcamento antes de criar o escultor, que de outro modo ficaria vazio
+    string motivo;
+    if(!cabeNoOrcamento(arq->getNx(), arq->getNy(), arq->getNz(), layout, backend, &motivo)){
+        DIAGNOSTICO(Diagnostico::Erro, "Nao foi possivel abrir o arquivo SCULPT " << filename << ": " << motivo);
+        if(erro != nullptr){
+            *erro = motivo;
         }
+        delete arq;
+        return nullptr;
+    }
+    Sculptor *s = new Sculptor(arq->getNx(), arq->getNy(), arq->getNz(), layout, backend);
+    if(arq->fatias() == 0){
+        delete arq;
+        return s;
+    }
+    s->arquivo = arq;
+    s->fatiaPendente.assign(arq->fatias(), 1);
+    s->fatiasPendentes = arq->fatias();
+    return s;
+}
 
+// Decodifica as fatias pendentes que contem os planos z∈[z0,z1]
+void Sculptor::materializa(int z0, int z1){
+    const int planos = PLANOS_FATIA;
+    z0 = max(z0, 0);
+    z1 = min(z1, nz-1);
+    if(z0 > z1){
+        return;
+    }
+    if(fatiasPendentes > 0){
+        for(int f=z0/planos; f<=z1/planos; f++){
+            if(!fatiaPendente[f]){
+                continue;
+            }
+            if(!arquivo->decodificaFatia(f, v)){
+                DIAGNOSTICO(Diagnostico::Aviso, "Arquivo SCULPT corrompido: planos " << f*planos << " a "
+                            << min(f*planos + planos, nz) - 1 << " incompletos");
+            }
+            fatiaPendente[f] = 0;
+            fatiasPendentes--;
+            marcaSujo(0, nx-1, f*planos, min(f*planos + planos, nz) - 1);
+        }
+        // Com todas as fatias decodificadas o arquivo pode ser liberado
+        if(fatiasPendentes == 0){
+            delete arquivo;
+            arquivo = nullptr;
+            fatiaPendente.clear();
+        }
     }
-    //Configurando o arquivo OFF
-    fout << "OFF"<<endl;
-    fout << contador*8 << " " << contador*6 << " " << 0 <<endl;
-    fout << pontos;
-    fout << faces;
 
-    //Fecha o arquivo
-    fout.close();
+    // Operacoes adiadas: as fatias sao avaliadas em paralelo, depois de decodificadas do arquivo
+    if(arvore->vazia()){
+        return;
+    }
+    vector<int> lista;
+    for(int f=z0/planos; f<=z1/planos; f++){
+        if(arvore->pendente(f)){
+            lista.push_back(f);
+        }
+    }
+    // O passo aberto do historico guarda os blocos antes de serem alterados
+    for(size_t t=0; t<lista.size(); t++){
+        int f = lista[t], x0, x1;
+        arvore->linhasPendentes(f, x0, x1);
+        historico->registra(v, x0, x1, 0, ny-1, f*planos, min(f*planos + planos, nz) - 1);
+    }
+    vector<int> xs(2*lista.size());
+    obtemPool()->executa((int)lista.size(), [&](int t){
+        arvore->avaliaFatia(lista[t], v, xs[2*t], xs[2*t+1]);
+    });
+    for(size_t t=0; t<lista.size(); t++){
+        int f = lista[t];
+        marcaSujo(xs[2*t], xs[2*t+1], f*planos, min(f*planos + planos, nz) - 1);
+        arvore->descartaFatia(f);
+    }
+}
+
+// Retorna uma copia do voxel (x,y,z)
+Voxel Sculptor::getVoxel(int x, int y, int z){
+    if(dentroDosLimites(x, y, z) == false){
+        estatisticas.leiturasForaDosLimites++;
+        Voxel vazio = {0, 0, 0, 0, false};
+        return vazio;
+    }
+    materializa(z, z);
+    return v->voxel(x, y, z);
+}
+
+PlanoVoxels Sculptor::plano(int z){
+    materializa(z, z);
+    return PlanoVoxels(v, z);
+}
+
+const VoxelStore* Sculptor::volume(){
+    materializa(0, nz-1);
+    return v;
+}
+
+// Conta a primitiva se a sua caixa envolvente ultrapassa os limites do escultor
+void Sculptor::contaRecorte(long long x0, long long x1, long long y0, long long y1, long long z0, long long z1){
+    if(x0 < 0 || y0 < 0 || z0 < 0 || x1 >= nx || y1 >= ny || z1 >= nz){
+        estatisticas.primitivasRecortadas++;
+    }
+}
+
+void Sculptor::zeraEstatisticas(){
+    estatisticas.escritasForaDosLimites = 0;
+    estatisticas.leiturasForaDosLimites = 0;
+    estatisticas.primitivasRecortadas = 0;
 }
 
 //Funcoes Auxiliares
-// impõe o usuário de não ultrapassar os limites do voxel
+// impõe o usuário de não ultrapassar os limites do voxel (os acessos recusados sao contados por quem chama)
 bool Sculptor::dentroDosLimites(int x, int y, int z){
     if (x>=nx || y>=ny || z>=nz || x<0 || y<0 || z<0){
-       cout << "o elemento (" << x << "," << y << "," << z << ") nao pode ser acessado" << endl;
        return false;
     }
     return true;
@@ -412,30 +1285,29 @@ bool Sculptor::dentroDosLimites(int x, int y, int z){
 
 // Inicializa a matriz 3D com voxels com todos os campos iguais a zero
 void Sculptor::inicializaMatriz3D(){
-    Voxel x;
-    // Voxel Genérico
-    x.r = x.g = x.b =0;
-    x.a = 0;
-    x.isOn = false;
-
-    for(int k=0; k<nz; k++){
-        for(int i=0; i<nx; i++){
-            for (int j=0; j<ny; j++) {
-                    v[k][i][j] = x;
-            }
-        }
+    // Um escultor vazio nao tem superficie, e as fatias ainda nao lidas do arquivo deixam de ser necessarias
+    delete arquivo;
+    arquivo = nullptr;
+    fatiasPendentes = 0;
+    arvore->limpa();
+    historico->limpa();
+    v->limpa();
+    for(size_t t=0; t<linhasSujas.size(); t++){
+        linhaSuja[linhasSujas[t]] = 0;
     }
+    linhasSujas.clear();
 }
 
 
 // Imprime o conteuduo do Escultor
 void Sculptor::print_sculptor(){
+    materializa(0, nz-1);
 
     for(int k=0; k<nz; k++){
         cout << "Plano " << k << endl;
         for(int i=0; i<nx; i++){
             for (int j=0; j<ny; j++) {
-                    cout << v[k][i][j].isOn << " ";
+                    cout << v->ativo(i, j, k) << " ";
 
             }
             cout << endl;
@@ -445,73 +1317,281 @@ void Sculptor::print_sculptor(){
 
 }
 
-// Otmiza
-void Sculptor::otimizar(){
-    char ***voxels_isOn;
-    voxels_isOn = new char**[nz];
-    // Verifica se o bloco foi armazenado
-    if(voxels_isOn == nullptr){
-        exit(0);
-    }
-    // Solicita um bloco que armazena o indice as linhas dos planos
-    voxels_isOn[0] = new char*[nz*nx];
-    // Verifica se o bloco foi armazenado
-    if(voxels_isOn[0] == nullptr){
-        exit(0);
+// Marca em "ocultos" os voxels da linha c cujos seis vizinhos estao ativos.
+// Os vizinhos em y sao obtidos deslocando a propria linha um bit (com o vai-um entre palavras);
+// os vizinhos em x e z sao as linhas u, d (x-1, x+1) e f, t (z-1, z+1).
+// Como os bits alem de ny sao sempre zero, o primeiro e o ultimo voxel da linha nunca sao marcados.
+static void mascaraOcultos(const uint64_t *c, const uint64_t *u, const uint64_t *d,
+                           const uint64_t *f, const uint64_t *t, uint64_t *ocultos, int palavras){
+    for(int w=0; w<palavras; w++){
+        uint64_t esquerda = (c[w] << 1) | (w > 0 ? c[w-1] >> 63 : 0);
+        uint64_t direita = (c[w] >> 1) | (w+1 < palavras ? c[w+1] << 63 : 0);
+        ocultos[w] = c[w] & esquerda & direita & u[w] & d[w] & f[w] & t[w];
     }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
 
-    // Distribui os planos
-    for (int k=1;k<nz;k++){
-        voxels_isOn[k] = voxels_isOn[k-1] + nx;
+// Mesma mascara, processando quatro palavras por vez com AVX2
+__attribute__((target("avx2")))
+static void mascaraOcultosAVX2(const uint64_t *c, const uint64_t *u, const uint64_t *d,
+                               const uint64_t *f, const uint64_t *t, uint64_t *ocultos, int palavras){
+    if(palavras < 1){
+        return;
     }
-    // Solicita um bloco de memoria que armazena todos os voxels na matriz 3D
-    voxels_isOn[0][0] = new char[nz*nx*ny];
-    // Verifica se o bloco foi armazenado
-    if(voxels_isOn[0][0] == nullptr){
-        exit(0);
+    // A primeira palavra nao tem vizinha a esquerda
+    uint64_t direita0 = (c[0] >> 1) | (palavras > 1 ? c[1] << 63 : 0);
+    ocultos[0] = c[0] & (c[0] << 1) & direita0 & u[0] & d[0] & f[0] & t[0];
+    int w = 1;
+    for(; w+4 < palavras; w+=4){
+        __m256i atual = _mm256_loadu_si256((const __m256i*)(c + w));
+        __m256i anterior = _mm256_loadu_si256((const __m256i*)(c + w - 1));
+        __m256i proxima = _mm256_loadu_si256((const __m256i*)(c + w + 1));
+        __m256i esquerda = _mm256_or_si256(_mm256_slli_epi64(atual, 1), _mm256_srli_epi64(anterior, 63));
+        __m256i direita = _mm256_or_si256(_mm256_srli_epi64(atual, 1), _mm256_slli_epi64(proxima, 63));
+        __m256i m = _mm256_and_si256(atual, _mm256_and_si256(esquerda, direita));
+        m = _mm256_and_si256(m, _mm256_loadu_si256((const __m256i*)(u + w)));
+        m = _mm256_and_si256(m, _mm256_loadu_si256((const __m256i*)(d + w)));
+        m = _mm256_and_si256(m, _mm256_loadu_si256((const __m256i*)(f + w)));
+        m = _mm256_and_si256(m, _mm256_loadu_si256((const __m256i*)(t + w)));
+        _mm256_storeu_si256((__m256i*)(ocultos + w), m);
     }
-    //Distribui as colunas entre as linhas e os planos
-    int n = 0;
-    for (int k=0; k<nz;k++){
-        for(int i=0; i<nx;i++){
-            voxels_isOn[k][i] = voxels_isOn[0][0] + n*ny;
-            n++;
-        }
+    // Palavras restantes
+    for(; w<palavras; w++){
+        uint64_t esquerda = (c[w] << 1) | (c[w-1] >> 63);
+        uint64_t direita = (c[w] >> 1) | (w+1 < palavras ? c[w+1] << 63 : 0);
+        ocultos[w] = c[w] & esquerda & direita & u[w] & d[w] & f[w] & t[w];
     }
+}
 
+// Escolhe a versao do kernel de acordo com a CPU
+static void (*escolheMascaraOcultos())(const uint64_t*, const uint64_t*, const uint64_t*,
+                                        const uint64_t*, const uint64_t*, uint64_t*, int){
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        return mascaraOcultosAVX2;
+    }
+    return mascaraOcultos;
+}
+static void (*const kernelOcultos)(const uint64_t*, const uint64_t*, const uint64_t*,
+                                   const uint64_t*, const uint64_t*, uint64_t*, int) = escolheMascaraOcultos();
+#else
+static void (*const kernelOcultos)(const uint64_t*, const uint64_t*, const uint64_t*,
+                                   const uint64_t*, const uint64_t*, uint64_t*, int) = mascaraOcultos;
+#endif
+
+// Otmiza
+void Sculptor::otimizar(){
+    // Os voxels que sobram sao exatamente os da superficie, que continua valida depois da alteracao
+    atualizaSuperficie();
+    // Como as demais alteracoes, a remocao eh um passo do historico: ele guarda apenas os trechos das linhas
+    // que perdem voxels, para que desfazer e refazer continuem partindo do estado real
+    bool automatico = iniciaPassoAutomatico();
+    int palavras = v->palavrasPorLinha();
+    uint64_t *buffer = &rascunho[0];
+    uint64_t *bufferOcupacao = &rascunho[palavras];
     for(int k=0; k<nz; k++){
         for(int i=0; i<nx; i++){
-            for (int j=0; j<ny; j++) {
-                     voxels_isOn[k][i][j]=v[k][i][j].isOn;
-
+            if(v->linhaVazia(i, k)){
+                continue;
+            }
+            const uint64_t *mascara = v->visiveis(i, k, buffer);
+            if(historico->aberto()){
+                const uint64_t *linha = v->ocupacao(i, k, bufferOcupacao);
+                int w0 = 0, w1 = palavras - 1;
+                while(w0 <= w1 && linha[w0] == mascara[w0]) w0++;
+                while(w1 >= w0 && linha[w1] == mascara[w1]) w1--;
+                if(w0 > w1){
+                    continue;
+                }
+                historico->registra(v, i, i, w0*64, w1*64 + 63, k, k);
             }
+            v->mantemApenas(i, k, mascara);
         }
     }
-    for(int k=1; k<nz-1; k++){
-        for(int i=1; i<nx-1; i++){
-            for (int j=1; j<ny-1; j++) {
-                     char direita = voxels_isOn[k][i][j+1];
-                     char esquerda = voxels_isOn[k][i][j-1];
-                     char frente = voxels_isOn[k-1][i][j];
-                     char atras = voxels_isOn[k+1][i][j];
-                     char acima = voxels_isOn[k][i-1][j];
-                     char abaixo = voxels_isOn[k][i+1][j];
-                     if(direita == 1 && esquerda == 1 && frente == 1 && atras == 1 && acima == 1 && abaixo == 1 ){
-                         v[k][i][j].isOn = 0;
-                     }
+    if(automatico){
+        concluiPasso();
+    }
+}
 
+// Marca para recalculo as linhas vizinhas (em x e z) das linhas alteradas
+void Sculptor::marcaSujo(int x0, int x1, int z0, int z1){
+    x0 = max(x0-1, 0); z0 = max(z0-1, 0);
+    x1 = min(x1+1, nx-1); z1 = min(z1+1, nz-1);
+    for(int k=z0; k<=z1; k++){
+        for(int i=x0; i<=x1; i++){
+            int linha = k*nx + i;
+            if(!linhaSuja[linha]){
+                linhaSuja[linha] = 1;
+                linhasSujas.push_back(linha);
             }
         }
     }
+}
 
-    delete [] voxels_isOn[0][0];
-    delete [] voxels_isOn[0];
-    delete [] voxels_isOn;
+// Recalcula apenas as linhas sujas da superficie
+void Sculptor::atualizaSuperficie(){
+    materializa(0, nz-1);
+    int palavras = v->palavrasPorLinha();
+    uint64_t *buffer = &rascunho[0];
+    uint64_t *ocultos = &rascunho[5*(size_t)palavras];
+    for(size_t t=0; t<linhasSujas.size(); t++){
+        int k = linhasSujas[t] / nx;
+        int i = linhasSujas[t] % nx;
+        linhaSuja[linhasSujas[t]] = 0;
 
+        // Linhas sem nenhum voxel ativo nao tem superficie
+        if(v->linhaVazia(i, k)){
+            continue;
+        }
+        const uint64_t *linha = v->ocupacao(i, k, buffer);
+        // Nas bordas do escultor nenhum voxel fica oculto
+        if(i == 0 || i == nx-1 || k == 0 || k == nz-1){
+            v->defineVisiveis(i, k, linha);
+            continue;
+        }
+        kernelOcultos(linha,
+                      v->ocupacao(i-1, k, buffer + palavras), v->ocupacao(i+1, k, buffer + 2*palavras),
+                      v->ocupacao(i, k-1, buffer + 3*palavras), v->ocupacao(i, k+1, buffer + 4*palavras),
+                      ocultos, palavras);
+        for(int w=0; w<palavras; w++){
+            ocultos[w] = linha[w] & ~ocultos[w];
+        }
+        v->defineVisiveis(i, k, ocultos);
+    }
+    linhasSujas.clear();
+}
 
+// Bits dos voxels visiveis da linha (z,x)
+const uint64_t* Sculptor::linhaSuperficie(int x, int z, uint64_t *buffer){
+    atualizaSuperficie();
+    return v->visiveis(x, z, buffer);
 }
 
+// Verifica se o voxel (x,y,z) esta na superficie
+bool Sculptor::visivel(int x, int y, int z){
+    if(dentroDosLimites(x, y, z) == false){
+        estatisticas.leiturasForaDosLimites++;
+        return false;
+    }
+    atualizaSuperficie();
+    return (v->visiveis(x, z, &rascunho[0])[y >> 6] >> (y & 63)) & 1;
+}
 
+// Quantidade de voxels visiveis
+size_t Sculptor::contaVisiveis(){
+    atualizaSuperficie();
+    int palavras = v->palavrasPorLinha();
+    size_t total = 0;
+    for(int k=0; k<nz; k++){
+        for(int i=0; i<nx; i++){
+            if(v->linhaVazia(i, k)){
+                continue;
+            }
+            const uint64_t *bits = v->visiveis(i, k, &rascunho[0]);
+            for(int w=0; w<palavras; w++){
+                total += contaBits(bits[w]);
+            }
+        }
+    }
+    return total;
+}
 
+// Percorre os voxels visiveis na ordem [z][x][y], pulando as linhas vazias
+void Sculptor::percorreSuperficie(const std::function<void(int, int, int, const Cor&)> &f){
+    atualizaSuperficie();
+    percorreSuperficie(0, nz-1, &rascunho[0], f);
+}
 
+// Percorre os voxels visiveis dos planos z∈[z0,z1]
+void Sculptor::percorreSuperficie(int z0, int z1, uint64_t *buffer, const std::function<void(int, int, int, const Cor&)> &f){
+    int palavras = v->palavrasPorLinha();
+    z1 = min(z1, nz-1);
+    for(int k=max(z0, 0); k<=z1; k++){
+        for(int i=0; i<nx; i++){
+            if(v->linhaVazia(i, k)){
+                continue;
+            }
+            const uint64_t *bits = v->visiveis(i, k, buffer);
+            for(int w=0; w<palavras; w++){
+                uint64_t resto = bits[w];
+                while(resto){
+                    int j = w*64 + primeiroBit(resto);
+                    resto &= resto - 1;
+                    f(i, j, k, v->cor(i, j, k));
+                }
+            }
+        }
+    }
+}
+
+// Conta os visiveis de cada fatia em paralelo e acumula os totais
+void Sculptor::contaVisiveisPorFatia(std::vector<size_t> &antes){
+    atualizaSuperficie();
+    int fatias = (nz + PLANOS_FATIA - 1)/PLANOS_FATIA;
+    int palavras = v->palavrasPorLinha();
+    antes.assign(fatias + 1, 0);
+    // Na execucao serial paraCadaFatia passa todos os planos de uma vez
+    paraCadaFatia(0, nz-1, [&](int z0, int z1){
+        vector<uint64_t> buffer(palavras);
+        for(int k=z0; k<=z1; k++){
+            size_t total = 0;
+            for(int i=0; i<nx; i++){
+                if(v->linhaVazia(i, k)){
+                    continue;
+                }
+                const uint64_t *bits = v->visiveis(i, k, buffer.data());
+                for(int w=0; w<palavras; w++){
+                    total += contaBits(bits[w]);
+                }
+            }
+            antes[k/PLANOS_FATIA + 1] += total;
+        }
+    });
+    for(int f=0; f<fatias; f++){
+        antes[f+1] += antes[f];
+    }
+}
 
+// Formata as fatias em grupos de algumas por thread e grava cada grupo em ordem, assim a memoria usada
+// fica limitada ao texto de um grupo
+bool Sculptor::gravaPorFatias(SaidaBufferizada &fout, double inicio, double fim,
+                              const std::function<void(int, SaidaBufferizada&)> &formata){
+    atualizaSuperficie();
+    int fatias = (nz + PLANOS_FATIA - 1)/PLANOS_FATIA;
+    int n = getThreads();
+    memoriaGravacao = SaidaBufferizada::TAMANHO_BUFFER;
+    if(n == 1 || fatias <= 1){
+        for(int f=0; f<fatias; f++){
+            formata(f, fout);
+            if(!informaProgresso(inicio + (fim - inicio)*(f + 1)/fatias)){
+                return false;
+            }
+        }
+        return true;
+    }
+    int grupo = 2*n;
+    vector<vector<char> > textos(grupo);
+    for(int primeira=0; primeira<fatias; primeira+=grupo){
+        int quantidade = min(grupo, fatias - primeira);
+        obtemPool()->executa(quantidade, [&](int t){
+            textos[t].clear();
+            SaidaBufferizada saida(&textos[t]);
+            formata(primeira + t, saida);
+            saida.fecha();
+        });
+        size_t bytes = SaidaBufferizada::TAMANHO_BUFFER;
+        for(int t=0; t<quantidade; t++){
+            fout.escreve(textos[t].data(), textos[t].size());
+        }
+        for(size_t t=0; t<textos.size(); t++){
+            bytes += textos[t].capacity();
+        }
+        memoriaGravacao = bytes;
+        if(!informaProgresso(inicio + (fim - inicio)*(primeira + quantidade)/fatias)){
+            return false;
+        }
+    }
+    return true;
+}
@@ -3,21 +3,118 @@
 
 #include<iostream>
 #include<cstring>
+#include<vector>
+#include<functional>
+#include<atomic>
+#include<string>
+#include "voxelstore.h"
+
+class ArquivoSculpt;
+class ArvoreCSG;
+class Historico;
+class PoolTrabalho;
+class SaidaBufferizada;
+struct Primitiva;
 
 /**
- * @brief The Voxel struct:
-     * Voxels (volume elements), algo equivalente aos Pixels que comumente são usados em imagens digitais.
-     * Nos Voxels seria possível armazenar informações como cor e transparência, necessárias para idealizar os elementos de uma escultura.
-     * @param r : intensidade da cor vermelha, varia entre [0,1]
-     * @param g : intensidade da cor vermelha, varia entre [0,1]
-     * @param b : intensidade da cor vermelha, varia entre [0,1]
-     * @param a : opacidade do voxel, varia entre [0,1]
-     * @param isOn : define se o voxel esta ativo ou nao, assume como valores 0 (desativado) ou 1 (ativado)
+ * @brief The Malha struct: malha poligonal com vertices compartilhados, gerada a partir da superficie do escultor.
+ * Os vertices estao nas coordenadas usadas pelo writeOFF (o voxel (x,y,z) eh o cubo centrado em (y,-x,-z)).
+ * @param vertices : coordenadas (X,Y,Z) de cada vertice, em sequencia
+ * @param faces : quatro indices de vertices por face, no sentido anti-horario visto de fora
+ * @param cores : cor de cada face
+ */
+struct Malha{
+    std::vector<float> vertices;
+    std::vector<int> faces;
+    std::vector<Cor> cores;
+};
+
+/**
+ * @brief The Operacao struct: uma operacao de um lote executado por Sculptor::aplicaLote
+ * @param tipo : metodo do Sculptor equivalente a operacao
+ * @param p : parametros inteiros, na mesma ordem dos argumentos do metodo
+ * @param cor : componentes r, g, b e a (apenas para SetColor)
+ */
+struct Operacao{
+    enum Tipo { SetColor, PutVoxel, CutVoxel, PutBox, CutBox, PutSphere, CutSphere, PutEllipsoid, CutEllipsoid };
+    Tipo tipo;
+    int p[6];
+    float cor[4];
+
+    /**
+     * @brief primitiva : cria uma operacao de desenho (todas exceto SetColor); os parametros nao usados ficam zerados
+     */
+    static Operacao primitiva(Tipo tipo, int p0, int p1, int p2, int p3 = 0, int p4 = 0, int p5 = 0){
+        Operacao op = {tipo, {p0, p1, p2, p3, p4, p5}, {0, 0, 0, 0}};
+        return op;
+    }
+
+    /**
+     * @brief setColor : cria uma operacao que muda a cor atual
+     */
+    static Operacao setColor(float r, float g, float b, float a){
+        Operacao op = {SetColor, {0, 0, 0, 0, 0, 0}, {r, g, b, a}};
+        return op;
+    }
+};
+
+/**
+ * @brief The Estatisticas struct: contadores de eventos do escultor que nao geram mensagens, consultados com getEstatisticas()
+ * @param escritasForaDosLimites : chamadas a putVoxel/cutVoxel (inclusive em lotes) com coordenadas fora do escultor
+ * @param leiturasForaDosLimites : consultas a getVoxel/visivel com coordenadas fora do escultor
+ * @param primitivasRecortadas : caixas, esferas e elipsoides que ultrapassavam os limites e foram recortadas
+ */
+struct Estatisticas{
+    size_t escritasForaDosLimites;
+    size_t leiturasForaDosLimites;
+    size_t primitivasRecortadas;
+};
+
+/**
+ * @brief The Memoria struct: bytes alocados pelo escultor em cada estrutura, consultados com getMemoria()
+ * @param voxels : armazenamento dos voxels (a grade)
+ * @param auxiliares : areas de trabalho da superficie, operacoes adiadas e fatias de arquivo ainda nao decodificadas
+ * @param historico : passos de desfazer/refazer guardados
+ * @param gravacao : buffers da gravacao em andamento (malha, texto formatado em paralelo e buffer do arquivo);
+ * zero fora das gravacoes
  */
-struct Voxel{
-    float r,g,b; // Cores
-    float a; // Canal alpha
-    bool isOn; // Inclue ou nao
+struct Memoria{
+    size_t voxels;
+    size_t auxiliares;
+    size_t historico;
+    size_t gravacao;
+
+    size_t total() const { return voxels + auxiliares + historico + gravacao; }
+};
+
+/**
+ * @brief A classe PlanoVoxels
+ * eh uma visao somente leitura, sem copia, do plano z de um escultor, obtida com Sculptor::plano().
+ * Os voxels sao lidos diretamente do armazenamento, logo a visao so vale ate a proxima alteracao do escultor.
+ */
+class PlanoVoxels
+{
+public:
+    PlanoVoxels(const VoxelStore *_v, int _z) : v(_v), z(_z) {}
+
+    /**
+     * @brief trecho : preenche t com o maior trecho contiguo da linha x que contem a coluna y (ver Trecho)
+     */
+    void trecho(int x, int y, Trecho &t) const { v->trecho(x, z, y, t); }
+
+    /**
+     * @brief ativo, cor : estado e cor (entre 0 e 1) do voxel (x,y) do plano
+     */
+    bool ativo(int x, int y) const { return v->ativo(x, y, z); }
+    Cor cor(int x, int y) const { return v->cor(x, y, z); }
+
+    int getNx() const { return v->getNx(); }
+    int getNy() const { return v->getNy(); }
+    int getZ() const { return z; }
+
+private:
+    const VoxelStore *v;
+    int z;
 };
 
 /**
@@ -29,9 +126,9 @@ class Sculptor
 
 protected:
     /**
-     * @brief v: matriz 3D alocada dinamicamente que armazena todos os voxels
+     * @brief v: bloco contiguo alocado dinamicamente que armazena todos os voxels, indexado linearmente na ordem [z][x][y]
      */
-    Voxel ***v;
+    VoxelStore *v;
      /**
      * @brief nx: dimensao em x (numero de linhas)
      */
@@ -60,6 +157,178 @@ protected:
      * @brief a: intensidade atual da opacidade, varia entre [0,1]
      */
     float a;
+    /**
+     * @brief rascunho: area de trabalho de atualizaSuperficie(), alocada uma unica vez na construcao (seis linhas de ocupacao)
+     */
+    std::vector<uint64_t> rascunho;
+    /**
+     * @brief linhaSuja: indica, para cada linha (z,x), se a linha da superficie precisa ser recalculada
+     */
+    std::vector<char> linhaSuja;
+    /**
+     * @brief linhasSujas: lista das linhas (z*nx + x) marcadas em linhaSuja
+     */
+    std::vector<int> linhasSujas;
+
+    /**
+     * @brief arquivo: arquivo .sculpt do qual o escultor foi aberto, enquanto houver fatias ainda nao decodificadas
+     */
+    ArquivoSculpt *arquivo;
+    /**
+     * @brief fatiaPendente: indica, para cada fatia de planos do arquivo, se ela ainda nao foi decodificada
+     */
+    std::vector<char> fatiaPendente;
+    /**
+     * @brief fatiasPendentes: quantidade de fatias ainda nao decodificadas
+     */
+    int fatiasPendentes;
+
+    /**
+     * @brief arvore: operacoes de desenho ainda nao aplicadas ao armazenamento (vazia fora do modo de avaliacao adiada)
+     */
+    ArvoreCSG *arvore;
+    /**
+     * @brief adiado: indica se as operacoes de desenho sao apenas registradas na arvore (avaliacao adiada)
+     */
+    bool adiado;
+    /**
+     * @brief historico: passos de edicao que podem ser desfeitos e refeitos
+     */
+    Historico *historico;
+
+    /**
+     * @brief estatisticas: contadores de acessos fora dos limites e de primitivas recortadas
+     */
+    Estatisticas estatisticas;
+
+    /**
+     * @brief threads: numero de threads usadas pelas primitivas (0 = uma por nucleo, 1 = execucao serial)
+     */
+    int threads;
+    /**
+     * @brief pool: threads de trabalho, criadas na primeira operacao que pode ser dividida
+     */
+    PoolTrabalho *pool;
+
+    /**
+     * @brief progresso: funcao chamada pelas gravacoes com a fracao ja gravada (vazia se ninguem acompanha o progresso)
+     */
+    std::function<bool(double)> progresso;
+    /**
+     * @brief memoriaGravacao: bytes dos buffers da gravacao em andamento, lido por getMemoria() de outras threads
+     */
+    std::atomic<size_t> memoriaGravacao;
+
+    /**
+     * @brief orcamentoMemoria: limite, em bytes, da memoria alocada na criacao de cada escultor (0 = sem limite)
+     */
+    static std::atomic<size_t> orcamentoMemoria;
+
+    /**
+     * @brief Sculptor : cria o escultor sobre um armazenamento ja preenchido (usado por copia())
+     */
+    explicit Sculptor(VoxelStore *_v);
+
+    /**
+     * @brief inicializa : adota o armazenamento _v e cria as estruturas auxiliares (superficie, arvore, historico)
+     */
+    void inicializa(VoxelStore *_v);
+
+    /**
+     * @brief informaProgresso : informa a fracao (entre 0 e 1) ja gravada
+     * @return false se a gravacao deve ser cancelada
+     */
+    bool informaProgresso(double fracao);
+
+    /**
+     * @brief terminaGravacao : fecha fout; se a gravacao falhou ou foi cancelada o arquivo incompleto eh removido
+     * @param formato : nome do formato, usado nas mensagens
+     * @param cancelada : indica se a gravacao foi interrompida por informaProgresso()
+     * @return true se o arquivo foi gravado por completo
+     */
+    bool terminaGravacao(SaidaBufferizada &fout, const std::string &filename, const char *formato, bool cancelada);
+
+    /**
+     * @brief paraCadaFatia : divide os planos z∈[z0,z1] em fatias alinhadas aos blocos do armazenamento
+     * (VoxelStoreEsparso::BLOCO_Z planos) e chama f(inicio, fim) para cada fatia, em paralelo quando threads != 1.
+     * Fatias diferentes nunca alteram as mesmas linhas nem os mesmos blocos, por isso nao ha travas.
+     */
+    void paraCadaFatia(int z0, int z1, const std::function<void(int, int)> &f);
+
+    /**
+     * @brief obtemPool : retorna o pool de threads, criando-o na primeira chamada
+     */
+    PoolTrabalho* obtemPool();
+
+    /**
+     * @brief contaVisiveisPorFatia : calcula, em paralelo, quantos voxels visiveis existem antes de cada fatia de planos
+     * @param antes : antes[f] eh o total das fatias anteriores a f; antes[numero de fatias] eh o total geral
+     */
+    void contaVisiveisPorFatia(std::vector<size_t> &antes);
+
+    /**
+     * @brief gravaPorFatias : chama formata(f, saida) para cada fatia de planos f, em paralelo e cada uma com a sua saida
+     * na memoria, e grava as saidas em fout na ordem das fatias. Com uma thread formata grava diretamente em fout.
+     * O resultado eh sempre identico ao da execucao serial. O progresso vai de inicio a fim conforme as fatias sao gravadas.
+     * @return false se a gravacao foi cancelada
+     */
+    bool gravaPorFatias(SaidaBufferizada &fout, double inicio, double fim,
+                        const std::function<void(int, SaidaBufferizada&)> &formata);
+
+    /**
+     * @brief percorreSuperficie : percorre os voxels visiveis dos planos z∈[z0,z1] (a superficie ja deve estar atualizada),
+     * usando buffer como area de trabalho, o que permite percorrer fatias diferentes ao mesmo tempo
+     */
+    void percorreSuperficie(int z0, int z1, uint64_t *buffer, const std::function<void(int, int, int, const Cor&)> &f);
+
+    /**
+     * @brief materializa : decodifica as fatias pendentes do arquivo que contem os planos z∈[z0,z1] e aplica, em paralelo
+     * por fatia, as operacoes adiadas que as interceptam. Deve ser chamado antes de qualquer acesso ao armazenamento nesses planos.
+     */
+    void materializa(int z0, int z1);
+
+    /**
+     * @brief marcaSujo : marca para recalculo as linhas da superficie afetadas por uma alteracao nas linhas x∈[x0,x1], z∈[z0,z1]
+     */
+    void marcaSujo(int x0, int x1, int z0, int z1);
+
+    /**
+     * @brief aplicaSpan : ativa (com a cor atual) ou desativa os voxels y∈[y0,y1] da linha (z,x), recortados aos limites
+     */
+    void aplicaSpan(int x, int z, int y0, int y1, bool ativa);
+
+    /**
+     * @brief aplicaPrimitiva : ativa (com a cor atual) ou desativa os voxels da primitiva, percorrendo apenas a sua caixa envolvente;
+     * no modo de avaliacao adiada a primitiva eh apenas registrada na arvore
+     */
+    void aplicaPrimitiva(const Primitiva &p, bool ativa);
+
+    /**
+     * @brief iniciaPassoAutomatico : abre um passo para uma unica operacao quando o historico esta ligado e nao ha passo aberto
+     * @return true se o passo foi aberto (e deve ser fechado com concluiPasso() ao final da operacao)
+     */
+    bool iniciaPassoAutomatico();
+
+    /**
+     * @brief contaRecorte : conta a primitiva cuja caixa envolvente x∈[x0,x1], y∈[y0,y1], z∈[z0,z1] ultrapassa os limites
+     */
+    void contaRecorte(long long x0, long long x1, long long y0, long long y1, long long z0, long long z1);
+
+    /**
+     * @brief avaliaPendentes : aplica todas as operacoes adiadas, materializando apenas as fatias que elas interceptam
+     */
+    void avaliaPendentes();
+
+    /**
+     * @brief writeOFFMalha : grava no formato OFF a malha gerada por geraMalha()
+     */
+    bool writeOFFMalha(std::string filename);
+
+    /**
+     * @brief geraMalhaCubos, geraMalhaGulosa : implementacoes dos dois modos de geraMalha()
+     */
+    void geraMalhaCubos(Malha &malha);
+    void geraMalhaGulosa(Malha &malha);
 public:
 
     /**
@@ -67,14 +336,27 @@ public:
      * @param _nx : dimensao em x (numero de linhas)
      * @param _ny : dimensao em y (numer de colunas)
      * @param _nz : dimensao em z (numero de planos)
+     * @param layout : organizacao das cores na memoria (VoxelStore::AoS ou VoxelStore::SoA)
+     * @param backend : VoxelStore::Denso aloca todo o volume; VoxelStore::Esparso aloca apenas os blocos ocupados.
+     * Se o denso nao cabe no orcamento de memoria (setOrcamentoMemoria) mas o esparso cabe, o esparso eh usado;
+     * se nenhum cabe, nada eh alocado e o escultor fica vazio (0x0x0), como com dimensoes invalidas.
      */
-    Sculptor(int _nx, int _ny, int _nz);
+    Sculptor(int _nx, int _ny, int _nz, VoxelStore::Layout layout = VoxelStore::SoA,
+             VoxelStore::Backend backend = VoxelStore::Denso);
 
     /**
       * @brief ~Sculptor: Destrutor da classe Sculptor
     */
     ~Sculptor();
 
+    /**
+     * @brief copia : cria um escultor independente com os mesmos voxels, dimensoes, cor atual e numero de threads
+     * (sem o historico), que pode ser gravado em outra thread enquanto este continua sendo alterado
+     * @param erro : recebe a explicacao quando a copia nao cabe no orcamento de memoria (pode ser nulo)
+     * @return a copia, ou nullptr se este escultor mais a copia ultrapassariam o orcamento (ver setOrcamentoMemoria)
+     */
+    Sculptor* copia(std::string *erro = nullptr);
+
     /**
      * @brief setColor : Define a cor atual do desenho
      * @param r : intensidade da cor vermelha, varia entre [0,1]
@@ -162,22 +444,223 @@ public:
      */
     void cutEllipsoid(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz);
 
+    /**
+     * @brief aplicaLote : executa uma lista de operacoes com o mesmo resultado de chamar os metodos correspondentes em ordem,
+     * mas percorrendo o escultor uma unica vez: as operacoes sao registradas numa ArvoreCSG e cada fatia de planos que
+     * elas interceptam eh avaliada uma so vez (ou apenas quando necessaria, no modo de avaliacao adiada).
+     * @param ops : operacoes, na ordem em que devem ser aplicadas
+     */
+    void aplicaLote(const std::vector<Operacao> &ops);
+
     /**
      * @brief writeVECT : grava a escultura no formato VECT no arquivo filename
      * @param filename : caminho do arquivo .vect
+     * @return false se o arquivo nao pode ser gravado ou se a gravacao foi cancelada (ver setProgresso)
+     */
+    bool writeVECT(std::string filename);
+
+    /**
+     * @brief ModoMalha : forma de representar os voxels nos arquivos de malha (OFF, PLY e STL)
+     * CubosPorVoxel: 8 vertices e 6 faces para cada voxel visivel (formato original do writeOFF);
+     * MalhaGulosa: apenas as faces expostas, com faces vizinhas coplanares e da mesma cor unidas em retangulos
+     * e vertices compartilhados (mesma geometria visivel, arquivo muito menor).
      */
-    void writeVECT(std::string filename);
+    enum ModoMalha { CubosPorVoxel, MalhaGulosa };
 
     /**
      * @brief writeOFF : grava a escultura no formato OFF no arquivo filename
-     * @param filename : caminho do arquivo .vect
+     * @param filename : caminho do arquivo .off
+     * @param modo : forma de representar os voxels no arquivo
+     * @return false se o arquivo nao pode ser gravado ou se a gravacao foi cancelada (ver setProgresso)
+     */
+    bool writeOFF(std::string filename, ModoMalha modo = CubosPorVoxel);
+
+    /**
+     * @brief writePLY : grava a escultura no formato PLY binario (little endian), com a cor RGBA de cada face
+     * @param filename : caminho do arquivo .ply
+     * @param modo : forma de representar os voxels no arquivo
+     * @return false se o arquivo nao pode ser gravado ou se a gravacao foi cancelada (ver setProgresso)
+     */
+    bool writePLY(std::string filename, ModoMalha modo = MalhaGulosa);
+
+    /**
+     * @brief writeSTL : grava a escultura no formato STL binario; cada face vira dois triangulos e a cor
+     * eh gravada nos bytes de atributo (RGB de 5 bits, convencao do VisCAM/SolidView)
+     * @param filename : caminho do arquivo .stl
+     * @param modo : forma de representar os voxels no arquivo
+     * @return false se o arquivo nao pode ser gravado ou se a gravacao foi cancelada (ver setProgresso)
+     */
+    bool writeSTL(std::string filename, ModoMalha modo = MalhaGulosa);
+
+    /**
+     * @brief geraMalha : gera a malha da superficie do escultor
+     * @param malha : malha de saida (o conteudo anterior eh descartado)
+     * @param modo : CubosPorVoxel gera um cubo para cada voxel visivel; MalhaGulosa une as faces expostas vizinhas,
+     * coplanares e da mesma cor em retangulos (greedy meshing) e compartilha os vertices
+     */
+    void geraMalha(Malha &malha, ModoMalha modo = MalhaGulosa);
+
+    /**
+     * @brief writeSCULPT : grava o escultor no formato nativo .sculpt (dimensoes, ocupacao e cores, sem perda)
+     * @param filename : caminho do arquivo .sculpt
+     * @return false se o arquivo nao pode ser gravado ou se a gravacao foi cancelada (ver setProgresso)
+     */
+    bool writeSCULPT(std::string filename);
+
+    /**
+     * @brief setProgresso : define a funcao chamada durante as gravacoes (write*) com a fracao ja gravada, entre 0 e 1,
+     * sempre na thread que chamou o write. Se ela retornar false a gravacao eh interrompida, o arquivo incompleto
+     * eh removido e o write retorna false. Uma funcao vazia desliga o acompanhamento.
+     */
+    void setProgresso(const std::function<bool(double)> &f);
+
+    /**
+     * @brief readSCULPT : abre um escultor gravado por writeSCULPT. O arquivo eh mapeado na memoria e cada fatia
+     * de planos so eh decodificada quando for acessada pela primeira vez.
+     * @param filename : caminho do arquivo .sculpt
+     * @param layout, backend : organizacao do armazenamento do novo escultor
+     * @param erro : recebe a explicacao quando o arquivo nao pode ser aberto (pode ser nulo)
+     * @return o escultor aberto, ou nullptr se o arquivo nao existe, nao esta no formato .sculpt ou se as suas
+     * dimensoes nao cabem no orcamento de memoria (ver cabeNoOrcamento)
+     */
+    static Sculptor* readSCULPT(std::string filename, VoxelStore::Layout layout = VoxelStore::SoA,
+                                VoxelStore::Backend backend = VoxelStore::Esparso, std::string *erro = nullptr);
+
+    /**
+     * @brief setThreads : define quantas threads as primitivas (put/cut de caixas, esferas e elipsoides) usam.
+     * O resultado eh sempre identico ao da execucao serial.
+     * @param n : numero de threads; 0 usa uma por nucleo do processador e 1 executa tudo na thread atual
+     */
+    void setThreads(int n);
+
+    /**
+     * @brief setAvaliacaoAdiada : liga ou desliga a avaliacao adiada. Com ela ligada os metodos put/cut (e aplicaLote) apenas
+     * registram as operacoes numa ArvoreCSG, e os voxels so sao calculados quando necessarios: ao consultar um voxel
+     * (getVoxel) apenas a sua fatia de planos eh avaliada; exportar ou atualizar a superficie avalia todo o escultor.
+     * Ao desligar, todas as operacoes pendentes sao aplicadas.
+     */
+    void setAvaliacaoAdiada(bool adiada);
+
+    /**
+     * @brief getAvaliacaoAdiada : indica se a avaliacao adiada esta ligada
+     */
+    bool getAvaliacaoAdiada() const { return adiado; }
+
+    /**
+     * @brief setOrcamentoHistorico : liga o historico de desfazer/refazer, limitando a memoria dos passos guardados
+     * (os passos mais antigos sao descartados quando ela eh ultrapassada), ou desliga-o com 0 (padrao).
+     * Com o historico ligado, cada put/cut/aplicaLote eh um passo, a menos que esteja entre iniciaPasso() e concluiPasso().
+     * Cada passo guarda apenas os blocos de voxels que alterou, comprimidos (veja Historico).
+     * @param bytes : orcamento em bytes
+     */
+    void setOrcamentoHistorico(size_t bytes);
+
+    /**
+     * @brief memoriaHistorico : bytes ocupados pelos passos guardados
+     */
+    size_t memoriaHistorico() const;
+
+    /**
+     * @brief getMemoria : bytes alocados no momento por cada estrutura do escultor
+     */
+    Memoria getMemoria() const;
+
+    /**
+     * @brief setOrcamentoMemoria : limita a memoria alocada na criacao de cada escultor a partir de agora (0 = sem limite).
+     * O valor inicial vem da variavel de ambiente SCULPTOR_ORCAMENTO_MEMORIA (em MiB); sem ela nao ha limite.
+     * No esparso o orcamento vale apenas para a criacao: os blocos alocados ao desenhar nao sao limitados.
      */
-    void writeOFF(std::string filename);
+    static void setOrcamentoMemoria(size_t bytes);
+    static size_t getOrcamentoMemoria();
+
+    /**
+     * @brief memoriaProjetada : bytes que o construtor alocaria com esses parametros, calculados sem alocar nada
+     */
+    static size_t memoriaProjetada(int _nx, int _ny, int _nz, VoxelStore::Layout layout = VoxelStore::SoA,
+                                   VoxelStore::Backend backend = VoxelStore::Denso);
+
+    /**
+     * @brief cabeNoOrcamento : verifica, antes de criar o escultor, se ele cabe no orcamento de memoria.
+     * Se o backend pedido eh o denso e so o esparso cabe, backend passa a ser VoxelStore::Esparso.
+     * @param erro : recebe a explicacao quando o escultor nao cabe (pode ser nulo)
+     * @return false se o escultor nao cabe no orcamento com nenhum backend permitido
+     */
+    static bool cabeNoOrcamento(int _nx, int _ny, int _nz, VoxelStore::Layout layout, VoxelStore::Backend &backend,
+                                std::string *erro = nullptr);
+
+    /**
+     * @brief iniciaPasso : agrupa as operacoes seguintes, ate concluiPasso(), em um unico passo do historico
+     */
+    void iniciaPasso();
+
+    /**
+     * @brief concluiPasso : fecha o passo aberto por iniciaPasso(); no modo de avaliacao adiada as operacoes do passo
+     * sao avaliadas neste momento
+     */
+    void concluiPasso();
+
+    /**
+     * @brief desfaz : desfaz o ultimo passo, em tempo proporcional ao numero de blocos que ele alterou
+     * @param x0, x1, z0, z1 : recebem as linhas (z,x) que podem ter mudado
+     * @return false se nao ha passo a desfazer
+     */
+    bool desfaz(int &x0, int &x1, int &z0, int &z1);
+    bool desfaz();
+
+    /**
+     * @brief refaz : refaz o ultimo passo desfeito
+     * @param x0, x1, z0, z1 : recebem as linhas (z,x) que podem ter mudado
+     * @return false se nao ha passo a refazer
+     */
+    bool refaz(int &x0, int &x1, int &z0, int &z1);
+    bool refaz();
+
+    bool podeDesfazer() const;
+    bool podeRefazer() const;
+
+    /**
+     * @brief getThreads : numero de threads efetivamente usadas pelas primitivas
+     */
+    int getThreads() const;
+
+    /**
+     * @brief getNx, getNy, getNz : dimensoes do escultor
+     */
+    int getNx() const { return nx; }
+    int getNy() const { return ny; }
+    int getNz() const { return nz; }
+
+    /**
+     * @brief getVoxel : retorna uma copia do voxel (x,y,z)
+     */
+    Voxel getVoxel(int x, int y, int z);
+
+    /**
+     * @brief plano : retorna uma visao, sem copia, do plano z∈[0,nz) (materializado antes, se houver operacoes adiadas)
+     */
+    PlanoVoxels plano(int z);
+
+    /**
+     * @brief volume : acesso somente leitura a todo o armazenamento (materializado antes, se houver operacoes adiadas
+     * ou fatias de arquivo pendentes); vale ate a proxima alteracao do escultor
+     */
+    const VoxelStore* volume();
+
+    /**
+     * @brief getEstatisticas : contadores de acessos fora dos limites e de primitivas recortadas desde a criacao
+     * (ou desde zeraEstatisticas()); os acessos sao apenas contados, sem escrever mensagens
+     */
+    const Estatisticas& getEstatisticas() const { return estatisticas; }
+
+    /**
+     * @brief zeraEstatisticas : zera os contadores de getEstatisticas()
+     */
+    void zeraEstatisticas();
 
     // Funções auxiliares
 
     /**
-     * @brief verLimites: verifica se o voxel esta dentro dos limites do escultor
+     * @brief dentroDosLimites: verifica se o voxel esta dentro dos limites do escultor (sem escrever mensagens nem contar)
      * @param x : coordenada em relacao ao eixo x
      * @param y : coordenada em relacao ao eixo y
      * @param z : coordenada em relacao ao eixo z
@@ -195,10 +678,41 @@ public:
     void print_sculptor();
     /**
      * @brief otimizar : Verifica quais voxels estão completamente rodeados por outros voxels e assinala isOn = false,
-     * para otimizar a visualização e o desempenho
+     * para otimizar a visualização e o desempenho. Os metodos de gravacao nao precisam mais dele, pois usam a superficie.
      */
     void otimizar();
 
+    // Extracao da superficie (nao altera o escultor)
+
+    /**
+     * @brief atualizaSuperficie : recalcula as linhas da superficie alteradas desde a ultima chamada.
+     * O custo eh proporcional ao tamanho das alteracoes, e nao ao volume do escultor.
+     */
+    void atualizaSuperficie();
+
+    /**
+     * @brief linhaSuperficie : retorna os bits dos voxels visiveis da linha (z,x), no mesmo formato de VoxelStore::ocupacao
+     * @param x : coordenada em relacao ao eixo x
+     * @param z : coordenada em relacao ao eixo z
+     * @param buffer : area com palavrasPorLinha() palavras, usada quando a linha nao esta guardada de forma contigua
+     */
+    const uint64_t* linhaSuperficie(int x, int z, uint64_t *buffer);
+
+    /**
+     * @brief visivel : verifica se o voxel (x,y,z) esta ativo e possui pelo menos um vizinho desativado
+     */
+    bool visivel(int x, int y, int z);
+
+    /**
+     * @brief contaVisiveis : retorna a quantidade de voxels visiveis
+     */
+    size_t contaVisiveis();
+
+    /**
+     * @brief percorreSuperficie : chama f(x,y,z,cor) para cada voxel visivel, na ordem [z][x][y]
+     */
+    void percorreSuperficie(const std::function<void(int, int, int, const Cor&)> &f);
+
 
 };
 
@@ -0,0 +1,442 @@
+#include "referencia.h"
+#include "sculptor.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Verificacao diferencial do escultor: gera sequencias aleatorias de operacoes (incluindo raios zero ou negativos,
+// centros e caixas fora dos limites, gravacoes no meio da sequencia e otimizar), aplica cada uma ao Sculptor e ao
+// EscultorReferencia e compara os voxels ativos, as suas cores e os bytes de writeOFF/writeVECT. Quando um caso
+// falha, ele eh reduzido (menos passos, dimensoes menores, parametros mais proximos de zero, configuracao mais simples)
+// ate uma reproducao minima, impressa como chamadas ao Sculptor.
+
+// Um passo da sequencia
+struct Passo{
+    enum Tipo { Desenho, Otimizar, Grava };
+    Tipo tipo;
+    float cor[4];      // cor usada pelo Desenho
+    Operacao op;       // primitiva do Desenho
+};
+
+// Configuracao do escultor verificado
+struct Configuracao{
+    VoxelStore::Backend backend;
+    VoxelStore::Layout layout;
+    enum Modo { Direto, Lote, Adiado };
+    Modo modo;          // chamadas diretas, aplicaLote ou avaliacao adiada
+    int threads;
+};
+
+struct Caso{
+    int nx, ny, nz;
+    Configuracao configuracao;
+    vector<Passo> passos;
+};
+
+static const char *nomesPrimitivas[] = {"setColor", "putVoxel", "cutVoxel", "putBox", "cutBox", "putSphere", "cutSphere",
+                                       "putEllipsoid", "cutEllipsoid"};
+
+// Numero de parametros inteiros de cada primitiva
+static int parametros(Operacao::Tipo tipo){
+    switch(tipo){
+    case Operacao::PutVoxel: case Operacao::CutVoxel: return 3;
+    case Operacao::PutSphere: case Operacao::CutSphere: return 4;
+    case Operacao::SetColor: return 0;
+    default: return 6;
+    }
+}
+
+// Caso aleatorio; a mesma semente sempre gera o mesmo caso
+static Caso geraCaso(unsigned semente){
+    mt19937 rng(semente);
+    auto sorteia = [&](int a, int b){ return uniform_int_distribution<int>(a, b)(rng); };
+    Caso c;
+    c.nx = sorteia(1, 20);
+    // Algumas linhas longas, com varias palavras de ocupacao e varios blocos do armazenamento esparso
+    c.ny = sorteia(0, 3) == 0 ? sorteia(200, 700) : sorteia(1, 70);
+    c.nz = sorteia(1, 20);
+    c.configuracao.backend = sorteia(0, 1) ? VoxelStore::Esparso : VoxelStore::Denso;
+    c.configuracao.layout = sorteia(0, 1) ? VoxelStore::SoA : VoxelStore::AoS;
+    c.configuracao.modo = (Configuracao::Modo)sorteia(0, 2);
+    c.configuracao.threads = sorteia(0, 1) ? 4 : 1;
+
+    // Poucos valores por componente, para que cores iguais e diferentes se alternem entre os voxels vizinhos
+    static const float paleta[4] = {0.0f, 0.25f, 0.55f, 1.0f};
+    int n = sorteia(1, 25);
+    for(int t=0; t<n; t++){
+        Passo p;
+        int sorteio = sorteia(0, 9);
+        p.tipo = sorteio == 8 ? Passo::Grava : (sorteio == 9 ? Passo::Otimizar : Passo::Desenho);
+        p.cor[0] = paleta[sorteia(0, 3)];
+        p.cor[1] = sorteia(0, 100)/100.0f;
+        p.cor[2] = paleta[sorteia(0, 3)];
+        p.cor[3] = sorteia(0, 10)/10.0f;
+        int x0 = sorteia(-3, c.nx+2), y0 = sorteia(-3, c.ny+2), z0 = sorteia(-3, c.nz+2);
+        int x1 = sorteia(-3, c.nx+2), y1 = sorteia(-3, c.ny+2), z1 = sorteia(-3, c.nz+2);
+        int raio = sorteia(-2, 12), rx = sorteia(0, 8), ry = sorteia(0, 8), rz = sorteia(0, 8);
+        Operacao::Tipo tipo = (Operacao::Tipo)(Operacao::PutVoxel + (sorteio < 8 ? sorteio : 0));
+        switch(tipo){
+        case Operacao::PutVoxel: case Operacao::CutVoxel:
+            p.op = Operacao::primitiva(tipo, x0, y0, z0); break;
+        case Operacao::PutBox: case Operacao::CutBox:
+            p.op = Operacao::primitiva(tipo, x0, x1, y0, y1, z0, z1); break;
+        case Operacao::PutSphere: case Operacao::CutSphere:
+            p.op = Operacao::primitiva(tipo, x0, y0, z0, raio); break;
+        default:
+            p.op = Operacao::primitiva(tipo, x0, y0, z0, rx, ry, rz); break;
+        }
+        c.passos.push_back(p);
+    }
+    return c;
+}
+
+static void aplicaReferencia(EscultorReferencia &r, const Passo &p){
+    const int *q = p.op.p;
+    r.setColor(p.cor[0], p.cor[1], p.cor[2], p.cor[3]);
+    switch(p.op.tipo){
+    case Operacao::PutVoxel: r.putVoxel(q[0], q[1], q[2]); break;
+    case Operacao::CutVoxel: r.cutVoxel(q[0], q[1], q[2]); break;
+    case Operacao::PutBox: r.putBox(q[0], q[1], q[2], q[3], q[4], q[5]); break;
+    case Operacao::CutBox: r.cutBox(q[0], q[1], q[2], q[3], q[4], q[5]); break;
+    case Operacao::PutSphere: r.putSphere(q[0], q[1], q[2], q[3]); break;
+    case Operacao::CutSphere: r.cutSphere(q[0], q[1], q[2], q[3]); break;
+    case Operacao::PutEllipsoid: r.putEllipsoid(q[0], q[1], q[2], q[3], q[4], q[5]); break;
+    case Operacao::CutEllipsoid: r.cutEllipsoid(q[0], q[1], q[2], q[3], q[4], q[5]); break;
+    default: break;
+    }
+}
+
+static void aplicaSculptor(Sculptor &s, const Passo &p){
+    const int *q = p.op.p;
+    s.setColor(p.cor[0], p.cor[1], p.cor[2], p.cor[3]);
+    switch(p.op.tipo){
+    case Operacao::PutVoxel: s.putVoxel(q[0], q[1], q[2]); break;
+    case Operacao::CutVoxel: s.cutVoxel(q[0], q[1], q[2]); break;
+    case Operacao::PutBox: s.putBox(q[0], q[1], q[2], q[3], q[4], q[5]); break;
+    case Operacao::CutBox: s.cutBox(q[0], q[1], q[2], q[3], q[4], q[5]); break;
+    case Operacao::PutSphere: s.putSphere(q[0], q[1], q[2], q[3]); break;
+    case Operacao::CutSphere: s.cutSphere(q[0], q[1], q[2], q[3]); break;
+    case Operacao::PutEllipsoid: s.putEllipsoid(q[0], q[1], q[2], q[3], q[4], q[5]); break;
+    case Operacao::CutEllipsoid: s.cutEllipsoid(q[0], q[1], q[2], q[3], q[4], q[5]); break;
+    default: break;
+    }
+}
+
+static string leArquivo(const string &caminho){
+    ifstream entrada(caminho.c_str(), ios::binary);
+    stringstream s;
+    s << entrada.rdbuf();
+    return s.str();
+}
+
+// Descreve a primeira diferenca entre dois textos (linha e conteudo de cada lado)
+static string primeiraDiferenca(const string &esperado, const string &obtido){
+    size_t t = 0;
+    while(t < esperado.size() && t < obtido.size() && esperado[t] == obtido[t]){
+        t++;
+    }
+    size_t inicio = esperado.rfind('\n', t == 0 ? 0 : t-1);
+    inicio = (inicio == string::npos || t == 0) ? 0 : inicio + 1;
+    int linha = 1 + (int)count(esperado.begin(), esperado.begin() + inicio, '\n');
+    auto linhaDe = [&](const string &s){
+        if(inicio >= s.size()) return string("<fim do arquivo>");
+        return s.substr(inicio, s.find('\n', inicio) - inicio);
+    };
+    ostringstream d;
+    d << "linha " << linha << ": esperado \"" << linhaDe(esperado) << "\", obtido \"" << linhaDe(obtido) << "\"";
+    return d.str();
+}
+
+// Executa o caso nos dois escultores; retorna a descricao da primeira divergencia ("" se nenhuma)
+static string executa(const Caso &c, const string &diretorio){
+    EscultorReferencia referencia(c.nx, c.ny, c.nz);
+    Sculptor sculptor(c.nx, c.ny, c.nz, c.configuracao.layout, c.configuracao.backend);
+    sculptor.setThreads(c.configuracao.threads);
+    sculptor.setAvaliacaoAdiada(c.configuracao.modo == Configuracao::Adiado);
+    vector<Operacao> lote;
+    auto aplicaLote = [&](){
+        if(!lote.empty()){
+            sculptor.aplicaLote(lote);
+            lote.clear();
+        }
+    };
+    string offSculptor = diretorio + "/sculptor.off", vectSculptor = diretorio + "/sculptor.vect";
+    string offReferencia = diretorio + "/referencia.off", vectReferencia = diretorio + "/referencia.vect";
+
+    for(size_t t=0; t<c.passos.size(); t++){
+        const Passo &p = c.passos[t];
+        if(p.tipo == Passo::Desenho){
+            aplicaReferencia(referencia, p);
+            if(c.configuracao.modo == Configuracao::Lote){
+                lote.push_back(Operacao::setColor(p.cor[0], p.cor[1], p.cor[2], p.cor[3]));
+                lote.push_back(p.op);
+            }
+            else{
+                aplicaSculptor(sculptor, p);
+            }
+        }
+        else if(p.tipo == Passo::Otimizar){
+            aplicaLote();
+            referencia.otimizar();
+            sculptor.otimizar();
+        }
+        else{
+            // As gravacoes da referencia chamam otimizar() e alteram os voxels; as do Sculptor nao podem alterar nada,
+            // o que eh conferido pela comparacao final
+            aplicaLote();
+            if(!sculptor.writeOFF(offSculptor) || !sculptor.writeVECT(vectSculptor)){
+                return "o Sculptor nao gravou os arquivos em " + diretorio;
+            }
+        }
+    }
+    aplicaLote();
+
+    const EscultorReferencia &oraculo = referencia;
+    const VoxelStore *v = sculptor.volume();
+    for(int z=0; z<c.nz; z++){
+        for(int x=0; x<c.nx; x++){
+            for(int y=0; y<c.ny; y++){
+                const Voxel &esperado = oraculo.voxel(x, y, z);
+                bool ativo = v->ativo(x, y, z);
+                Cor cor = v->cor(x, y, z);
+                if(esperado.isOn != ativo || (ativo && (esperado.r != cor.r || esperado.g != cor.g ||
+                                                        esperado.b != cor.b || esperado.a != cor.a))){
+                    ostringstream d;
+                    d << "voxel (" << x << "," << y << "," << z << "): esperado ";
+                    if(esperado.isOn) d << "ativo " << esperado.r << " " << esperado.g << " " << esperado.b << " " << esperado.a;
+                    else d << "inativo";
+                    d << ", obtido ";
+                    if(ativo) d << "ativo " << cor.r << " " << cor.g << " " << cor.b << " " << cor.a;
+                    else d << "inativo";
+                    return d.str();
+                }
+            }
+        }
+    }
+
+    if(!referencia.writeOFF(offReferencia) || !referencia.writeVECT(vectReferencia) ||
+       !sculptor.writeOFF(offSculptor) || !sculptor.writeVECT(vectSculptor)){
+        return "nao foi possivel gravar os arquivos em " + diretorio;
+    }
+    string esperado = leArquivo(offReferencia), obtido = leArquivo(offSculptor);
+    if(esperado != obtido){
+        return "writeOFF: " + primeiraDiferenca(esperado, obtido);
+    }
+    esperado = leArquivo(vectReferencia);
+    obtido = leArquivo(vectSculptor);
+    if(esperado != obtido){
+        return "writeVECT: " + primeiraDiferenca(esperado, obtido);
+    }
+    return "";
+}
+
+// Parametros das primitivas, aproximados de zero um de cada vez; mantem cada aproximacao que preserva a falha
+static bool reduzParametros(Caso &c, const string &diretorio){
+    bool reduziu = false;
+    for(size_t t=0; t<c.passos.size(); t++){
+        Passo &p = c.passos[t];
+        if(p.tipo != Passo::Desenho){
+            continue;
+        }
+        for(int k=0; k<parametros(p.op.tipo); k++){
+            int original = p.op.p[k];
+            // Primeiro zero, depois a metade, depois um passo em direcao ao zero
+            int candidatos[3] = {0, original/2, original > 0 ? original-1 : original+1};
+            for(int i=0; i<3; i++){
+                if(original == 0 || candidatos[i] == original){
+                    continue;
+                }
+                p.op.p[k] = candidatos[i];
+                if(!executa(c, diretorio).empty()){
+                    reduziu = true;
+                    break;
+                }
+                p.op.p[k] = original;
+            }
+        }
+        // Cor mais simples (branco opaco)
+        float cor[4] = {p.cor[0], p.cor[1], p.cor[2], p.cor[3]};
+        if(cor[0] != 1 || cor[1] != 1 || cor[2] != 1 || cor[3] != 1){
+            p.cor[0] = p.cor[1] = p.cor[2] = p.cor[3] = 1;
+            if(!executa(c, diretorio).empty()){
+                reduziu = true;
+            }
+            else{
+                copy(cor, cor + 4, p.cor);
+            }
+        }
+    }
+    return reduziu;
+}
+
+// Reduz o caso que falha ate que nenhuma simplificacao isolada mantenha a falha
+static Caso reduz(Caso c, const string &diretorio){
+    bool reduziu = true;
+    while(reduziu){
+        reduziu = false;
+
+        // Remove blocos de passos, dos maiores aos isolados
+        for(size_t bloco = max<size_t>(1, c.passos.size()/2); bloco >= 1; bloco /= 2){
+            for(size_t inicio = 0; inicio < c.passos.size() && c.passos.size() > 1; ){
+                Caso menor = c;
+                size_t fim = min(inicio + bloco, menor.passos.size());
+                menor.passos.erase(menor.passos.begin() + inicio, menor.passos.begin() + fim);
+                if(!menor.passos.empty() && !executa(menor, diretorio).empty()){
+                    c = menor;
+                    reduziu = true;
+                }
+                else{
+                    inicio += bloco;
+                }
+            }
+            if(bloco == 1){
+                break;
+            }
+        }
+
+        // Dimensoes menores (os parametros continuam os mesmos; o que sair dos limites eh recortado)
+        for(int eixo=0; eixo<3; eixo++){
+            int *n = eixo == 0 ? &c.nx : (eixo == 1 ? &c.ny : &c.nz);
+            while(*n > 1){
+                int original = *n;
+                *n = original/2;
+                if(executa(c, diretorio).empty()){
+                    *n = original - 1;
+                    if(original/2 == original - 1 || executa(c, diretorio).empty()){
+                        *n = original;
+                        break;
+                    }
+                }
+                reduziu = true;
+            }
+        }
+
+        if(reduzParametros(c, diretorio)){
+            reduziu = true;
+        }
+
+        // Configuracao mais simples: denso, SoA, chamadas diretas, uma thread (cada troca parte da configuracao atual)
+        for(int t=0; t<4; t++){
+            Caso outro = c;
+            Configuracao &k = outro.configuracao;
+            if(t == 0) k.backend = VoxelStore::Denso;
+            else if(t == 1) k.layout = VoxelStore::SoA;
+            else if(t == 2) k.modo = Configuracao::Direto;
+            else k.threads = 1;
+            const Configuracao &atual = c.configuracao;
+            bool igual = k.backend == atual.backend && k.layout == atual.layout && k.modo == atual.modo && k.threads == atual.threads;
+            if(!igual && !executa(outro, diretorio).empty()){
+                c = outro;
+                reduziu = true;
+            }
+        }
+    }
+    return c;
+}
+
+// Imprime o caso como chamadas ao Sculptor, prontas para reproduzir a falha
+static void imprimeReproducao(const Caso &c){
+    const Configuracao &k = c.configuracao;
+    printf("    Sculptor s(%d, %d, %d, %s, %s);\n", c.nx, c.ny, c.nz,
+           k.layout == VoxelStore::SoA ? "VoxelStore::SoA" : "VoxelStore::AoS",
+           k.backend == VoxelStore::Denso ? "VoxelStore::Denso" : "VoxelStore::Esparso");
+    printf("    s.setThreads(%d);\n", k.threads);
+    if(k.modo == Configuracao::Adiado){
+        printf("    s.setAvaliacaoAdiada(true);\n");
+    }
+    const char *prefixo = k.modo == Configuracao::Lote ? "    // em um unico aplicaLote()\n" : "";
+    for(size_t t=0; t<c.passos.size(); t++){
+        const Passo &p = c.passos[t];
+        if(p.tipo == Passo::Otimizar){
+            printf("    s.otimizar();\n");
+            prefixo = k.modo == Configuracao::Lote ? "    // em um unico aplicaLote()\n" : "";
+            continue;
+        }
+        if(p.tipo == Passo::Grava){
+            printf("    s.writeOFF(\"meio.off\");\n    s.writeVECT(\"meio.vect\");\n");
+            prefixo = k.modo == Configuracao::Lote ? "    // em um unico aplicaLote()\n" : "";
+            continue;
+        }
+        printf("%s", prefixo);
+        prefixo = "";
+        printf("    s.setColor(%g, %g, %g, %g);\n    s.%s(", p.cor[0], p.cor[1], p.cor[2], p.cor[3], nomesPrimitivas[p.op.tipo]);
+        for(int i=0; i<parametros(p.op.tipo); i++){
+            printf(i == 0 ? "%d" : ", %d", p.op.p[i]);
+        }
+        printf(");\n");
+    }
+    printf("    s.writeOFF(\"final.off\");\n    s.writeVECT(\"final.vect\");\n");
+}
+
+static void uso(const char *programa){
+    fprintf(stderr, "uso: %s [-n casos] [-s semente] [-c caso] [-d diretorio]\n"
+                    "     -n quantidade de casos aleatorios (padrao 500)\n"
+                    "     -s semente do primeiro caso (padrao 1); o caso i usa a semente s+i\n"
+                    "     -c executa apenas o caso com essa semente\n"
+                    "     -d diretorio para os arquivos temporarios (padrao /tmp)\n", programa);
+}
+
+int main(int argc, char *argv[])
+{
+    int casos = 500;
+    unsigned semente = 1;
+    bool unico = false;
+    string diretorio = "/tmp";
+    for(int t=1; t<argc; t++){
+        if(t+1 < argc && (strcmp(argv[t], "-n") == 0 || strcmp(argv[t], "-s") == 0 || strcmp(argv[t], "-c") == 0)){
+            long valor = atol(argv[t+1]);
+            if(valor < 0){
+                uso(argv[0]);
+                return 2;
+            }
+            if(argv[t][1] == 'n'){
+                casos = (int)valor;
+            }
+            else{
+                semente = (unsigned)valor;
+                unico = unico || argv[t][1] == 'c';
+            }
+            t++;
+        }
+        else if(t+1 < argc && strcmp(argv[t], "-d") == 0){
+            diretorio = argv[++t];
+        }
+        else{
+            uso(argv[0]);
+            return 2;
+        }
+    }
+    if(unico){
+        casos = 1;
+    }
+
+    int falhas = 0;
+    for(int t=0; t<casos; t++){
+        Caso c = geraCaso(semente + t);
+        string erro = executa(c, diretorio);
+        if(erro.empty()){
+            continue;
+        }
+        falhas++;
+        printf("caso %u (%dx%dx%d, %d passos): %s\n", semente + t, c.nx, c.ny, c.nz, (int)c.passos.size(), erro.c_str());
+        Caso minimo = reduz(c, diretorio);
+        printf("  reproducao minima (%s):\n", executa(minimo, diretorio).c_str());
+        imprimeReproducao(minimo);
+        fflush(stdout);
+    }
+
+    const char *temporarios[] = {"sculptor.off", "sculptor.vect", "referencia.off", "referencia.vect"};
+    for(size_t t=0; t<sizeof(temporarios)/sizeof(temporarios[0]); t++){
+        remove((diretorio + "/" + temporarios[t]).c_str());
+    }
+    printf("%d casos, %d falhas\n", casos, falhas);
+    return falhas > 0 ? 1 : 0;
+}
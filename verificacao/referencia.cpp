@@ -0,0 +1,356 @@
+#include "referencia.h"
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+// As primitivas, o otimizar e as gravacoes abaixo sao as da primeira versao do Sculptor; apenas o armazenamento
+// (um vetor em vez da matriz de ponteiros) e o tratamento de erros (sem mensagens nem exit) foram trocados.
+
+EscultorReferencia::EscultorReferencia(int _nx, int _ny, int _nz){
+    nx = _nx;
+    ny = _ny;
+    nz = _nz;
+    if (nx <= 0 || ny <= 0|| nz <= 0){
+        nx = ny = nz = 0;
+    }
+    Voxel zero = {0, 0, 0, 0, false};
+    v.assign((size_t)nx*ny*nz, zero);
+    r = g = b = a = 0;
+}
+
+// Define a cor atual do desenho
+void EscultorReferencia::setColor(float _r, float _g, float _b, float alpha){
+    r = _r;
+    g = _g;
+    b = _b;
+    a = alpha;
+}
+
+// Ativa o voxel na posição (x,y,z) (fazendo isOn = true) e atribui ao mesmo a cor atual de desenho
+void EscultorReferencia::putVoxel(int x, int y, int z){
+    if(dentroDosLimites(x, y, z) == true){ // verificando se o usuário não está acessando algum elemento da matriz que não existe
+        voxel(x,y,z).isOn = true;
+        voxel(x,y,z).r = r;
+        voxel(x,y,z).g = g;
+        voxel(x,y,z).b = b;
+        voxel(x,y,z).a = a;
+    }
+
+}
+
+//Desativa o voxel na posição (x,y,z) (fazendo isOn = false)
+void EscultorReferencia::cutVoxel(int x, int y, int z){
+    if(dentroDosLimites(x, y, z) == true){ // verificando se o usuário não está acessando algum elemento da matriz que não existe
+        voxel(x,y,z).isOn = false;
+    }
+}
+
+// Ativa todos os voxels no intervalo x∈[x0,x1], y∈[y0,y1], z∈[z0,z1] e atribui aos mesmos a cor atual de desenho
+void EscultorReferencia::putBox(int x0, int x1, int y0, int y1, int z0, int z1){
+    for (int k=z0; k<=z1; k++){
+        for (int i=x0; i<=x1; i++) {
+            for (int j=y0; j<=y1; j++) {
+                putVoxel(i,j,k);
+            }
+        }
+    }
+}
+
+// Desativa todos os voxels no intervalo x∈[x0,x1], y∈[y0,y1], z∈[z0,z1] e atribui aos mesmos a cor atual de desenho
+void EscultorReferencia::cutBox(int x0, int x1, int y0, int y1, int z0, int z1){
+    for (int k=z0; k<=z1; k++){
+        for (int i=x0; i<=x1; i++) {
+            for (int j=y0; j<=y1; j++) {
+                cutVoxel(i,j,k);
+            }
+        }
+    }
+}
+
+//Ativa todos os voxels que satisfazem à equação da esfera e atribui aos mesmos a cor atual de desenho
+void EscultorReferencia::putSphere(int xcenter, int ycenter, int zcenter, int radius){
+    double dist;
+    for(int k=0; k<nz; k++){
+        for (int i=0; i<nx; i++) {
+            for (int j=0; j<ny; j++){
+               dist = pow(i-xcenter,2) + pow(j-ycenter,2) + pow(k-zcenter,2);
+               if (dist <= pow(radius,2)){
+                   putVoxel(i,j,k);
+               }
+            }
+
+        }
+    }
+}
+
+//Desativa todos os voxels que satisfazem à equação da esfera
+void EscultorReferencia::cutSphere(int xcenter, int ycenter, int zcenter, int radius){
+    double dist;
+    for(int k=0; k<nz; k++){
+        for (int i=0; i<nx; i++) {
+            for (int j=0; j<ny; j++){
+               dist = pow(i-xcenter,2) + pow(j-ycenter,2) + pow(k-zcenter,2);
+               if (dist <= pow(radius,2)){
+                   cutVoxel(i,j,k);
+               }
+            }
+
+        }
+    }
+}
+
+//Ativa todos os voxels que satisfazem à equação do elipsóide e atribui aos mesmos a cor atual de desenho
+void EscultorReferencia::putEllipsoid(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz){
+    double dist;
+
+    if (rx ==0){
+        for (int k=0;k<nz;k++) {
+            for (int j=0;j<ny;j++) {
+                dist =  pow(j-ycenter,2)/pow(ry,2) + pow(k-zcenter,2)/pow(rz,2);
+                if(dist<=1){
+                    putVoxel(xcenter,j,k);
+              }
+            }
+        }
+    }
+    else if(ry==0){
+        for (int k=0;k<nz;k++) {
+            for (int i=0;i<nx;i++) {
+                dist =  pow(i-xcenter,2)/pow(rx,2) + pow(k-zcenter,2)/pow(rz,2);
+                if(dist<=1){
+                    putVoxel(i,ycenter,k);
+              }
+            }
+        }
+    }
+    else if (rz==0) {
+        for (int i=0;i<nx;i++) {
+            for (int j=0;j<ny;j++) {
+                dist =  pow(i-xcenter,2)/pow(rx,2) + pow(j-ycenter,2)/pow(ry,2);
+                if(dist<=1){
+                    putVoxel(i,j,zcenter);
+              }
+            }
+        }
+    }
+    else{
+    for (int k=0;k<nz;k++) {
+        for (int i=0;i<nx;i++) {
+            for (int j=0;j<ny;j++) {
+                  dist = pow(i-xcenter,2)/pow(rx,2) + pow(j-ycenter,2)/pow(ry,2) + pow(k-zcenter,2)/pow(rz,2);
+                if(dist<=1){
+                    putVoxel(i,j,k);
+                }
+
+            }
+
+        }
+      }
+    }
+}
+
+// Desativa todos os voxels que satisfazem à equação do elipsóide
+void EscultorReferencia::cutEllipsoid(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz){
+    double dist;
+
+    if (rx ==0){
+        for (int k=0;k<nz;k++) {
+            for (int j=0;j<ny;j++) {
+                dist =  pow(j-ycenter,2)/pow(ry,2) + pow(k-zcenter,2)/pow(rz,2);
+                if(dist<=1){
+                    cutVoxel(xcenter,j,k);
+              }
+            }
+        }
+    }
+    else if(ry==0){
+        for (int k=0;k<nz;k++) {
+            for (int i=0;i<nx;i++) {
+                dist =  pow(i-xcenter,2)/pow(rx,2) + pow(k-zcenter,2)/pow(rz,2);
+                if(dist<=1){
+                    cutVoxel(i,ycenter,k);
+              }
+            }
+        }
+    }
+    else if (rz==0) {
+        for (int i=0;i<nx;i++) {
+            for (int j=0;j<ny;j++) {
+                dist =  pow(i-xcenter,2)/pow(rx,2) + pow(j-ycenter,2)/pow(ry,2);
+                if(dist<=1){
+                    cutVoxel(i,j,zcenter);
+              }
+            }
+        }
+    }
+    else{
+    for (int k=0;k<nz;k++) {
+        for (int i=0;i<nx;i++) {
+            for (int j=0;j<ny;j++) {
+                  dist = pow(i-xcenter,2)/pow(rx,2) + pow(j-ycenter,2)/pow(ry,2) + pow(k-zcenter,2)/pow(rz,2);
+                if(dist<=1){
+                    cutVoxel(i,j,k);
+                }
+
+            }
+
+        }
+    }
+    }
+}
+//grava a escultura no formato VECT no arquivo filename
+bool EscultorReferencia::writeVECT(const std::string &filename){
+    ofstream fout;
+    string pontos, cores;
+    int contador = 0;
+
+    otimizar();
+    // Abrindo o arquivo
+    fout.open(filename);
+    if (!fout.is_open()){
+        return false;
+    }
+    // Criando as stings com os pontos e as cores
+    pontos = "";
+    cores = "";
+    for (int k=0;k<nz;k++) {
+        for(int i=0;i<nx;i++){
+            for(int j=0;j<ny;j++){
+                if(voxel(i,j,k).isOn == true){
+                    stringstream ponto;
+                    ponto << k << " " << i << " " << j << endl;
+                    pontos += ponto.str();
+                    stringstream cor;
+                    cor << fixed << setprecision(1) << voxel(i,j,k).r << " " << voxel(i,j,k).g << " " << voxel(i,j,k).b << " " << voxel(i,j,k).a <<endl;
+                    cores += cor.str();
+                    contador++;
+                }
+            }
+        }
+    }
+    fout << "VECT"<<endl; // Linha 1
+    fout << contador << " " << contador << " " << contador << endl; // Linha 2
+    // Linhas 3 e 4
+    for(int k=0; k<2; k++){
+        for (int i=0;i<contador;i++) {
+            fout << 1 <<" ";
+        }
+        fout<<endl;
+    }
+
+    // Os voxels que possuem isOn == true
+    fout<<pontos;
+    // As cores referentes aos voxels
+    fout << cores;
+    // Fecha o arquivo
+    fout.close();
+    return true;
+}
+
+//grava a escultura no formato OFF no arquivo filename
+bool EscultorReferencia::writeOFF(const std::string &filename){
+    ofstream fout;
+    string pontos, faces;
+    int contador;
+
+    otimizar();
+    // Definindo os pesos para desenhar os cubos
+    vector<vector<float> > pesos = {
+        {-0.5, 0.5, -0.5}, {-0.5, -0.5, -0.5}, {0.5,- 0.5, -0.5}, {0.5, 0.5, -0.5},
+        {-0.5, 0.5, 0.5}, {-0.5, -0.5, 0.5}, {0.5, -0.5, 0.5}, {0.5, 0.5, 0.5}
+    };
+    // Definindo a sequencia inicial para as faces
+    vector<vector<int> > pontos_faces = {
+        {0, 3, 2, 1}, {4, 5, 6, 7}, {0, 1, 5, 4}, {0, 4, 7, 3}, {3, 7, 6, 2}, {1, 2, 6, 5}
+    };
+
+    //Abre o arquivo
+    fout.open(filename);
+    if(!fout.is_open()){
+        return false;
+    }
+    // Inicializa as string
+    pontos = "";
+    faces = "";
+    contador = 0;
+    // Configurando para cada voxel ser representado como um cubo de aresta igual a 1
+    for (int k=0;k<nz;k++) {
+        for (int i=0;i<nx;i++) {
+            for(int j=0;j<ny;j++){
+                if(voxel(i,j,k).isOn == true){
+                    vector<int> coord;
+                    coord = {j,-i,-k};
+
+                    for (unsigned int a=0;a<8;a++) {
+                        stringstream ponto;
+                        for(unsigned int t=0;t<3;t++){
+                            ponto << fixed << setprecision(1) << coord[t] + pesos[a][t] << " ";
+                        }
+                        ponto << endl;
+                        pontos += ponto.str();
+                    }
+                    for (unsigned int a=0;a<6;a++) {
+                        stringstream face;
+                        face << 4 << " ";
+                        for(unsigned int t=0;t<4;t++){
+                            face << contador*8 + pontos_faces[a][t] << " ";
+                        }
+                        face << fixed << setprecision(1) << voxel(i,j,k).r << " "<< voxel(i,j,k).g << " "<< voxel(i,j,k).b << " " << voxel(i,j,k).a <<endl;
+                        faces += face.str();
+                    }
+
+                    contador++;
+
+                }
+            }
+
+        }
+
+    }
+    //Configurando o arquivo OFF
+    fout << "OFF"<<endl;
+    fout << contador*8 << " " << contador*6 << " " << 0 <<endl;
+    fout << pontos;
+    fout << faces;
+
+    //Fecha o arquivo
+    fout.close();
+    return true;
+}
+
+// impõe o usuário de não ultrapassar os limites do voxel
+bool EscultorReferencia::dentroDosLimites(int x, int y, int z) const{
+    if (x>=nx || y>=ny || z>=nz || x<0 || y<0 || z<0){
+       return false;
+    }
+    return true;
+}
+
+// Desativa os voxels internos, comparando com uma copia da ocupacao anterior
+void EscultorReferencia::otimizar(){
+    vector<char> isOn((size_t)nx*ny*nz);
+    for(size_t t=0; t<v.size(); t++){
+        isOn[t] = v[t].isOn;
+    }
+    auto voxels_isOn = [&](int k, int i, int j) { return isOn[((size_t)k*nx + i)*ny + j]; };
+    for(int k=1; k<nz-1; k++){
+        for(int i=1; i<nx-1; i++){
+            for (int j=1; j<ny-1; j++) {
+                     char direita = voxels_isOn(k, i, j+1);
+                     char esquerda = voxels_isOn(k, i, j-1);
+                     char frente = voxels_isOn(k-1, i, j);
+                     char atras = voxels_isOn(k+1, i, j);
+                     char acima = voxels_isOn(k, i-1, j);
+                     char abaixo = voxels_isOn(k, i+1, j);
+                     if(direita == 1 && esquerda == 1 && frente == 1 && atras == 1 && acima == 1 && abaixo == 1 ){
+                         voxel(i,j,k).isOn = 0;
+                     }
+
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef REFERENCIA_H
+#define REFERENCIA_H
+
+#include <string>
+#include <vector>
+#include "voxelstore.h"
+
+/**
+ * @brief A classe EscultorReferencia
+ * guarda as implementacoes originais (sem otimizacao) das operacoes do Sculptor, usadas como oraculo pelo verificador:
+ * as primitivas percorrem todo o escultor testando a equacao de cada voxel com pow(), e writeOFF/writeVECT montam o
+ * texto com streams, exatamente como na primeira versao do projeto. Qualquer implementacao otimizada deve produzir os
+ * mesmos voxels e os mesmos bytes. Nada aqui deve ser otimizado: a lentidao eh o preco de ser obviamente correto.
+ */
+class EscultorReferencia
+{
+public:
+    /**
+     * @brief EscultorReferencia : cria o escultor com todos os voxels desativados (dimensoes nao positivas geram um escultor vazio)
+     */
+    EscultorReferencia(int _nx, int _ny, int _nz);
+
+    void setColor(float _r, float _g, float _b, float alpha);
+    void putVoxel(int x, int y, int z);
+    void cutVoxel(int x, int y, int z);
+    void putBox(int x0, int x1, int y0, int y1, int z0, int z1);
+    void cutBox(int x0, int x1, int y0, int y1, int z0, int z1);
+    void putSphere(int xcenter, int ycenter, int zcenter, int radius);
+    void cutSphere(int xcenter, int ycenter, int zcenter, int radius);
+    void putEllipsoid(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz);
+    void cutEllipsoid(int xcenter, int ycenter, int zcenter, int rx, int ry, int rz);
+
+    /**
+     * @brief otimizar : desativa os voxels cujos seis vizinhos estao ativos (os voxels das bordas nunca sao desativados)
+     */
+    void otimizar();
+
+    /**
+     * @brief writeOFF, writeVECT : gravam os voxels ativos (um cubo por voxel no OFF) depois de chamar otimizar(),
+     * como as versoes originais; por isso alteram o escultor
+     * @return false se o arquivo nao pode ser aberto
+     */
+    bool writeOFF(const std::string &filename);
+    bool writeVECT(const std::string &filename);
+
+    /**
+     * @brief voxel : retorna o voxel (x,y,z), que deve estar dentro dos limites
+     */
+    const Voxel& voxel(int x, int y, int z) const { return v[((size_t)z*nx + x)*ny + y]; }
+
+    int getNx() const { return nx; }
+    int getNy() const { return ny; }
+    int getNz() const { return nz; }
+
+private:
+    std::vector<Voxel> v;
+    int nx, ny, nz;
+    float r, g, b, a;
+
+    bool dentroDosLimites(int x, int y, int z) const;
+    Voxel& voxel(int x, int y, int z) { return v[((size_t)z*nx + x)*ny + y]; }
+};
+
+#endif // REFERENCIA_H
@@ -0,0 +1,43 @@
+#-------------------------------------------------
+#
+# Verificacao do escultor contra as implementacoes originais (referencia):
+# usa apenas o nucleo do escultor (sem Qt)
+#
+#-------------------------------------------------
+
+QT       -= core gui
+CONFIG   -= qt app_bundle
+CONFIG   += console c++11
+
+TARGET = escultor_verificacao
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+unix: LIBS += -lpthread
+
+SOURCES += \
+        main.cpp \
+        referencia.cpp \
+        ../arquivosculpt.cpp \
+        ../arvorecsg.cpp \
+        ../diagnostico.cpp \
+        ../historico.cpp \
+        ../pooltrabalho.cpp \
+        ../saidabufferizada.cpp \
+        ../sculptor.cpp \
+        ../voxelstore.cpp \
+        ../voxelstoreesparso.cpp
+
+HEADERS += \
+        referencia.h \
+        ../arquivosculpt.h \
+        ../arvorecsg.h \
+        ../diagnostico.h \
+        ../historico.h \
+        ../pooltrabalho.h \
+        ../primitiva.h \
+        ../saidabufferizada.h \
+        ../sculptor.h \
+        ../voxelstore.h \
+        ../voxelstoreesparso.h
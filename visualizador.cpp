@@ -0,0 +1,107 @@
+#include "visualizador.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QResizeEvent>
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+Visualizador::Visualizador(QWidget *parent) : QWidget(parent, Qt::Window)
+{
+    sculptor = nullptr;
+    desatualizado = true;
+    quadroValido = false;
+    // Camera inicial: de frente para o plano z = 0, levemente acima e a esquerda
+    azimute = -0.5;
+    elevacao = 0.4;
+    distancia = 1.2;
+    girando = false;
+    raycaster.setCamera(azimute, elevacao, distancia);
+    setWindowTitle("Visualizador 3D");
+    resize(640, 480);
+}
+
+void Visualizador::setEscultor(Sculptor *_sculptor)
+{
+    sculptor = _sculptor;
+    desatualizado = true;
+    quadroValido = false;
+    update();
+}
+
+void Visualizador::atualizaCamera()
+{
+    raycaster.setCamera(azimute, elevacao, distancia);
+    quadroValido = false;
+    update();
+}
+
+void Visualizador::paintEvent(QPaintEvent *event)
+{
+    (void)event;
+    QPainter painter(this);
+    if (sculptor == nullptr || sculptor->getNx() == 0){
+        painter.fillRect(rect(), QColor(60,60,60));
+        return;
+    }
+    if (desatualizado){
+        raycaster.setVolume(sculptor->volume());
+        desatualizado = false;
+    }
+    if (!quadroValido){
+        // Enquanto a camera gira a imagem tem metade da resolucao (um quarto dos raios)
+        int escala = girando ? 2 : 1;
+        quadro = QImage(max(1,width()/escala), max(1,height()/escala), QImage::Format_RGB32);
+        raycaster.renderiza(reinterpret_cast<uint32_t*>(quadro.bits()), quadro.width(), quadro.height());
+        quadroValido = true;
+    }
+    painter.drawImage(rect(), quadro);
+}
+
+void Visualizador::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton){
+        girando = true;
+        ultimoPonto = event->pos();
+    }
+}
+
+void Visualizador::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!girando){
+        return;
+    }
+    QPoint delta = event->pos() - ultimoPonto;
+    ultimoPonto = event->pos();
+    // Um arrasto pela largura da janela da uma volta completa
+    azimute += 2*M_PI*delta.x()/max(1,width());
+    elevacao = max(-1.55, min(1.55, elevacao + M_PI*delta.y()/max(1,height())));
+    atualizaCamera();
+}
+
+void Visualizador::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && girando){
+        girando = false;
+        // Quadro final com a resolucao inteira
+        quadroValido = false;
+        update();
+    }
+}
+
+void Visualizador::wheelEvent(QWheelEvent *event)
+{
+    // Cada passo da roda (120 unidades) aproxima ou afasta 10%
+    distancia *= pow(0.9, event->angleDelta().y()/120.0);
+    distancia = max(0.1, min(10.0, distancia));
+    atualizaCamera();
+}
+
+void Visualizador::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    quadroValido = false;
+}
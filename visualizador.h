@@ -0,0 +1,58 @@
+#ifndef VISUALIZADOR_H
+#define VISUALIZADOR_H
+
+#include <QWidget>
+#include <QImage>
+#include <QPoint>
+#include "raycaster.h"
+#include "sculptor.h"
+
+/**
+ * @brief The Visualizador class
+ * mostra uma vista 3D do escultor, desenhada pelo Raycaster diretamente a partir dos voxels (sem exportar malhas).
+ * Arrastar com o botao esquerdo gira a camera em torno do escultor e a roda do mouse aproxima ou afasta;
+ * enquanto a camera eh arrastada a imagem eh desenhada com metade da resolucao.
+ */
+class Visualizador : public QWidget
+{
+    Q_OBJECT
+
+private:
+    // Escultor mostrado (pertence ao Plotter)
+    Sculptor *sculptor;
+    Raycaster raycaster;
+    // Indica se o escultor mudou desde que as celulas ocupadas do raycaster foram calculadas
+    bool desatualizado;
+    // Ultima imagem desenhada e se ela ainda corresponde a camera e ao escultor
+    QImage quadro;
+    bool quadroValido;
+    // Camera: angulos em radianos e distancia em multiplos da diagonal do escultor
+    double azimute, elevacao, distancia;
+    // Posicao anterior do mouse enquanto a camera eh arrastada
+    bool girando;
+    QPoint ultimoPonto;
+
+    // Repassa a camera ao raycaster e agenda um novo quadro
+    void atualizaCamera();
+
+public:
+    /**
+     * @brief Visualizador : cria a vista em uma janela propria
+     */
+    explicit Visualizador(QWidget *parent = nullptr);
+    /**
+     * @brief setEscultor : define o escultor mostrado; deve ser chamado tambem sempre que ele for alterado
+     */
+    void setEscultor(Sculptor *_sculptor);
+    /**
+     * @brief paintEvent : desenha (se necessario) e mostra o quadro atual
+     */
+    void paintEvent(QPaintEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    void wheelEvent(QWheelEvent *event);
+    void resizeEvent(QResizeEvent *event);
+};
+
+#endif // VISUALIZADOR_H
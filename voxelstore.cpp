@@ -0,0 +1,189 @@
+#include "voxelstore.h"
+#include "voxelstoreesparso.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+// Cria o armazenamento de acordo com a estrategia escolhida
+VoxelStore* VoxelStore::cria(int _nx, int _ny, int _nz, Layout _layout, Backend backend){
+    if(backend == Esparso){
+        return new VoxelStoreEsparso(_nx, _ny, _nz, _layout);
+    }
+    return new VoxelStoreDenso(_nx, _ny, _nz, _layout);
+}
+
+// Bytes alocados pela criacao, calculados em double para que dimensoes enormes nao estourem size_t
+size_t VoxelStore::memoriaProjetada(int _nx, int _ny, int _nz, Layout, Backend backend){
+    if(_nx <= 0 || _ny <= 0 || _nz <= 0){
+        return 0;
+    }
+    // Em 64 bits: perto de INT_MAX o arredondamento para cima estouraria um int
+    double palavrasLinha = ((int64_t)_ny + 63)/64;
+    double bytes;
+    if(backend == Esparso){
+        // Apenas a tabela de ponteiros para os blocos
+        double bz = ((int64_t)_nz + VoxelStoreEsparso::BLOCO_Z - 1)/VoxelStoreEsparso::BLOCO_Z;
+        double bx = ((int64_t)_nx + VoxelStoreEsparso::BLOCO_X - 1)/VoxelStoreEsparso::BLOCO_X;
+        bytes = bz*bx*palavrasLinha*sizeof(void*);
+    }
+    else{
+        // Ocupacao e visiveis (um bit por voxel, em palavras por linha) e as quatro componentes de cor; AoS e SoA
+        // ocupam o mesmo espaco
+        bytes = 2.0*_nx*_nz*palavrasLinha*sizeof(uint64_t) + (double)_nx*_ny*_nz*sizeof(Cor);
+    }
+    if(bytes >= (double)numeric_limits<size_t>::max()){
+        return numeric_limits<size_t>::max();
+    }
+    return (size_t)bytes;
+}
+
+// Construtor da classe VoxelStore
+VoxelStore::VoxelStore(int _nx, int _ny, int _nz, Layout _layout){
+    nx = _nx;
+    ny = _ny;
+    nz = _nz;
+    layout = _layout;
+    palavras = (ny + 63)/64;
+}
+
+// Retorna uma copia do voxel (x,y,z)
+Voxel VoxelStore::voxel(int x, int y, int z) const{
+    Cor c = cor(x, y, z);
+    Voxel vox;
+    vox.r = c.r;
+    vox.g = c.g;
+    vox.b = c.b;
+    vox.a = c.a;
+    vox.isOn = ativo(x, y, z);
+    return vox;
+}
+
+// Liga (ou desliga) os bits y∈[y0,y1] da linha, uma palavra inteira por vez
+void VoxelStore::marcaBits(uint64_t *linha, int y0, int y1, bool valor){
+    int w0 = y0 >> 6, w1 = y1 >> 6;
+    for(int w=w0; w<=w1; w++){
+        uint64_t mascara = ~0ULL;
+        if(w == w0){
+            mascara &= ~0ULL << (y0 & 63);
+        }
+        if(w == w1){
+            mascara &= ~0ULL >> (63 - (y1 & 63));
+        }
+        if(valor){
+            linha[w] |= mascara;
+        }
+        else{
+            linha[w] &= ~mascara;
+        }
+    }
+}
+
+// Construtor da classe VoxelStoreDenso
+VoxelStoreDenso::VoxelStoreDenso(int _nx, int _ny, int _nz, Layout _layout) : VoxelStore(_nx, _ny, _nz, _layout){
+    size_t total = (size_t)nx*ny*nz;
+    bits.assign((size_t)nx*nz*palavras, 0);
+    superficie.assign((size_t)nx*nz*palavras, 0);
+    if(layout == AoS){
+        Cor zero = {0, 0, 0, 0};
+        aos.assign(total, zero);
+    }
+    else{
+        r.assign(total, 0.0f);
+        g.assign(total, 0.0f);
+        b.assign(total, 0.0f);
+        a.assign(total, 0.0f);
+    }
+}
+
+// Substitui a camada de visiveis da linha (z,x)
+void VoxelStoreDenso::defineVisiveis(int x, int z, const uint64_t *bitsVisiveis){
+    copy(bitsVisiveis, bitsVisiveis + palavras, &superficie[((size_t)z*nx + x)*palavras]);
+}
+
+// Desativa os voxels da linha (z,x) fora da mascara
+void VoxelStoreDenso::mantemApenas(int x, int z, const uint64_t *mascara){
+    uint64_t *linha = &bits[((size_t)z*nx + x)*palavras];
+    for(int w=0; w<palavras; w++){
+        linha[w] &= mascara[w];
+    }
+}
+
+// Retorna a cor do voxel (x,y,z)
+Cor VoxelStoreDenso::cor(int x, int y, int z) const{
+    size_t idx = indice(x, y, z);
+    if(layout == AoS){
+        return aos[idx];
+    }
+    Cor c = {r[idx], g[idx], b[idx], a[idx]};
+    return c;
+}
+
+// A linha inteira eh contigua: o trecho comeca na coluna zero
+void VoxelStoreDenso::trecho(int x, int z, int, Trecho &t) const{
+    size_t idx = indice(x, 0, z);
+    t.y0 = 0;
+    t.n = ny;
+    t.bits = &bits[((size_t)z*nx + x)*palavras];
+    if(layout == AoS){
+        t.r = &aos[idx].r;
+        t.g = &aos[idx].g;
+        t.b = &aos[idx].b;
+        t.a = &aos[idx].a;
+        t.passo = sizeof(Cor)/sizeof(float);
+    }
+    else{
+        t.r = &r[idx];
+        t.g = &g[idx];
+        t.b = &b[idx];
+        t.a = &a[idx];
+        t.passo = 1;
+    }
+}
+
+// Ativa os voxels y∈[y0,y1] da linha (z,x) com a cor c
+void VoxelStoreDenso::ativa(int x, int z, int y0, int y1, const Cor &c){
+    marcaBits(&bits[((size_t)z*nx + x)*palavras], y0, y1, true);
+
+    size_t inicio = indice(x, y0, z);
+    size_t fim = inicio + (y1 - y0 + 1);
+    if(layout == AoS){
+        fill(aos.begin() + inicio, aos.begin() + fim, c);
+    }
+    else{
+        fill(r.begin() + inicio, r.begin() + fim, c.r);
+        fill(g.begin() + inicio, g.begin() + fim, c.g);
+        fill(b.begin() + inicio, b.begin() + fim, c.b);
+        fill(a.begin() + inicio, a.begin() + fim, c.a);
+    }
+}
+
+// Desativa os voxels y∈[y0,y1] da linha (z,x)
+void VoxelStoreDenso::desativa(int x, int z, int y0, int y1){
+    marcaBits(&bits[((size_t)z*nx + x)*palavras], y0, y1, false);
+}
+
+// Desativa todos os voxels e zera as cores
+void VoxelStoreDenso::limpa(){
+    fill(bits.begin(), bits.end(), 0);
+    fill(superficie.begin(), superficie.end(), 0);
+    if(layout == AoS){
+        Cor zero = {0, 0, 0, 0};
+        fill(aos.begin(), aos.end(), zero);
+    }
+    else{
+        fill(r.begin(), r.end(), 0.0f);
+        fill(g.begin(), g.end(), 0.0f);
+        fill(b.begin(), b.end(), 0.0f);
+        fill(a.begin(), a.end(), 0.0f);
+    }
+}
+
+// Quantidade de bytes alocados para os voxels
+size_t VoxelStoreDenso::memoria() const{
+    size_t total = (bits.capacity() + superficie.capacity())*sizeof(uint64_t);
+    if(layout == AoS){
+        return total + aos.capacity()*sizeof(Cor);
+    }
+    return total + (r.capacity() + g.capacity() + b.capacity() + a.capacity())*sizeof(float);
+}
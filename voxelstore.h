@@ -0,0 +1,252 @@
+#ifndef VOXELSTORE_H
+#define VOXELSTORE_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/**
+ * @brief The Voxel struct:
+     * Voxels (volume elements), algo equivalente aos Pixels que comumente são usados em imagens digitais.
+     * Nos Voxels seria possível armazenar informações como cor e transparência, necessárias para idealizar os elementos de uma escultura.
+     * @param r : intensidade da cor vermelha, varia entre [0,1]
+     * @param g : intensidade da cor vermelha, varia entre [0,1]
+     * @param b : intensidade da cor vermelha, varia entre [0,1]
+     * @param a : opacidade do voxel, varia entre [0,1]
+     * @param isOn : define se o voxel esta ativo ou nao, assume como valores 0 (desativado) ou 1 (ativado)
+ */
+struct Voxel{
+    float r,g,b; // Cores
+    float a; // Canal alpha
+    bool isOn; // Inclue ou nao
+};
+
+/**
+ * @brief contaBits : quantidade de bits ligados na palavra
+ */
+inline int contaBits(uint64_t palavra){
+#if defined(_MSC_VER)
+    return (int)__popcnt64(palavra);
+#else
+    return __builtin_popcountll(palavra);
+#endif
+}
+
+/**
+ * @brief primeiroBit : posicao do bit ligado menos significativo da palavra (a palavra nao pode ser zero)
+ */
+inline int primeiroBit(uint64_t palavra){
+#if defined(_MSC_VER)
+    unsigned long pos;
+    _BitScanForward64(&pos, palavra);
+    return (int)pos;
+#else
+    return __builtin_ctzll(palavra);
+#endif
+}
+
+/**
+ * @brief The Cor struct: cor de um voxel (r,g,b,a), cada componente varia entre [0,1]
+ */
+struct Cor{
+    float r,g,b,a;
+};
+
+/**
+ * @brief The Trecho struct: visao somente leitura, sem copia, dos voxels y∈[y0, y0+n) de uma linha (z,x).
+ * O voxel y esta ativo se o bit (y-y0)%64 da palavra bits[(y-y0)/64] estiver ligado; as suas componentes sao
+ * r[(y-y0)*passo], g[(y-y0)*passo], b[(y-y0)*passo] e a[(y-y0)*passo]. Em um trecho sem voxels alocados bits eh nulo.
+ * Os ponteiros so valem ate a proxima alteracao do armazenamento.
+ */
+struct Trecho{
+    int y0, n;
+    const uint64_t *bits;
+    const float *r, *g, *b, *a;
+    int passo;
+};
+
+/**
+ * @brief A classe VoxelStore
+ * define o armazenamento dos voxels do escultor, indexados na ordem [z][x][y] (y eh o eixo que varia mais rapido).
+ * A ocupacao (isOn) eh guardada como um conjunto de bits: cada linha (z,x) ocupa palavrasPorLinha() palavras de 64 bits,
+ * o bit j%64 da palavra j/64 representa o voxel (x,j,z). Os bits que sobram na ultima palavra de cada linha sao sempre zero.
+ * No mesmo formato eh guardada uma segunda camada de bits, a dos voxels visiveis, mantida pelo Sculptor.
+ * O layout das cores pode ser escolhido na construcao: AoS guarda as quatro componentes de cada voxel lado a lado;
+ * SoA guarda cada componente em um vetor separado.
+ * Ha duas implementacoes: Denso aloca todo o volume na construcao; Esparso aloca blocos apenas onde algo eh ativado.
+ */
+class VoxelStore
+{
+public:
+    /**
+     * @brief Layout : organizacao das cores dos voxels na memoria
+     */
+    enum Layout { AoS, SoA };
+
+    /**
+     * @brief Backend : estrategia de alocacao dos voxels
+     */
+    enum Backend { Denso, Esparso };
+
+    /**
+     * @brief cria : cria o armazenamento com todos os voxels inicializados com zero
+     * @param _nx : dimensao em x (numero de linhas)
+     * @param _ny : dimensao em y (numero de colunas)
+     * @param _nz : dimensao em z (numero de planos)
+     * @param _layout : organizacao das cores na memoria
+     * @param backend : estrategia de alocacao
+     */
+    static VoxelStore* cria(int _nx, int _ny, int _nz, Layout _layout, Backend backend);
+
+    /**
+     * @brief memoriaProjetada : bytes que cria() alocaria com esses parametros, calculados sem alocar nada.
+     * No esparso apenas a tabela de blocos eh alocada na criacao; os blocos sao alocados conforme os voxels sao ativados.
+     * Valores que nao cabem em size_t sao saturados em SIZE_MAX.
+     */
+    static size_t memoriaProjetada(int _nx, int _ny, int _nz, Layout _layout, Backend backend);
+
+    virtual ~VoxelStore() {}
+
+    /**
+     * @brief palavrasPorLinha : numero de palavras de 64 bits usadas pela ocupacao de cada linha (z,x)
+     */
+    int palavrasPorLinha() const { return palavras; }
+
+    /**
+     * @brief getNx, getNy, getNz : dimensoes do armazenamento
+     */
+    int getNx() const { return nx; }
+    int getNy() const { return ny; }
+    int getNz() const { return nz; }
+
+    /**
+     * @brief ocupacao : retorna as palavras com a ocupacao da linha (z,x). Se a linha nao estiver guardada de forma
+     * contigua ela eh copiada para buffer (com palavrasPorLinha() palavras), que entao eh retornado.
+     */
+    virtual const uint64_t* ocupacao(int x, int z, uint64_t *buffer) const = 0;
+
+    /**
+     * @brief visiveis : retorna as palavras com a camada de voxels visiveis da linha (z,x), como em ocupacao()
+     */
+    virtual const uint64_t* visiveis(int x, int z, uint64_t *buffer) const = 0;
+
+    /**
+     * @brief defineVisiveis : substitui a camada de voxels visiveis da linha (z,x); bits devem ser um subconjunto da ocupacao
+     */
+    virtual void defineVisiveis(int x, int z, const uint64_t *bits) = 0;
+
+    /**
+     * @brief mantemApenas : desativa os voxels da linha (z,x) cujo bit em mascara eh zero
+     */
+    virtual void mantemApenas(int x, int z, const uint64_t *mascara) = 0;
+
+    /**
+     * @brief linhaVazia : retorna true se for garantido que nenhum voxel da linha (z,x) esta ativo
+     */
+    virtual bool linhaVazia(int x, int z) const = 0;
+
+    /**
+     * @brief ativo : retorna se o voxel (x,y,z) esta ativo
+     */
+    virtual bool ativo(int x, int y, int z) const = 0;
+
+    /**
+     * @brief cor : retorna a cor do voxel (x,y,z)
+     */
+    virtual Cor cor(int x, int y, int z) const = 0;
+
+    /**
+     * @brief trecho : preenche t com o maior trecho contiguo da linha (z,x) que contem a coluna y
+     */
+    virtual void trecho(int x, int z, int y, Trecho &t) const = 0;
+
+    /**
+     * @brief voxel : retorna uma copia do voxel (x,y,z)
+     */
+    Voxel voxel(int x, int y, int z) const;
+
+    /**
+     * @brief ativa : ativa os voxels (x,y,z) com y∈[y0,y1] e atribui aos mesmos a cor c
+     */
+    virtual void ativa(int x, int z, int y0, int y1, const Cor &c) = 0;
+
+    /**
+     * @brief desativa : desativa os voxels (x,y,z) com y∈[y0,y1]
+     */
+    virtual void desativa(int x, int z, int y0, int y1) = 0;
+
+    /**
+     * @brief limpa : desativa todos os voxels e zera as suas cores
+     */
+    virtual void limpa() = 0;
+
+    /**
+     * @brief copia : cria um armazenamento independente com os mesmos voxels e a mesma camada de visiveis
+     */
+    virtual VoxelStore* copia() const = 0;
+
+    /**
+     * @brief memoria : quantidade de bytes alocados para os voxels
+     */
+    virtual size_t memoria() const = 0;
+
+    /**
+     * @brief getLayout : retorna o layout escolhido na construcao
+     */
+    Layout getLayout() const { return layout; }
+
+    /**
+     * @brief getBackend : retorna a estrategia de alocacao escolhida na construcao
+     */
+    virtual Backend getBackend() const = 0;
+
+protected:
+    VoxelStore(int _nx, int _ny, int _nz, Layout _layout);
+
+    int nx, ny, nz;
+    int palavras;
+    Layout layout;
+
+    // Liga (ou desliga) os bits y∈[y0,y1] da linha
+    static void marcaBits(uint64_t *linha, int y0, int y1, bool valor);
+};
+
+/**
+ * @brief A classe VoxelStoreDenso
+ * guarda todos os voxels em blocos contiguos de memoria alocados na construcao, indexados linearmente.
+ */
+class VoxelStoreDenso : public VoxelStore
+{
+public:
+    VoxelStoreDenso(int _nx, int _ny, int _nz, Layout _layout);
+
+    size_t indice(int x, int y, int z) const { return ((size_t)z*nx + x)*ny + y; }
+
+    const uint64_t* ocupacao(int x, int z, uint64_t *) const { return &bits[((size_t)z*nx + x)*palavras]; }
+    const uint64_t* visiveis(int x, int z, uint64_t *) const { return &superficie[((size_t)z*nx + x)*palavras]; }
+    void defineVisiveis(int x, int z, const uint64_t *bits);
+    void mantemApenas(int x, int z, const uint64_t *mascara);
+    bool linhaVazia(int, int) const { return false; }
+    bool ativo(int x, int y, int z) const { return (bits[((size_t)z*nx + x)*palavras + (y >> 6)] >> (y & 63)) & 1; }
+    Cor cor(int x, int y, int z) const;
+    void trecho(int x, int z, int y, Trecho &t) const;
+    void ativa(int x, int z, int y0, int y1, const Cor &c);
+    void desativa(int x, int z, int y0, int y1);
+    void limpa();
+    VoxelStore* copia() const { return new VoxelStoreDenso(*this); }
+    size_t memoria() const;
+    Backend getBackend() const { return Denso; }
+
+private:
+    // Ocupacao e voxels visiveis, um bit por voxel
+    std::vector<uint64_t> bits, superficie;
+    // Cores no layout AoS
+    std::vector<Cor> aos;
+    // Cores no layout SoA
+    std::vector<float> r, g, b, a;
+};
+
+#endif // VOXELSTORE_H
@@ -0,0 +1,195 @@
+#include "voxelstoreesparso.h"
+#include <algorithm>
+
+using namespace std;
+
+// Construtor da classe VoxelStoreEsparso: apenas a tabela de blocos eh alocada
+VoxelStoreEsparso::VoxelStoreEsparso(int _nx, int _ny, int _nz, Layout _layout) : VoxelStore(_nx, _ny, _nz, _layout){
+    bz = (nz + BLOCO_Z - 1)/BLOCO_Z;
+    bx = (nx + BLOCO_X - 1)/BLOCO_X;
+    blocos.assign((size_t)bz*bx*palavras, nullptr);
+    alocados = 0;
+}
+
+// Destrutor da classe VoxelStoreEsparso
+VoxelStoreEsparso::~VoxelStoreEsparso(){
+    limpa();
+}
+
+// Copia a ocupacao da linha (z,x) para buffer; blocos vazios contribuem com zeros
+const uint64_t* VoxelStoreEsparso::ocupacao(int x, int z, uint64_t *buffer) const{
+    const Bloco * const *b = &blocos[indiceBloco(x, z, 0)];
+    int linha = linhaNoBloco(x, z);
+    for(int w=0; w<palavras; w++){
+        buffer[w] = b[w] ? b[w]->ocupacao[linha] : 0;
+    }
+    return buffer;
+}
+
+// Copia a camada de visiveis da linha (z,x) para buffer
+const uint64_t* VoxelStoreEsparso::visiveis(int x, int z, uint64_t *buffer) const{
+    const Bloco * const *b = &blocos[indiceBloco(x, z, 0)];
+    int linha = linhaNoBloco(x, z);
+    for(int w=0; w<palavras; w++){
+        buffer[w] = b[w] ? b[w]->visiveis[linha] : 0;
+    }
+    return buffer;
+}
+
+// Substitui a camada de visiveis da linha (z,x); como ela esta contida na ocupacao, blocos vazios sao ignorados
+void VoxelStoreEsparso::defineVisiveis(int x, int z, const uint64_t *bits){
+    Bloco **b = &blocos[indiceBloco(x, z, 0)];
+    int linha = linhaNoBloco(x, z);
+    for(int w=0; w<palavras; w++){
+        if(b[w]){
+            b[w]->visiveis[linha] = bits[w];
+        }
+    }
+}
+
+// Desativa os voxels da linha (z,x) fora da mascara
+void VoxelStoreEsparso::mantemApenas(int x, int z, const uint64_t *mascara){
+    size_t idx = indiceBloco(x, z, 0);
+    int linha = linhaNoBloco(x, z);
+    for(int w=0; w<palavras; w++){
+        if(blocos[idx + w] && (blocos[idx + w]->ocupacao[linha] & ~mascara[w])){
+            blocos[idx + w]->ocupacao[linha] &= mascara[w];
+            liberaSeVazio(idx + w);
+        }
+    }
+}
+
+// A linha esta vazia se todos os blocos que ela atravessa estao vazios
+bool VoxelStoreEsparso::linhaVazia(int x, int z) const{
+    const Bloco * const *b = &blocos[indiceBloco(x, z, 0)];
+    for(int w=0; w<palavras; w++){
+        if(b[w]){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Retorna se o voxel (x,y,z) esta ativo
+bool VoxelStoreEsparso::ativo(int x, int y, int z) const{
+    const Bloco *b = blocos[indiceBloco(x, z, y >> 6)];
+    return b && ((b->ocupacao[linhaNoBloco(x, z)] >> (y & 63)) & 1);
+}
+
+// Retorna a cor do voxel (x,y,z); voxels de blocos vazios tem cor zero
+Cor VoxelStoreEsparso::cor(int x, int y, int z) const{
+    const Bloco *b = blocos[indiceBloco(x, z, y >> 6)];
+    if(b == nullptr){
+        Cor zero = {0, 0, 0, 0};
+        return zero;
+    }
+    int vox = linhaNoBloco(x, z)*64 + (y & 63);
+    Cor c = {b->cores[posCor(vox, 0)], b->cores[posCor(vox, 1)], b->cores[posCor(vox, 2)], b->cores[posCor(vox, 3)]};
+    return c;
+}
+
+// O trecho eh a palavra da linha dentro do bloco que contem y
+void VoxelStoreEsparso::trecho(int x, int z, int y, Trecho &t) const{
+    const Bloco *b = blocos[indiceBloco(x, z, y >> 6)];
+    t.y0 = y & ~63;
+    t.n = ny - t.y0 < 64 ? ny - t.y0 : 64;
+    if(b == nullptr){
+        t.bits = nullptr;
+        t.r = t.g = t.b = t.a = nullptr;
+        t.passo = 0;
+        return;
+    }
+    int vox = linhaNoBloco(x, z)*64;
+    t.bits = &b->ocupacao[linhaNoBloco(x, z)];
+    t.r = &b->cores[posCor(vox, 0)];
+    t.g = &b->cores[posCor(vox, 1)];
+    t.b = &b->cores[posCor(vox, 2)];
+    t.a = &b->cores[posCor(vox, 3)];
+    t.passo = layout == AoS ? 4 : 1;
+}
+
+// Ativa os voxels y∈[y0,y1] da linha (z,x), alocando os blocos que ainda nao existem
+void VoxelStoreEsparso::ativa(int x, int z, int y0, int y1, const Cor &c){
+    size_t idx = indiceBloco(x, z, 0);
+    int linha = linhaNoBloco(x, z);
+    for(int w=(y0 >> 6); w<=(y1 >> 6); w++){
+        Bloco *&b = blocos[idx + w];
+        if(b == nullptr){
+            b = new Bloco();
+            alocados++;
+        }
+        int ini = (w == (y0 >> 6)) ? (y0 & 63) : 0;
+        int fim = (w == (y1 >> 6)) ? (y1 & 63) : 63;
+        marcaBits(&b->ocupacao[linha], ini, fim, true);
+
+        int base = linha*64;
+        if(layout == AoS){
+            for(int t=base+ini; t<=base+fim; t++){
+                b->cores[4*t] = c.r;
+                b->cores[4*t + 1] = c.g;
+                b->cores[4*t + 2] = c.b;
+                b->cores[4*t + 3] = c.a;
+            }
+        }
+        else{
+            fill(b->cores + base + ini, b->cores + base + fim + 1, c.r);
+            fill(b->cores + VOXELS_BLOCO + base + ini, b->cores + VOXELS_BLOCO + base + fim + 1, c.g);
+            fill(b->cores + 2*VOXELS_BLOCO + base + ini, b->cores + 2*VOXELS_BLOCO + base + fim + 1, c.b);
+            fill(b->cores + 3*VOXELS_BLOCO + base + ini, b->cores + 3*VOXELS_BLOCO + base + fim + 1, c.a);
+        }
+    }
+}
+
+// Desativa os voxels y∈[y0,y1] da linha (z,x); blocos vazios sao pulados
+void VoxelStoreEsparso::desativa(int x, int z, int y0, int y1){
+    size_t idx = indiceBloco(x, z, 0);
+    int linha = linhaNoBloco(x, z);
+    for(int w=(y0 >> 6); w<=(y1 >> 6); w++){
+        if(blocos[idx + w] == nullptr){
+            continue;
+        }
+        int ini = (w == (y0 >> 6)) ? (y0 & 63) : 0;
+        int fim = (w == (y1 >> 6)) ? (y1 & 63) : 63;
+        marcaBits(&blocos[idx + w]->ocupacao[linha], ini, fim, false);
+        liberaSeVazio(idx + w);
+    }
+}
+
+// Libera todos os blocos
+void VoxelStoreEsparso::limpa(){
+    for(size_t t=0; t<blocos.size(); t++){
+        delete blocos[t];
+        blocos[t] = nullptr;
+    }
+    alocados = 0;
+}
+
+// Copia apenas os blocos alocados; os vazios continuam nulos na copia
+VoxelStore* VoxelStoreEsparso::copia() const{
+    VoxelStoreEsparso *c = new VoxelStoreEsparso(nx, ny, nz, layout);
+    for(size_t t=0; t<blocos.size(); t++){
+        if(blocos[t]){
+            c->blocos[t] = new Bloco(*blocos[t]);
+        }
+    }
+    c->alocados = alocados.load();
+    return c;
+}
+
+// Quantidade de bytes alocados: a tabela de blocos mais os blocos existentes
+size_t VoxelStoreEsparso::memoria() const{
+    return blocos.capacity()*sizeof(Bloco*) + alocados*sizeof(Bloco);
+}
+
+// Libera o bloco se nenhum voxel dele estiver ativo
+void VoxelStoreEsparso::liberaSeVazio(size_t idx){
+    const Bloco *b = blocos[idx];
+    for(int t=0; t<LINHAS_BLOCO; t++){
+        if(b->ocupacao[t]){
+            return;
+        }
+    }
+    delete b;
+    blocos[idx] = nullptr;
+    alocados--;
+}
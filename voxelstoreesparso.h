@@ -0,0 +1,75 @@
+#ifndef VOXELSTOREESPARSO_H
+#define VOXELSTOREESPARSO_H
+
+#include "voxelstore.h"
+#include <atomic>
+
+/**
+ * @brief A classe VoxelStoreEsparso
+ * divide o escultor em blocos de BLOCO_Z planos x BLOCO_X linhas x 64 colunas (4096 voxels, o mesmo que um cubo 16³),
+ * de modo que cada linha de um bloco ocupa exatamente uma palavra da ocupacao.
+ * Um bloco so eh alocado quando algum voxel dele eh ativado e eh liberado quando fica vazio;
+ * os blocos vazios sao representados por ponteiros nulos, logo a memoria e o tempo de percorrer o escultor
+ * crescem com o volume ocupado, e nao com as dimensoes.
+ */
+class VoxelStoreEsparso : public VoxelStore
+{
+public:
+    /**
+     * @brief BLOCO_Z, BLOCO_X : dimensoes de um bloco em z e em x (em y um bloco tem 64 voxels)
+     */
+    static const int BLOCO_Z = 8;
+    static const int BLOCO_X = 8;
+
+    VoxelStoreEsparso(int _nx, int _ny, int _nz, Layout _layout);
+    ~VoxelStoreEsparso();
+
+    const uint64_t* ocupacao(int x, int z, uint64_t *buffer) const;
+    const uint64_t* visiveis(int x, int z, uint64_t *buffer) const;
+    void defineVisiveis(int x, int z, const uint64_t *bits);
+    void mantemApenas(int x, int z, const uint64_t *mascara);
+    bool linhaVazia(int x, int z) const;
+    bool ativo(int x, int y, int z) const;
+    Cor cor(int x, int y, int z) const;
+    void trecho(int x, int z, int y, Trecho &t) const;
+    void ativa(int x, int z, int y0, int y1, const Cor &c);
+    void desativa(int x, int z, int y0, int y1);
+    void limpa();
+    VoxelStore* copia() const;
+    size_t memoria() const;
+    Backend getBackend() const { return Esparso; }
+
+    /**
+     * @brief blocosAlocados : numero de blocos alocados no momento
+     */
+    size_t blocosAlocados() const { return alocados; }
+
+private:
+    static const int LINHAS_BLOCO = BLOCO_Z*BLOCO_X;
+    static const int VOXELS_BLOCO = LINHAS_BLOCO*64;
+
+    struct Bloco{
+        uint64_t ocupacao[LINHAS_BLOCO];
+        uint64_t visiveis[LINHAS_BLOCO];
+        float cores[4*VOXELS_BLOCO];
+    };
+
+    // Numero de blocos em z e em x (em y sao palavras blocos)
+    int bz, bx;
+    // Tabela de blocos, nullptr representa um bloco vazio
+    std::vector<Bloco*> blocos;
+    // Atomico porque fatias de planos diferentes podem alocar e liberar blocos ao mesmo tempo
+    std::atomic<size_t> alocados;
+
+    VoxelStoreEsparso(const VoxelStoreEsparso&) = delete;
+    VoxelStoreEsparso& operator=(const VoxelStoreEsparso&) = delete;
+
+    size_t indiceBloco(int x, int z, int w) const { return ((size_t)(z/BLOCO_Z)*bx + x/BLOCO_X)*palavras + w; }
+    static int linhaNoBloco(int x, int z) { return (z%BLOCO_Z)*BLOCO_X + x%BLOCO_X; }
+    // Posicao da componente c (0..3 = r,g,b,a) do voxel v do bloco no vetor de cores
+    int posCor(int voxel, int c) const { return layout == AoS ? 4*voxel + c : c*VOXELS_BLOCO + voxel; }
+    // Libera o bloco se nenhum voxel dele estiver ativo
+    void liberaSeVazio(size_t idx);
+};
+
+#endif // VOXELSTOREESPARSO_H